@@ -0,0 +1,171 @@
+#include "DetailView.h"
+#include "UiTheme.h"
+
+namespace {
+constexpr int kControlsWidth = 36;
+
+float sampleToScopeY(const juce::Rectangle<float>& scope, float value, float gain)
+{
+    // The same as the peaks, see `Mexoscope::captureChunk`.
+    const float virtualY = float(OSC_CENTER) - clip(value * gain, 1.0f) * float(OSC_CENTER);
+    return scope.getY() + (virtualY / float(OSC_HEIGHT - 1)) * scope.getHeight();
+}
+
+juce::String formatValue(double value)
+{
+    return (value < 1000.0) ? juce::String(value, 3) : juce::String(juce::int64(value));
+}
+}
+
+DetailView::DetailView(const Mexoscope& mexoscope)
+    : effect(mexoscope)
+{
+    const std::tuple<juce::Slider*, double, const char*> knobs[] = {
+        { &timeKnob, 0.35, "Time window of this view" },
+        { &ampKnob, 0.5, "Amplitude window of this view" },
+        { &positionKnob, 0.25, "Where the trigger is in this view" },
+    };
+    for (auto [knob, defaultValue, tooltip] : knobs) {
+        knob->setSliderStyle(juce::Slider::RotaryHorizontalVerticalDrag);
+        knob->setRange(0.0, 1.0, 0.0);
+        knob->setValue(defaultValue, juce::dontSendNotification);
+        knob->setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+        knob->setDoubleClickReturnValue(true, defaultValue);
+        knob->setTooltip(tooltip);
+        knob->setRotaryParameters(juce::MathConstants<float>::pi * 1.15f, juce::MathConstants<float>::pi * 2.85f, true);
+        knob->onValueChange = [this] { repaint(); };
+        addAndMakeVisible(*knob);
+    }
+}
+
+juce::Rectangle<float> DetailView::getScopeArea() const
+{
+    auto area = getLocalBounds().toFloat().reduced(ui::kScopePadding);
+    area.removeFromLeft(float(kControlsWidth + 4));
+    return area;
+}
+
+void DetailView::resized()
+{
+    auto controls = getLocalBounds().reduced(int(ui::kScopePadding)).removeFromLeft(kControlsWidth);
+    const int knobSize = juce::jlimit(16, kControlsWidth, controls.getHeight() / 3);
+    timeKnob.setBounds(controls.removeFromTop(knobSize));
+    ampKnob.setBounds(controls.removeFromTop(knobSize));
+    positionKnob.setBounds(controls.removeFromTop(knobSize));
+
+    valuesBounds = getScopeArea().reduced(8.0f, 4.0f).removeFromTop(16.0f).toNearestInt();
+}
+
+void DetailView::paint(juce::Graphics& g)
+{
+    const auto bounds = getLocalBounds().toFloat();
+    const auto scope = getScopeArea();
+
+    g.setColour(ui::kPanelColour);
+    g.fillRoundedRectangle(bounds, ui::kCardCorner);
+    g.setColour(ui::kPanelEdgeColour);
+    g.drawRoundedRectangle(bounds.reduced(0.5f), ui::kCardCorner, 1.0f);
+
+    g.setColour(ui::kScopeBackgroundColour);
+    g.fillRoundedRectangle(scope, 10.0f);
+
+    g.reduceClipRegion(scope.getSmallestIntegerContainer());
+
+    g.setColour(ui::kScopeGridColour);
+    for (float x = scope.getX(); x <= scope.getRight(); x += 24.0f) {
+        g.drawVerticalLine(int(x), scope.getY(), scope.getBottom());
+    }
+    for (float y = scope.getY(); y <= scope.getBottom(); y += 20.0f) {
+        g.drawHorizontalLine(int(y), scope.getX(), scope.getRight());
+    }
+
+    g.setColour(ui::kZeroLineColour);
+    g.drawHorizontalLine(int(sampleToScopeY(scope, 0.0f, 1.0f)), scope.getX(), scope.getRight());
+
+    const double samplesPerPixel = std::pow(10.0, timeKnob.getValue() * 5.0 - 1.5);
+    const float gain = std::pow(10.0f, float(ampKnob.getValue()) * 6.0f - 3.0f);
+    const double position = positionKnob.getValue();
+
+    g.setColour(ui::kTriggerLineColour);
+    g.drawVerticalLine(int(scope.getX() + float(position) * scope.getWidth()), scope.getY(), scope.getBottom());
+
+    g.setColour(ui::kMutedTextColour);
+    g.setFont(ui::monoFont());
+    g.drawText("Time " + formatValue(1.0 / samplesPerPixel) + "  Amp " + formatValue(double(gain)),
+               valuesBounds, juce::Justification::topLeft, false);
+
+    // Around the trigger of the frame that the main display shows.
+    const bool syncDraw = (effect.getParameter(Mexoscope::kSyncDraw) > 0.5f);
+    const auto frameStart = effect.getFrameStart(syncDraw);
+    if (!effect.getHistory().isActive() || frameStart < 0) {
+        g.drawText("No samples", scope, juce::Justification::centred, false);
+        return;
+    }
+
+    const double begin = double(frameStart) - position * double(OSC_WIDTH) * samplesPerPixel;
+    if (samplesPerPixel < 1.0) {
+        drawSamples(g, scope, begin, samplesPerPixel, gain);
+    } else {
+        drawColumns(g, scope, begin, samplesPerPixel, gain);
+    }
+}
+
+void DetailView::drawColumns(juce::Graphics& g, juce::Rectangle<float> scope, double begin, double samplesPerPixel,
+                             float gain) const
+{
+    const auto& history = effect.getHistory();
+    const float xScale = scope.getWidth() / float(OSC_WIDTH);
+
+    juce::RectangleList<float> columns;
+    columns.ensureStorageAllocated(OSC_WIDTH);
+
+    SampleHistory::Extremes extremes;
+    for (int column = 0; column < OSC_WIDTH; ++column) {
+        // Up to and including the first sample of the next column, so that
+        // the columns join up like the main display's.
+        const auto from = juce::int64(std::floor(begin + double(column) * samplesPerPixel));
+        const auto to = juce::int64(std::floor(begin + double(column + 1) * samplesPerPixel)) + 1;
+        if (!history.findExtremes(from, to, extremes)) {
+            continue;
+        }
+
+        const float top = sampleToScopeY(scope, extremes.maximum, gain);
+        const float bottom = sampleToScopeY(scope, extremes.minimum, gain);
+        columns.addWithoutMerging({ scope.getX() + float(column) * xScale, top, 1.0f, juce::jmax(1.0f, bottom - top) });
+    }
+
+    g.setColour(ui::kWaveDenseColour);
+    g.fillRectList(columns);
+}
+
+void DetailView::drawSamples(juce::Graphics& g, juce::Rectangle<float> scope, double begin, double samplesPerPixel,
+                             float gain) const
+{
+    const auto& history = effect.getHistory();
+    const float xScale = scope.getWidth() / float(OSC_WIDTH);
+    const auto first = juce::int64(std::floor(begin));
+    const int numSamples = int(std::ceil(double(OSC_WIDTH) * samplesPerPixel)) + 2;
+
+    // Samples that aren't in the history leave a gap.
+    juce::Path path;
+    bool joined = false;
+    for (int n = 0; n < numSamples; ++n) {
+        float value;
+        if (!history.getSample(first + n, value)) {
+            joined = false;
+            continue;
+        }
+
+        const float x = scope.getX() + float((double(first + n) - begin) / samplesPerPixel) * xScale;
+        const float y = sampleToScopeY(scope, value, gain);
+        if (joined) {
+            path.lineTo(x, y);
+        } else {
+            path.startNewSubPath(x, y);
+        }
+        joined = true;
+    }
+
+    g.setColour(ui::kWaveInterpolatedColour);
+    g.strokePath(path, juce::PathStrokeType(1.0f));
+}
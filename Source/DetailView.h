@@ -0,0 +1,44 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Mexoscope.h"
+
+/*
+  A second look at the same signal, with its own time window, amplitude and
+  trigger position, under the main display. Handy for keeping a zoomed-in
+  detail of the trigger on screen next to the overview.
+
+  It's drawn straight from the sample history, around the trigger of the
+  frame the main display shows, so it doesn't cost the audio thread
+  anything: the history is written anyway while the editor is open, and
+  with its min/max pyramid a column takes a handful of lookups whatever the
+  time window. The Time and Amp knobs work like the main ones.
+*/
+class DetailView : public juce::Component
+{
+public:
+    explicit DetailView(const Mexoscope& mexoscope);
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+private:
+    juce::Rectangle<float> getScopeArea() const;
+
+    // Draws the columns from `begin` on, as far as the history has them.
+    void drawColumns(juce::Graphics& g, juce::Rectangle<float> scope, double begin, double samplesPerPixel,
+                     float gain) const;
+
+    // Zoomed in, joins the samples from `begin` on.
+    void drawSamples(juce::Graphics& g, juce::Rectangle<float> scope, double begin, double samplesPerPixel,
+                     float gain) const;
+
+    const Mexoscope& effect;
+
+    juce::Slider timeKnob;
+    juce::Slider ampKnob;
+    juce::Slider positionKnob;
+    juce::Rectangle<int> valuesBounds;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DetailView)
+};
@@ -0,0 +1,93 @@
+#include "DiagnosticsPanel.h"
+#include "UiTheme.h"
+
+#if MEXOSCOPE_INSTRUMENTATION
+
+namespace {
+constexpr int kLineHeight = 15;
+constexpr int kPadding = 8;
+
+juce::String formatMicroseconds(double seconds)
+{
+    return juce::String(seconds * 1.0e6, seconds < 1.0e-4 ? 1 : 0);
+}
+
+juce::String formatPercent(double load)
+{
+    return juce::String(load * 100.0, 1) + "%";
+}
+}
+
+void DiagnosticsPanel::addProbe(const juce::String& name, instrumentation::PerfProbe& probe, bool measuresBlocks)
+{
+    rows.push_back({ name, &probe, measuresBlocks, {} });
+}
+
+void DiagnosticsPanel::update()
+{
+    instrumentation::calibrate();
+
+    for (auto& row : rows) {
+        row.stats = row.probe->getStats();
+    }
+    repaint();
+}
+
+int DiagnosticsPanel::getPreferredHeight() const
+{
+    int lines = 1;
+    for (const auto& row : rows) {
+        lines += row.measuresBlocks ? 3 : 2;
+    }
+    return lines * kLineHeight + kPadding * 2;
+}
+
+void DiagnosticsPanel::paint(juce::Graphics& g)
+{
+    const auto bounds = getLocalBounds().toFloat();
+    g.setColour(ui::kPanelColour.withAlpha(0.9f));
+    g.fillRoundedRectangle(bounds, 6.0f);
+    g.setColour(ui::kPanelEdgeColour);
+    g.drawRoundedRectangle(bounds.reduced(0.5f), 6.0f, 1.0f);
+
+    auto area = getLocalBounds().reduced(kPadding);
+    g.setFont(ui::monoFont());
+
+    if (instrumentation::getCyclesPerSecond() <= 0.0) {
+        g.setColour(ui::kMutedTextColour);
+        g.drawText("calibrating...", area.removeFromTop(kLineHeight), juce::Justification::centredLeft, false);
+        return;
+    }
+
+    g.setColour(ui::kMutedTextColour);
+    g.drawText("us: mean / p99 / max", area.removeFromTop(kLineHeight), juce::Justification::centredLeft, false);
+
+    for (const auto& row : rows) {
+        const auto& s = row.stats;
+
+        g.setColour(ui::kMutedTextColour);
+        g.drawText(row.name + " (" + juce::String(s.count) + ")", area.removeFromTop(kLineHeight),
+                   juce::Justification::centredLeft, false);
+
+        g.setColour(ui::kTextColour);
+        g.drawText("  " + formatMicroseconds(s.meanSeconds) + " / " + formatMicroseconds(s.p99Seconds)
+                       + " / " + formatMicroseconds(s.maxSeconds),
+                   area.removeFromTop(kLineHeight), juce::Justification::centredLeft, false);
+
+        if (row.measuresBlocks) {
+            g.setColour(s.deadlineMisses > 0 ? ui::kAccentColour : ui::kTextColour);
+            g.drawText("  load " + formatPercent(s.p99Load) + " / " + formatPercent(s.maxLoad)
+                           + ", " + juce::String(s.deadlineMisses) + " over",
+                       area.removeFromTop(kLineHeight), juce::Justification::centredLeft, false);
+        }
+    }
+}
+
+void DiagnosticsPanel::mouseDown(const juce::MouseEvent&)
+{
+    for (auto& row : rows) {
+        row.probe->reset();
+    }
+}
+
+#endif
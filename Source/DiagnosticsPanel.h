@@ -0,0 +1,44 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Instrumentation.h"
+
+#if MEXOSCOPE_INSTRUMENTATION
+
+/*
+  Small overlay that shows what the instrumented hot paths cost: the mean,
+  99th percentile and worst time per call, and for the audio paths how much
+  of the block's time budget was used and how often it was overrun.
+  Clicking the panel starts the statistics over.
+*/
+class DiagnosticsPanel : public juce::Component
+{
+public:
+    DiagnosticsPanel() = default;
+
+    // The probe must outlive the panel.
+    void addProbe(const juce::String& name, instrumentation::PerfProbe& probe, bool measuresBlocks);
+
+    // Reads the probes again. Call this from the editor's timer.
+    void update();
+
+    void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& event) override;
+
+    int getPreferredHeight() const;
+
+private:
+    struct Row
+    {
+        juce::String name;
+        instrumentation::PerfProbe* probe;
+        bool measuresBlocks;
+        instrumentation::PerfProbe::Stats stats;
+    };
+
+    std::vector<Row> rows;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(DiagnosticsPanel)
+};
+
+#endif
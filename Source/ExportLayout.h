@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "Defines.h"
+
+/*
+  Layout of the shared-memory object written by SharedMemoryExporter.
+
+  This header deliberately doesn't depend on JUCE so that external tools
+  (see Tools/ShmReader.cpp) can include it as-is. The object looks like:
+
+    [ExportHeader]
+    [raw sample rings]    numChannels planar rings of rawCapacity floats
+    [frame ring]          frameCapacity FrameRecord slots
+
+  There is exactly one writer, the plug-in's audio thread. It copies the
+  new data into the rings and then does a release-store of the write index.
+  Readers do an acquire-load of the write index, copy whatever they need,
+  and load the write index again: if the writer has since moved more than
+  the usable capacity past the reader's position, the copied data was being
+  overwritten and must be thrown away. The writer never waits for readers.
+
+  The writer may be busy filling up to half a raw ring beyond the published
+  index, so only the most recent `rawCapacity / 2` samples are usable. The
+  frame ring has no such margin: slot `frameWriteIndex & mask` is the one
+  that's being written, all others are usable.
+*/
+namespace mexport {
+
+inline constexpr char kMagic[8] = { 'M', 'E', 'X', 'O', 'S', 'C', 'P', '\0' };
+inline constexpr uint32_t kVersion = 3;
+
+// Both capacities are powers of two so readers can use a mask.
+inline constexpr uint32_t kRawCapacity = 1 << 17;      // samples per channel
+inline constexpr uint32_t kFrameCapacity = 64;         // frames
+inline constexpr uint32_t kMaxChannels = 2;
+
+inline constexpr uint32_t usableRawCapacity(uint32_t rawCapacity)
+{
+    return rawCapacity / 2;
+}
+
+// One decimated frame. These are the same y-values the editor draws, i.e.
+// two readings per pixel column in the range [0, OSC_HEIGHT).
+struct FrameRecord
+{
+    uint64_t samplePosition;    // value of rawWriteIndex when the frame ended
+    int16_t y[OSC_WIDTH * 2];
+};
+
+struct ExportHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;        // sizeof(ExportHeader)
+
+    uint32_t numChannels;
+    uint32_t rawCapacity;
+    uint64_t rawOffset;         // byte offset of the first raw ring
+
+    uint32_t frameCapacity;
+    uint32_t frameColumns;      // OSC_WIDTH
+    uint64_t frameOffset;       // byte offset of the first FrameRecord
+    uint64_t frameStride;       // sizeof(FrameRecord)
+
+    // Written by the plug-in whenever the host changes the sample rate.
+    std::atomic<double> sampleRate;
+
+    // Total number of samples (per channel) and frames written so far.
+    // The ring position is `index & (capacity - 1)`.
+    std::atomic<uint64_t> rawWriteIndex;
+    std::atomic<uint64_t> frameWriteIndex;
+
+    // Mask test results, updated every block. The counts are zero while
+    // there's no mask. The last failure is the host sample position of the
+    // trigger that started the failed frame, or -1 if there was none.
+    std::atomic<uint64_t> maskTestedFrames;
+    std::atomic<uint64_t> maskFailedFrames;
+    std::atomic<int64_t> maskLastFailure;
+
+    // Trigger statistics, updated every block. The counts are totals since
+    // the plug-in was loaded: triggers that fired, and edges that the
+    // retrigger limit held back. The period is over the last 1024 triggers,
+    // in seconds, and zero until there are two in a row.
+    std::atomic<uint64_t> triggersAccepted;
+    std::atomic<uint64_t> triggersRejected;
+    std::atomic<double> triggerPeriodMean;
+    std::atomic<double> triggerPeriodStdDev;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared-memory indices must be lock-free");
+static_assert(std::atomic<int64_t>::is_always_lock_free, "shared-memory counters must be lock-free");
+static_assert(std::atomic<double>::is_always_lock_free, "shared-memory sample rate must be lock-free");
+
+inline constexpr uint64_t rawOffset()
+{
+    return (sizeof(ExportHeader) + 63) & ~uint64_t(63);
+}
+
+inline constexpr uint64_t frameOffset(uint32_t numChannels)
+{
+    return rawOffset() + uint64_t(numChannels) * kRawCapacity * sizeof(float);
+}
+
+inline constexpr uint64_t totalSize(uint32_t numChannels)
+{
+    return frameOffset(numChannels) + uint64_t(kFrameCapacity) * sizeof(FrameRecord);
+}
+
+}  // namespace mexport
@@ -0,0 +1,174 @@
+#include "Instrumentation.h"
+#include "RealtimeCheck.h"
+#include <bit>
+
+#if MEXOSCOPE_INSTRUMENTATION
+
+namespace instrumentation {
+
+namespace {
+std::atomic<double> cyclesPerSecond { 0.0 };
+
+// Cycle counter and system clock readings from the first `calibrate` call.
+// The longer ago that was, the more accurate the measured rate gets.
+juce::SpinLock anchorLock;
+uint64_t anchorCycles = 0;
+juce::int64 anchorTicks = 0;
+
+// Only single threads write into a probe, so a plain load and store is enough
+// and is a lot cheaper than a read-modify-write.
+template <typename T>
+void bump(std::atomic<T>& counter, T amount = T(1)) noexcept
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+int cycleBucket(uint64_t cycles)
+{
+    if (cycles < 64) {
+        return 0;
+    }
+
+    const int octave = 63 - std::countl_zero(cycles);
+    const int quarter = int((cycles >> (octave - 2)) & 3);
+    return std::min((octave - 6) * 4 + quarter, PerfProbe::kNumCycleBuckets - 1);
+}
+
+// Upper edge of a bucket, so percentiles err on the slow side.
+double bucketCycles(int bucket)
+{
+    const int next = bucket + 1;
+    return std::ldexp(1.0 + (next % 4) * 0.25, next / 4 + 6);
+}
+
+template <size_t N>
+int findPercentile(const std::array<uint32_t, N>& buckets, uint64_t total, double fraction)
+{
+    const auto target = uint64_t(std::ceil(double(total) * fraction));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < N; ++i) {
+        seen += buckets[i];
+        if (seen >= target && seen > 0) {
+            return int(i);
+        }
+    }
+    return int(N) - 1;
+}
+}
+
+double getCyclesPerSecond() noexcept
+{
+    return cyclesPerSecond.load(std::memory_order_relaxed);
+}
+
+void calibrate()
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    const juce::SpinLock::ScopedLockType lock(anchorLock);
+    const auto cycles = readCycleCounter();
+    const auto ticks = juce::Time::getHighResolutionTicks();
+
+    if (anchorTicks == 0) {
+        anchorCycles = cycles;
+        anchorTicks = ticks;
+        return;
+    }
+
+    const double seconds = juce::Time::highResolutionTicksToSeconds(ticks - anchorTicks);
+    if (seconds > 0.05) {
+        cyclesPerSecond.store(double(cycles - anchorCycles) / seconds, std::memory_order_relaxed);
+    }
+}
+
+void PerfProbe::record(uint64_t cycles) noexcept
+{
+    if (resetRequested.load(std::memory_order_relaxed) && resetRequested.exchange(false)) {
+        count.store(0, std::memory_order_relaxed);
+        totalCycles.store(0, std::memory_order_relaxed);
+        maxCycles.store(0, std::memory_order_relaxed);
+        deadlineCount.store(0, std::memory_order_relaxed);
+        deadlineMisses.store(0, std::memory_order_relaxed);
+        maxLoad.store(0.0f, std::memory_order_relaxed);
+        for (auto& bucket : cycleBuckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+        for (auto& bucket : loadBuckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    bump(count);
+    bump(totalCycles, cycles);
+    bump(cycleBuckets[size_t(cycleBucket(cycles))]);
+
+    if (cycles > maxCycles.load(std::memory_order_relaxed)) {
+        maxCycles.store(cycles, std::memory_order_relaxed);
+    }
+}
+
+void PerfProbe::recordBlock(uint64_t cycles, int numSamples, double sampleRate) noexcept
+{
+    record(cycles);
+
+    const double cps = getCyclesPerSecond();
+    if (cps <= 0.0 || numSamples <= 0 || sampleRate <= 0.0) {
+        return;
+    }
+
+    const auto load = float(double(cycles) * sampleRate / (double(numSamples) * cps));
+    const int bucket = juce::jlimit(0, kNumLoadBuckets - 1, int(load * 100.0f));
+
+    bump(deadlineCount);
+    bump(loadBuckets[size_t(bucket)]);
+    if (load > 1.0f) {
+        bump(deadlineMisses);
+    }
+    if (load > maxLoad.load(std::memory_order_relaxed)) {
+        maxLoad.store(load, std::memory_order_relaxed);
+    }
+}
+
+PerfProbe::Stats PerfProbe::getStats() const
+{
+    Stats stats;
+
+    // The counters are read one at a time while the audio thread may be
+    // recording, so they can be off by a block or so. That's fine here.
+    std::array<uint32_t, kNumCycleBuckets> cycleCounts;
+    uint64_t bucketTotal = 0;
+    for (size_t i = 0; i < cycleCounts.size(); ++i) {
+        cycleCounts[i] = cycleBuckets[i].load(std::memory_order_relaxed);
+        bucketTotal += cycleCounts[i];
+    }
+
+    stats.count = count.load(std::memory_order_relaxed);
+    const double cps = getCyclesPerSecond();
+    if (stats.count == 0 || cps <= 0.0) {
+        return stats;
+    }
+
+    stats.meanSeconds = double(totalCycles.load(std::memory_order_relaxed)) / double(stats.count) / cps;
+    stats.medianSeconds = bucketCycles(findPercentile(cycleCounts, bucketTotal, 0.5)) / cps;
+    stats.p99Seconds = bucketCycles(findPercentile(cycleCounts, bucketTotal, 0.99)) / cps;
+    stats.maxSeconds = double(maxCycles.load(std::memory_order_relaxed)) / cps;
+
+    std::array<uint32_t, kNumLoadBuckets> loadCounts;
+    uint64_t loadTotal = 0;
+    for (size_t i = 0; i < loadCounts.size(); ++i) {
+        loadCounts[i] = loadBuckets[i].load(std::memory_order_relaxed);
+        loadTotal += loadCounts[i];
+    }
+
+    stats.deadlineCount = deadlineCount.load(std::memory_order_relaxed);
+    if (loadTotal > 0) {
+        stats.p99Load = (findPercentile(loadCounts, loadTotal, 0.99) + 1) * 0.01;
+        stats.maxLoad = maxLoad.load(std::memory_order_relaxed);
+        stats.deadlineMisses = deadlineMisses.load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
+
+}  // namespace instrumentation
+
+#endif
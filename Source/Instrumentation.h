@@ -0,0 +1,150 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+  Lightweight timing of the hot paths: the audio callback, the capture loop
+  and the waveform painting. This is on by default in debug builds and can
+  be turned on for release builds with -DMEXOSCOPE_INSTRUMENTATION=1. When
+  it's off, the probes and the diagnostics panel are not compiled at all.
+*/
+#ifndef MEXOSCOPE_INSTRUMENTATION
+ #define MEXOSCOPE_INSTRUMENTATION JUCE_DEBUG
+#endif
+
+#if MEXOSCOPE_INSTRUMENTATION
+
+#if JUCE_INTEL && JUCE_MSVC
+ #include <intrin.h>
+#elif JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+ #include <x86intrin.h>
+#endif
+
+namespace instrumentation {
+
+// Reads the CPU's cycle counter, or the best high-resolution clock there is
+// if we don't know how to read the cycle counter on this platform.
+inline uint64_t readCycleCounter() noexcept
+{
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG || JUCE_MSVC)
+    return uint64_t(__rdtsc());
+#elif JUCE_ARM && JUCE_64BIT && (JUCE_GCC || JUCE_CLANG)
+    uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return uint64_t(juce::Time::getHighResolutionTicks());
+#endif
+}
+
+// Number of cycle counter ticks per second, or 0 if that isn't known yet.
+// The rate is measured against the system clock by `calibrate`.
+double getCyclesPerSecond() noexcept;
+
+// Refines the measured cycle counter rate. Call this now and then, but not
+// from the audio thread. The first call only sets the starting point.
+void calibrate();
+
+/*
+  Collects statistics for one measured piece of code. There must only be one
+  thread that records into a probe, but any thread can read the statistics.
+  All counters are relaxed atomics, so recording is a handful of loads and
+  stores and never waits.
+*/
+class PerfProbe
+{
+public:
+    // Four buckets per octave, starting at 64 cycles.
+    static constexpr int kNumCycleBuckets = 128;
+
+    // Load in steps of 1% of the deadline, the last bucket is for 200%+.
+    static constexpr int kNumLoadBuckets = 201;
+
+    struct Stats
+    {
+        uint64_t count = 0;
+        double meanSeconds = 0.0;
+        double medianSeconds = 0.0;
+        double p99Seconds = 0.0;
+        double maxSeconds = 0.0;
+
+        // Fraction of the time available for the block, i.e. the block size
+        // divided by the sample rate. Only for probes that measure blocks.
+        uint64_t deadlineCount = 0;
+        double p99Load = 0.0;
+        double maxLoad = 0.0;
+        uint64_t deadlineMisses = 0;
+    };
+
+    PerfProbe() = default;
+
+    void record(uint64_t cycles) noexcept;
+    void recordBlock(uint64_t cycles, int numSamples, double sampleRate) noexcept;
+
+    Stats getStats() const;
+
+    // Asks the recording thread to start over.
+    void reset() noexcept { resetRequested.store(true); }
+
+private:
+    std::atomic<uint64_t> count { 0 };
+    std::atomic<uint64_t> totalCycles { 0 };
+    std::atomic<uint64_t> maxCycles { 0 };
+    std::array<std::atomic<uint32_t>, kNumCycleBuckets> cycleBuckets {};
+
+    std::atomic<uint64_t> deadlineCount { 0 };
+    std::atomic<uint64_t> deadlineMisses { 0 };
+    std::atomic<float> maxLoad { 0.0f };
+    std::array<std::atomic<uint32_t>, kNumLoadBuckets> loadBuckets {};
+
+    std::atomic<bool> resetRequested { false };
+
+    JUCE_DECLARE_NON_COPYABLE(PerfProbe)
+};
+
+// Times the scope it lives in.
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(PerfProbe& p) noexcept
+        : probe(p), start(readCycleCounter())
+    {
+    }
+
+    ScopedTimer(PerfProbe& p, int blockSize, double rate) noexcept
+        : probe(p), numSamples(blockSize), sampleRate(rate), start(readCycleCounter())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        const auto cycles = readCycleCounter() - start;
+        if (numSamples > 0) {
+            probe.recordBlock(cycles, numSamples, sampleRate);
+        } else {
+            probe.record(cycles);
+        }
+    }
+
+private:
+    PerfProbe& probe;
+    int numSamples = 0;
+    double sampleRate = 0.0;
+    uint64_t start;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedTimer)
+};
+
+}  // namespace instrumentation
+
+ #define MEXOSCOPE_PROBE(probe) \
+    const instrumentation::ScopedTimer JUCE_JOIN_MACRO(probeTimer_, __LINE__)(probe)
+ #define MEXOSCOPE_PROBE_BLOCK(probe, numSamples, sampleRate) \
+    const instrumentation::ScopedTimer JUCE_JOIN_MACRO(probeTimer_, __LINE__)(probe, numSamples, sampleRate)
+
+#else
+
+ #define MEXOSCOPE_PROBE(probe)
+ #define MEXOSCOPE_PROBE_BLOCK(probe, numSamples, sampleRate)
+
+#endif
@@ -0,0 +1,152 @@
+#include "LoudnessLanes.h"
+#include "UiTheme.h"
+
+namespace {
+constexpr int kLabelWidth = 78;
+constexpr int kValueWidth = 84;
+
+// The range of the traces and bars.
+constexpr float kFloor = -60.0f;
+constexpr float kCeiling = 3.0f;
+
+float levelToX(const juce::Rectangle<float>& area, float level)
+{
+    const float proportion = juce::jlimit(0.0f, 1.0f, (level - kFloor) / (kCeiling - kFloor));
+    return area.getX() + proportion * area.getWidth();
+}
+
+float levelToY(const juce::Rectangle<float>& area, float level)
+{
+    const float proportion = juce::jlimit(0.0f, 1.0f, (level - kFloor) / (kCeiling - kFloor));
+    return area.getBottom() - proportion * area.getHeight();
+}
+
+juce::String formatLevel(float level, const char* unit)
+{
+    return std::isfinite(level) ? juce::String(level, 1) + " " + unit : juce::String("-inf ") + unit;
+}
+}
+
+LoudnessLanes::LoudnessLanes(LoudnessMeter& m)
+    : meter(m)
+{
+    for (auto& trace : traces) {
+        trace.values.fill(LoudnessMeter::kSilence);
+    }
+    setTooltip("Loudness (BS.1770) and true peak of the main input. Click to start over");
+    setMouseCursor(juce::MouseCursor::PointingHandCursor);
+}
+
+void LoudnessLanes::update()
+{
+    const float readings[] = { meter.getMomentary(), meter.getShortTerm(), meter.getIntegrated() };
+    for (size_t i = 0; i < traces.size(); ++i) {
+        auto& trace = traces[i];
+        trace.values[size_t(trace.position)] = readings[i];
+        trace.position = (trace.position + 1) % kTraceLength;
+    }
+    repaint();
+}
+
+void LoudnessLanes::mouseDown(const juce::MouseEvent&)
+{
+    meter.reset();
+    for (auto& trace : traces) {
+        trace.values.fill(LoudnessMeter::kSilence);
+    }
+    repaint();
+}
+
+void LoudnessLanes::paint(juce::Graphics& g)
+{
+    const auto bounds = getLocalBounds().toFloat();
+    g.setColour(ui::kPanelColour);
+    g.fillRoundedRectangle(bounds, ui::kCardCorner);
+    g.setColour(ui::kPanelEdgeColour);
+    g.drawRoundedRectangle(bounds.reduced(0.5f), ui::kCardCorner, 1.0f);
+
+    auto rows = getLocalBounds().reduced(int(ui::kScopePadding), 6);
+    const int rowHeight = rows.getHeight() / 4;
+
+    const char* labels[] = { "Momentary", "Short-term", "Integrated", "True peak" };
+    const juce::String values[] = {
+        formatLevel(meter.getMomentary(), "LUFS"),
+        formatLevel(meter.getShortTerm(), "LUFS"),
+        formatLevel(meter.getIntegrated(), "LUFS"),
+        formatLevel(juce::jmax(meter.getTruePeakMax(0), meter.getTruePeakMax(1)), "dBTP"),
+    };
+
+    g.setFont(ui::monoFont());
+    for (int i = 0; i < 4; ++i) {
+        auto row = rows.removeFromTop(rowHeight);
+        const auto label = row.removeFromLeft(kLabelWidth);
+        const auto value = row.removeFromRight(kValueWidth);
+        const auto lane = row.reduced(6, 2).toFloat();
+
+        g.setColour(ui::kMutedTextColour);
+        g.drawText(labels[i], label, juce::Justification::centredLeft, false);
+
+        // Over 0 dBTP, the peak is shown like the overs on the display.
+        const bool over = (i == 3 && juce::jmax(meter.getTruePeakMax(0), meter.getTruePeakMax(1)) > 0.0f);
+        g.setColour(over ? ui::kOverColour : ui::kTextColour);
+        g.drawText(values[i], value, juce::Justification::centredRight, false);
+
+        g.setColour(ui::kScopeBackgroundColour);
+        g.fillRect(lane);
+        if (i < 3) {
+            drawTrace(g, lane, traces[size_t(i)]);
+        } else {
+            drawTruePeak(g, lane);
+        }
+    }
+}
+
+void LoudnessLanes::drawTrace(juce::Graphics& g, juce::Rectangle<float> area, const Trace& trace) const
+{
+    // The oldest reading on the left. Silence leaves a gap.
+    juce::Path path;
+    bool joined = false;
+    for (int n = 0; n < kTraceLength; ++n) {
+        const float level = trace.values[size_t((trace.position + n) % kTraceLength)];
+        if (!std::isfinite(level)) {
+            joined = false;
+            continue;
+        }
+
+        const float x = area.getX() + float(n) * area.getWidth() / float(kTraceLength - 1);
+        const float y = levelToY(area, level);
+        if (joined) {
+            path.lineTo(x, y);
+        } else {
+            path.startNewSubPath(x, y);
+        }
+        joined = true;
+    }
+
+    g.setColour(ui::kWaveInterpolatedColour);
+    g.strokePath(path, juce::PathStrokeType(1.0f));
+}
+
+void LoudnessLanes::drawTruePeak(juce::Graphics& g, juce::Rectangle<float> area) const
+{
+    // One bar per channel, with the maximum as a tick.
+    const int numChannels = meter.getNumChannels();
+    auto bars = area;
+    for (int c = 0; c < numChannels; ++c) {
+        auto bar = bars.removeFromTop(area.getHeight() / float(numChannels)).reduced(0.0f, 1.0f);
+        const float peak = meter.getTruePeak(c);
+        const float peakMax = meter.getTruePeakMax(c);
+
+        if (std::isfinite(peak)) {
+            g.setColour(peak > 0.0f ? ui::kOverColour : ui::kWaveDenseColour);
+            g.fillRect(bar.withRight(levelToX(bar, peak)));
+        }
+        if (std::isfinite(peakMax)) {
+            g.setColour(peakMax > 0.0f ? ui::kOverColour : ui::kAccentColour);
+            g.fillRect(levelToX(bar, peakMax) - 1.0f, bar.getY(), 2.0f, bar.getHeight());
+        }
+    }
+
+    g.setColour(ui::kZeroLineColour);
+    g.drawVerticalLine(int(levelToX(area, 0.0f)), area.getY(), area.getBottom());
+}
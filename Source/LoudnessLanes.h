@@ -0,0 +1,46 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LoudnessMeter.h"
+
+/*
+  The loudness meter's readings as lanes under the display: momentary,
+  short-term and integrated loudness, each with its value and a trace of
+  the last 20 seconds, and the true peak of every channel as a bar with its
+  maximum. Clicking the lanes starts the integrated loudness and the
+  maximum over.
+*/
+class LoudnessLanes : public juce::Component,
+                      public juce::SettableTooltipClient
+{
+public:
+    explicit LoudnessLanes(LoudnessMeter& meter);
+
+    // Takes the latest readings. Call this from the editor's timer.
+    void update();
+
+    void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& event) override;
+
+    static constexpr int kPreferredHeight = 96;
+
+private:
+    // 20 s of timer ticks at 30 Hz.
+    static constexpr int kTraceLength = 600;
+
+    struct Trace
+    {
+        std::array<float, kTraceLength> values;
+        int position = 0;
+    };
+
+    void drawTrace(juce::Graphics& g, juce::Rectangle<float> area, const Trace& trace) const;
+    void drawTruePeak(juce::Graphics& g, juce::Rectangle<float> area) const;
+
+    LoudnessMeter& meter;
+
+    // Momentary, short-term and integrated.
+    std::array<Trace, 3> traces;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessLanes)
+};
@@ -0,0 +1,243 @@
+#include "LoudnessMeter.h"
+#include "RealtimeCheck.h"
+
+LoudnessMeter::LoudnessMeter()
+{
+    // Like Mexoscope's filters, the coefficient objects are only ever
+    // overwritten after this, so the audio thread never allocates.
+    shelfFilter.coefficients = new juce::dsp::IIR::Coefficients<float>(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+    highPassFilter.coefficients = new juce::dsp::IIR::Coefficients<float>(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+
+    float coefficients[kTruePeakFactor * kTaps];
+    Mexoscope::makeTruePeakFilter(kTruePeakFactor, coefficients);
+    for (size_t i = 0; i < truePeakTaps.size(); ++i) {
+        truePeakTaps[i] = Lanes::expand(coefficients[i]);
+    }
+
+    prepare(44100.0);
+}
+
+void LoudnessMeter::prepare(double sampleRate)
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+
+    // The two K-weighting stages of BS.1770, a high shelf for the head and
+    // a high pass, worked out for any sample rate. At 48 kHz these are the
+    // coefficients in the standard.
+    {
+        const double f0 = 1681.974450955533;
+        const double gainDb = 3.999843853973347;
+        const double q = 0.7071752369554196;
+        const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        const double vh = std::pow(10.0, gainDb / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        *shelfFilter.coefficients = std::array<float, 6> {
+            float(vh + vb * k / q + k * k), float(2.0 * (k * k - vh)), float(vh - vb * k / q + k * k),
+            float(1.0 + k / q + k * k), float(2.0 * (k * k - 1.0)), float(1.0 - k / q + k * k),
+        };
+    }
+    {
+        const double f0 = 38.13547087602444;
+        const double q = 0.5003270373238773;
+        const double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+        *highPassFilter.coefficients = std::array<float, 6> {
+            1.0f, -2.0f, 1.0f,
+            float(1.0 + k / q + k * k), float(2.0 * (k * k - 1.0)), float(1.0 - k / q + k * k),
+        };
+    }
+
+    stepLength = juce::jmax(1, juce::roundToInt(sampleRate * 0.1));
+    restart();
+}
+
+void LoudnessMeter::restart()
+{
+    shelfFilter.reset();
+    highPassFilter.reset();
+    truePeakHistory.fill(Lanes::expand(0.0f));
+    truePeakPosition = 0;
+
+    stepRemaining = stepLength;
+    stepPower = Lanes::expand(0.0f);
+    stepPeak = Lanes::expand(0.0f);
+    peakMax.fill(0.0f);
+
+    steps.fill(0.0);
+    stepIndex = 0;
+    numSteps = 0;
+    binCounts.fill(0);
+    binPowers.fill(0.0);
+
+    momentary.store(kSilence, std::memory_order_relaxed);
+    shortTerm.store(kSilence, std::memory_order_relaxed);
+    integrated.store(kSilence, std::memory_order_relaxed);
+    for (int c = 0; c < kMaxChannels; ++c) {
+        truePeak[size_t(c)].store(kSilence, std::memory_order_relaxed);
+        truePeakMax[size_t(c)].store(kSilence, std::memory_order_relaxed);
+    }
+}
+
+float LoudnessMeter::powerToLoudness(double power)
+{
+    return (power > 0.0) ? float(-0.691 + 10.0 * std::log10(power)) : kSilence;
+}
+
+template <typename SampleType>
+void LoudnessMeter::process(const juce::AudioBuffer<SampleType>& buffer)
+{
+    if (!enabled.load(std::memory_order_relaxed)) {
+        wasEnabled = false;
+        return;
+    }
+    if (resetRequested.exchange(false) || !wasEnabled) {
+        restart();
+        wasEnabled = true;
+    }
+
+    // A mono input is measured as one channel, not as two identical ones.
+    const int channels = juce::jlimit(1, kMaxChannels, buffer.getNumChannels());
+    numChannels.store(channels, std::memory_order_relaxed);
+    if (buffer.getNumChannels() == 0) {
+        return;
+    }
+
+    const SampleType* inputs[kMaxChannels] = {};
+    for (int c = 0; c < channels; ++c) {
+        inputs[c] = buffer.getReadPointer(c);
+    }
+
+    const auto zero = Lanes::expand(0.0f);
+    for (int i = 0; i < buffer.getNumSamples(); ++i) {
+        alignas(32) float frame[Lanes::size()] = {};
+        for (int c = 0; c < channels; ++c) {
+            frame[c] = float(inputs[c][i]);
+        }
+        const auto x = Lanes::fromRawArray(frame);
+
+        // True peak: the sample itself and the points in between.
+        truePeakPosition = (truePeakPosition + kTaps - 1) % kTaps;
+        truePeakHistory[size_t(truePeakPosition)] = x;
+        truePeakHistory[size_t(truePeakPosition + kTaps)] = x;
+
+        auto peak = Lanes::max(x, zero - x);
+        for (int phase = 0; phase < kTruePeakFactor; ++phase) {
+            const auto* taps = truePeakTaps.data() + phase * kTaps;
+            const auto* history = truePeakHistory.data() + truePeakPosition;
+            auto sum = zero;
+            for (int tap = 0; tap < kTaps; ++tap) {
+                sum += history[tap] * taps[tap];
+            }
+            peak = Lanes::max(peak, Lanes::max(sum, zero - sum));
+        }
+        stepPeak = Lanes::max(stepPeak, peak);
+
+        // Loudness: the mean square of the K-weighted signal.
+        const auto weighted = highPassFilter.processSample(shelfFilter.processSample(x));
+        stepPower += weighted * weighted;
+
+        if (--stepRemaining == 0) {
+            finishStep();
+            stepRemaining = stepLength;
+        }
+    }
+}
+
+void LoudnessMeter::finishStep()
+{
+    alignas(32) float power[Lanes::size()];
+    alignas(32) float peak[Lanes::size()];
+    stepPower.copyToRawArray(power);
+    stepPeak.copyToRawArray(peak);
+    stepPower = Lanes::expand(0.0f);
+    stepPeak = Lanes::expand(0.0f);
+
+    // Left and right both weigh 1.
+    const int channels = numChannels.load(std::memory_order_relaxed);
+    double total = 0.0;
+    for (int c = 0; c < channels; ++c) {
+        total += double(power[c]);
+    }
+
+    // A NaN or an infinity in the input would stay in the K-weighting
+    // filters for good, and every reading after it would be lost. The
+    // filters start again instead, and so do the momentary and short-term
+    // loudness, so that no gating block with this step in it goes into the
+    // histogram.
+    if (!std::isfinite(total)) {
+        shelfFilter.reset();
+        highPassFilter.reset();
+        truePeakHistory.fill(Lanes::expand(0.0f));
+        numSteps = 0;
+        momentary.store(kSilence, std::memory_order_relaxed);
+        shortTerm.store(kSilence, std::memory_order_relaxed);
+        return;
+    }
+
+    steps[size_t(stepIndex)] = total / double(stepLength);
+    stepIndex = (stepIndex + 1) % kNumSteps;
+    numSteps = juce::jmin(numSteps + 1, kNumSteps);
+
+    // The latest steps first.
+    double blockPower = 0.0, shortTermPower = 0.0;
+    for (int k = 0; k < numSteps; ++k) {
+        const double p = steps[size_t((stepIndex - 1 - k + kNumSteps) % kNumSteps)];
+        shortTermPower += p;
+        if (k < kStepsPerBlock) {
+            blockPower += p;
+        }
+    }
+    blockPower /= double(juce::jmin(numSteps, kStepsPerBlock));
+    shortTermPower /= double(numSteps);
+
+    momentary.store(powerToLoudness(blockPower), std::memory_order_relaxed);
+    shortTerm.store(powerToLoudness(shortTermPower), std::memory_order_relaxed);
+
+    // Every step completes a gating block, once there are enough of them.
+    if (numSteps >= kStepsPerBlock) {
+        const float loudness = powerToLoudness(blockPower);
+        if (loudness > kHistogramFloor) {
+            const int bin = juce::jlimit(0, kNumBins - 1, int((loudness - kHistogramFloor) / kBinWidth));
+            binCounts[size_t(bin)]++;
+            binPowers[size_t(bin)] += blockPower;
+            updateIntegrated();
+        }
+    }
+
+    for (int c = 0; c < channels; ++c) {
+        peakMax[size_t(c)] = juce::jmax(peakMax[size_t(c)], peak[c]);
+        truePeak[size_t(c)].store(peak[c] > 0.0f ? 20.0f * std::log10(peak[c]) : kSilence, std::memory_order_relaxed);
+        truePeakMax[size_t(c)].store(peakMax[size_t(c)] > 0.0f ? 20.0f * std::log10(peakMax[size_t(c)]) : kSilence,
+                                     std::memory_order_relaxed);
+    }
+}
+
+void LoudnessMeter::updateIntegrated()
+{
+    // Every block in the histogram is above the absolute gate. The relative
+    // gate is 10 LU under their loudness.
+    double total = 0.0;
+    uint64_t count = 0;
+    for (int bin = 0; bin < kNumBins; ++bin) {
+        total += binPowers[size_t(bin)];
+        count += binCounts[size_t(bin)];
+    }
+    if (count == 0) {
+        integrated.store(kSilence, std::memory_order_relaxed);
+        return;
+    }
+
+    // Only whole bins above the relative gate count.
+    const float relativeGate = powerToLoudness(total / double(count)) - 10.0f;
+    const int firstBin = juce::jlimit(0, kNumBins, int(std::ceil((relativeGate - kHistogramFloor) / kBinWidth)));
+
+    total = 0.0;
+    count = 0;
+    for (int bin = firstBin; bin < kNumBins; ++bin) {
+        total += binPowers[size_t(bin)];
+        count += binCounts[size_t(bin)];
+    }
+    integrated.store(count > 0 ? powerToLoudness(total / double(count)) : kSilence, std::memory_order_relaxed);
+}
+
+template void LoudnessMeter::process(const juce::AudioBuffer<float>&);
+template void LoudnessMeter::process(const juce::AudioBuffer<double>&);
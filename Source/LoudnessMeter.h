@@ -0,0 +1,128 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Mexoscope.h"
+
+/*
+  Loudness and true-peak metering of the main input, following ITU-R
+  BS.1770-4 and EBU R 128: momentary (400 ms), short-term (3 s) and
+  integrated loudness in LUFS, and the true peak of every channel in dBTP.
+
+  The audio thread runs the K-weighting filters on both channels at once,
+  one channel per SIMD lane like Mexoscope's filters, and sums the power in
+  100 ms steps. Every step completes a 400 ms gating block. Integrated
+  loudness needs all gating blocks since the start, so rather than keeping
+  a list that grows for as long as the meter runs, the blocks go into a
+  histogram of 0.1 LU bins that keeps the count and the summed power of
+  each bin. The gates then only ever look at a fixed number of bins, and
+  the result only differs from the exact one in which blocks right at the
+  relative gate are counted.
+
+  The true peak is the largest of the input oversampled 4 times, with the
+  same interpolation filter as the display's true-peak mode.
+
+  Unlike the capture, the meter runs whenever it's enabled, also while the
+  editor is closed, so it can follow a whole session.
+*/
+class LoudnessMeter
+{
+public:
+    static constexpr int kMaxChannels = 2;
+
+    // The loudness that's reported when there's none, e.g. for silence.
+    static constexpr float kSilence = -std::numeric_limits<float>::infinity();
+
+    LoudnessMeter();
+
+    // Not while processing. Works out the filters for the sample rate and
+    // starts over.
+    void prepare(double sampleRate);
+
+    // Audio thread. Only the first two channels are measured.
+    template <typename SampleType>
+    void process(const juce::AudioBuffer<SampleType>& buffer);
+
+    // Any thread. The meter starts over when it's enabled.
+    void setEnabled(bool shouldBeEnabled) { enabled.store(shouldBeEnabled); }
+    bool isEnabled() const { return enabled.load(); }
+
+    // Any thread. Starts the integrated loudness and the true-peak maximum
+    // over, at the start of the next block.
+    void reset() { resetRequested.store(true); }
+
+    // Any thread. The latest readings, in LUFS and dBTP.
+    float getMomentary() const { return momentary.load(std::memory_order_relaxed); }
+    float getShortTerm() const { return shortTerm.load(std::memory_order_relaxed); }
+    float getIntegrated() const { return integrated.load(std::memory_order_relaxed); }
+    int getNumChannels() const { return numChannels.load(std::memory_order_relaxed); }
+
+    // The largest true peak of the last 100 ms step, and since the start.
+    float getTruePeak(int channel) const { return truePeak[size_t(channel)].load(std::memory_order_relaxed); }
+    float getTruePeakMax(int channel) const { return truePeakMax[size_t(channel)].load(std::memory_order_relaxed); }
+
+private:
+    using Lanes = juce::dsp::SIMDRegister<float>;
+    static_assert(Lanes::size() >= kMaxChannels, "need a SIMD lane for every channel");
+
+    static constexpr int kTruePeakFactor = 4;
+    static constexpr int kTaps = Mexoscope::kTruePeakTaps;
+
+    // 3 s of 100 ms steps for the short-term loudness, 4 of them make a
+    // gating block.
+    static constexpr int kNumSteps = 30;
+    static constexpr int kStepsPerBlock = 4;
+
+    // The histogram spans the absolute gate at -70 LUFS up to +10 LUFS.
+    static constexpr float kHistogramFloor = -70.0f;
+    static constexpr float kBinWidth = 0.1f;
+    static constexpr int kNumBins = 800;
+
+    void restart();
+
+    // Ends a 100 ms step: updates the readings and adds the gating block
+    // that ends here. A step whose power isn't finite is left out.
+    void finishStep();
+    void updateIntegrated();
+
+    static float powerToLoudness(double power);
+
+    juce::dsp::IIR::Filter<Lanes> shelfFilter;
+    juce::dsp::IIR::Filter<Lanes> highPassFilter;
+
+    // The true-peak filter, `truePeakTaps[phase * kTaps + tap]` with the
+    // same coefficient in every lane. The last samples are kept twice, so
+    // the newest `kTaps` are always next to each other, newest first, at
+    // `truePeakPosition`.
+    std::array<Lanes, kTruePeakFactor * kTaps> truePeakTaps;
+    std::array<Lanes, kTaps * 2> truePeakHistory;
+    int truePeakPosition = 0;
+
+    // The sum of the K-weighted power and the largest true peak of the
+    // current step, per lane.
+    int stepLength = 4800;
+    int stepRemaining = 4800;
+    Lanes stepPower;
+    Lanes stepPeak;
+    std::array<float, kMaxChannels> peakMax {};
+
+    // The mean power of the last `kNumSteps` steps.
+    std::array<double, kNumSteps> steps {};
+    int stepIndex = 0;
+    int numSteps = 0;
+
+    std::array<uint32_t, kNumBins> binCounts {};
+    std::array<double, kNumBins> binPowers {};
+
+    bool wasEnabled = false;
+    std::atomic<bool> enabled { false };
+    std::atomic<bool> resetRequested { false };
+
+    std::atomic<float> momentary { kSilence };
+    std::atomic<float> shortTerm { kSilence };
+    std::atomic<float> integrated { kSilence };
+    std::atomic<int> numChannels { kMaxChannels };
+    std::array<std::atomic<float>, kMaxChannels> truePeak;
+    std::array<std::atomic<float>, kMaxChannels> truePeakMax;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoudnessMeter)
+};
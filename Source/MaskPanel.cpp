@@ -0,0 +1,174 @@
+#include "MaskPanel.h"
+#include "UiTheme.h"
+
+namespace {
+constexpr int kPadding = 8;
+constexpr int kRowHeight = 24;
+
+const int tolerances[] = { 2, 4, 8, 16 };
+
+juce::String formatTimestamp(juce::int64 samples, double sampleRate)
+{
+    return juce::String(double(samples) / sampleRate, 3) + " s";
+}
+}
+
+MaskPanel::MaskPanel(MexoscopeAudioProcessor& p)
+    : processor(p), maskTest(p.mexoscope.getMaskTest())
+{
+    for (int i = 0; i < int(std::size(tolerances)); ++i) {
+        toleranceBox.addItem(juce::String::fromUTF8("\xc2\xb1") + juce::String(tolerances[i]) + " px", i + 1);
+    }
+    toleranceBox.setSelectedId(2, juce::dontSendNotification);
+    toleranceBox.setTooltip("How far the signal may stray from the captured frame");
+
+    captureButton.setTooltip("Make a mask from the frame on screen and test every frame against it");
+    captureButton.onClick = [this] { captureMask(); };
+
+    clearButton.setTooltip("Stop testing and forget the mask and the failures");
+    clearButton.onClick = [this] {
+        processor.stopMaskTest();
+        selectedIndex = -1;
+        update();
+    };
+
+    exportButton.setTooltip("Write the results and the failed frames to a CSV file");
+    exportButton.onClick = [this] { exportFailures(); };
+
+    browser.setSliderStyle(juce::Slider::LinearHorizontal);
+    browser.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    browser.setRange(0.0, 1.0, 1.0);
+    browser.setTooltip("Browse the frames that failed");
+    browser.onValueChange = [this] { update(); };
+
+    addAndMakeVisible(toleranceBox);
+    addAndMakeVisible(captureButton);
+    addAndMakeVisible(clearButton);
+    addAndMakeVisible(exportButton);
+    addAndMakeVisible(browser);
+}
+
+void MaskPanel::captureMask()
+{
+    // The frame that's on screen: the average if there is one, otherwise
+    // the last complete frame.
+    Mexoscope::PeaksArray frame = processor.mexoscope.getCopy();
+    if (processor.getAverager().getMode() != SignalAverager::Mode::Off) {
+        processor.getAverager().getFrame(frame);
+    }
+
+    const int tolerance = tolerances[juce::jmax(0, toleranceBox.getSelectedItemIndex())];
+    const auto mask = MaskTest::makeMask(frame, tolerance,
+                                         processor.mexoscope.getParameter(Mexoscope::kTimeWindow),
+                                         processor.mexoscope.getParameter(Mexoscope::kAmpWindow));
+
+    if (!processor.startMaskTest(mask)) {
+        captureButton.setTooltip("Not enough memory for the mask test");
+    }
+    selectedIndex = -1;
+    update();
+}
+
+void MaskPanel::exportFailures()
+{
+    const auto file = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                          .getNonexistentChildFile("mexoscope-mask", ".csv");
+    if (maskTest.exportTo(file)) {
+        exportButton.setTooltip("Exported to " + file.getFullPathName());
+    } else {
+        exportButton.setTooltip("Export failed");
+    }
+}
+
+void MaskPanel::update()
+{
+    clearButton.setEnabled(maskTest.isActive());
+    exportButton.setEnabled(maskTest.isActive());
+
+    const int numKept = maskTest.getNumFailuresKept();
+    browser.setEnabled(numKept > 0);
+    if (numKept > 0) {
+        // Follow the newest failure, unless the user went back to an
+        // earlier one.
+        const bool following = (selectedIndex < 0 || selectedIndex >= lastNumKept - 1);
+        browser.setRange(0.0, double(juce::jmax(1, numKept - 1)), 1.0);
+        if (following) {
+            browser.setValue(double(numKept - 1), juce::dontSendNotification);
+        }
+    }
+    lastNumKept = numKept;
+
+    const int index = (numKept > 0) ? juce::jlimit(0, numKept - 1, int(browser.getValue())) : -1;
+    if (index != selectedIndex) {
+        selectedIndex = index;
+        if (index >= 0) {
+            const auto& failure = maskTest.getFailure(index);
+            for (size_t j = 0; j < selectedFrame.size(); ++j) {
+                selectedFrame[j] = { int(j / 2), int(failure.y[j]) };
+            }
+        }
+    }
+
+    repaint();
+}
+
+const Mexoscope::PeaksArray* MaskPanel::getSelectedFrame() const
+{
+    return (selectedIndex >= 0) ? &selectedFrame : nullptr;
+}
+
+void MaskPanel::paint(juce::Graphics& g)
+{
+    const auto bounds = getLocalBounds().toFloat();
+    g.setColour(ui::kPanelColour.withAlpha(0.9f));
+    g.fillRoundedRectangle(bounds, 6.0f);
+    g.setColour(ui::kPanelEdgeColour);
+    g.drawRoundedRectangle(bounds.reduced(0.5f), 6.0f, 1.0f);
+
+    const auto* mask = maskTest.getMask();
+    const auto results = maskTest.getResults();
+    const double sampleRate = processor.mexoscope.getSampleRate();
+
+    juce::String status;
+    if (mask == nullptr) {
+        status = "No mask";
+    } else if (mask->timeWindow != processor.mexoscope.getParameter(Mexoscope::kTimeWindow)
+               || mask->ampWindow != processor.mexoscope.getParameter(Mexoscope::kAmpWindow)) {
+        status = "Paused, Time or Amp changed";
+    } else {
+        status = "Pass " + juce::String(juce::int64(results.numTested - results.numFailed))
+                 + "  Fail " + juce::String(juce::int64(results.numFailed));
+        if (results.lastFailure >= 0) {
+            status << "  last at " << formatTimestamp(results.lastFailure, sampleRate);
+        }
+    }
+
+    if (selectedIndex >= 0) {
+        const auto& failure = maskTest.getFailure(selectedIndex);
+        status << "  |  " << (selectedIndex + 1) << "/" << maskTest.getNumFailuresKept()
+               << " at " << formatTimestamp(failure.timestamp, sampleRate);
+    }
+
+    g.setColour(results.numFailed > 0 ? ui::kMaskColour : ui::kTextColour);
+    g.setFont(ui::monoFont());
+    g.drawText(status, statusBounds, juce::Justification::centredLeft, true);
+}
+
+void MaskPanel::resized()
+{
+    auto area = getLocalBounds().reduced(kPadding);
+
+    auto top = area.removeFromTop(kRowHeight);
+    toleranceBox.setBounds(top.removeFromLeft(90));
+    top.removeFromLeft(4);
+    captureButton.setBounds(top.removeFromLeft(72));
+    top.removeFromLeft(4);
+    clearButton.setBounds(top.removeFromLeft(64));
+    top.removeFromLeft(4);
+    exportButton.setBounds(top.removeFromLeft(64));
+    top.removeFromLeft(8);
+    statusBounds = top;
+
+    area.removeFromTop(kPadding);
+    browser.setBounds(area.removeFromTop(kRowHeight));
+}
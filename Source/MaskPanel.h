@@ -0,0 +1,45 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+/*
+  Controls for the mask test: making a mask from the frame that's on screen,
+  the pass/fail counts, browsing the frames that failed, and exporting them.
+*/
+class MaskPanel : public juce::Component
+{
+public:
+    explicit MaskPanel(MexoscopeAudioProcessor& processor);
+
+    // Follows the results. Call this from the editor's timer.
+    void update();
+
+    // The failed frame that's selected, or nullptr if there isn't one.
+    const Mexoscope::PeaksArray* getSelectedFrame() const;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+    static constexpr int kPreferredHeight = 72;
+
+private:
+    void captureMask();
+    void exportFailures();
+
+    MexoscopeAudioProcessor& processor;
+    MaskTest& maskTest;
+
+    juce::ComboBox toleranceBox;
+    juce::TextButton captureButton { "Capture" };
+    juce::TextButton clearButton { "Clear" };
+    juce::TextButton exportButton { "Export" };
+    juce::Slider browser;
+    juce::Rectangle<int> statusBounds;
+
+    Mexoscope::PeaksArray selectedFrame;
+    int selectedIndex = -1;
+    int lastNumKept = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MaskPanel)
+};
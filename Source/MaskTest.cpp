@@ -0,0 +1,160 @@
+#include "MaskTest.h"
+#include "RealtimeCheck.h"
+#include <new>
+
+struct MaskTest::Storage
+{
+    Mask mask;
+    std::vector<Failure> failures;
+
+    // Failures below this index are complete and never change again.
+    std::atomic<int> numKept { 0 };
+};
+
+MaskTest::Mask MaskTest::makeMask(const Frame& frame, int tolerance, float timeWindow, float ampWindow)
+{
+    Mask mask;
+    mask.timeWindow = timeWindow;
+    mask.ampWindow = ampWindow;
+
+    // Both readings of a column share the same limits. Looking at the
+    // neighbouring columns too allows for a little trigger jitter.
+    for (int column = 0; column < OSC_WIDTH; ++column) {
+        int top = OSC_HEIGHT;
+        int bottom = -1;
+        for (int k = juce::jmax(0, column - tolerance); k <= juce::jmin(OSC_WIDTH - 1, column + tolerance); ++k) {
+            top = juce::jmin(top, frame[size_t(k * 2)].y, frame[size_t(k * 2 + 1)].y);
+            bottom = juce::jmax(bottom, frame[size_t(k * 2)].y, frame[size_t(k * 2 + 1)].y);
+        }
+
+        mask.top[size_t(column * 2)] = mask.top[size_t(column * 2 + 1)] = top - tolerance;
+        mask.bottom[size_t(column * 2)] = mask.bottom[size_t(column * 2 + 1)] = bottom + tolerance;
+    }
+    return mask;
+}
+
+MaskTest::~MaskTest()
+{
+    clear();
+}
+
+bool MaskTest::start(const Mask& mask)
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    clear();
+
+    auto newStorage = std::make_unique<Storage>();
+    newStorage->mask = mask;
+
+    try {
+        newStorage->failures.resize(size_t(kMaxFailures));
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+
+    // Nothing is testing now, so the results can't be bumped between
+    // resetting them and publishing the new mask.
+    numTested.store(0);
+    numFailed.store(0);
+    lastFailure.store(-1);
+
+    storage.publish(newStorage.release());
+    return true;
+}
+
+void MaskTest::clear()
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    delete storage.retire();
+}
+
+const MaskTest::Mask* MaskTest::getMask() const
+{
+    const auto* current = storage.get();
+    return current != nullptr ? &current->mask : nullptr;
+}
+
+int MaskTest::getNumFailuresKept() const
+{
+    const auto* current = storage.get();
+    return current != nullptr ? current->numKept.load(std::memory_order_acquire) : 0;
+}
+
+const MaskTest::Failure& MaskTest::getFailure(int index) const
+{
+    const auto* current = storage.get();
+    jassert(current != nullptr && juce::isPositiveAndBelow(index, current->numKept.load()));
+    return current->failures[size_t(index)];
+}
+
+MaskTest::Results MaskTest::getResults() const
+{
+    Results results;
+    results.numTested = numTested.load(std::memory_order_relaxed);
+    results.numFailed = numFailed.load(std::memory_order_relaxed);
+    results.lastFailure = lastFailure.load(std::memory_order_relaxed);
+    return results;
+}
+
+bool MaskTest::exportTo(const juce::File& file) const
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    const auto results = getResults();
+    const int numKept = getNumFailuresKept();
+
+    juce::String text;
+    text << "# tested " << juce::int64(results.numTested) << ", failed " << juce::int64(results.numFailed) << "\n";
+    text << "failure,timestamp,violations,readings\n";
+
+    for (int i = 0; i < numKept; ++i) {
+        const auto& failure = getFailure(i);
+        text << i << "," << failure.timestamp << "," << failure.numViolations;
+        for (const auto y : failure.y) {
+            text << "," << int(y);
+        }
+        text << "\n";
+    }
+
+    return file.replaceWithText(text);
+}
+
+MaskTest::Checker::Checker(MaskTest& t, float timeWindow, float ampWindow)
+    : test(t), reader(t.storage), storage(reader.get())
+{
+    active = storage != nullptr && storage->mask.timeWindow == timeWindow && storage->mask.ampWindow == ampWindow;
+}
+
+bool MaskTest::Checker::check(const Frame& frame, int numColumns, juce::int64 timestamp) noexcept
+{
+    const auto& mask = storage->mask;
+    const int numReadings = juce::jmin(numColumns, OSC_WIDTH) * 2;
+
+    // Counts the readings outside the mask. This has no branches and no
+    // early exit, so the compiler vectorises it.
+    int violations = 0;
+    for (int j = 0; j < numReadings; ++j) {
+        const int y = frame[size_t(j)].y;
+        violations += int(y < mask.top[size_t(j)]) + int(y > mask.bottom[size_t(j)]);
+    }
+
+    // Only this thread writes the results.
+    test.numTested.store(test.numTested.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (violations == 0) {
+        return true;
+    }
+
+    test.numFailed.store(test.numFailed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    test.lastFailure.store(timestamp, std::memory_order_relaxed);
+
+    const int kept = storage->numKept.load(std::memory_order_relaxed);
+    if (kept < kMaxFailures) {
+        auto& failure = storage->failures[size_t(kept)];
+        failure.timestamp = timestamp;
+        failure.numViolations = violations;
+        for (size_t j = 0; j < failure.y.size(); ++j) {
+            failure.y[j] = int16_t(int(j) < numReadings ? frame[j].y : OSC_CENTER);
+        }
+        storage->numKept.store(kept + 1, std::memory_order_release);
+    }
+    return false;
+}
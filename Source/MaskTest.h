@@ -0,0 +1,116 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "RetiringPointer.h"
+#include "Defines.h"
+
+/*
+  Pass/fail testing against a tolerance mask. The mask is the smallest and
+  largest y-value allowed for every reading of a frame, usually made from a
+  good frame widened by a few pixels. Every frame that runs from one trigger
+  to the next is compared against it on the audio thread, right when the
+  trigger completes it. Frames with readings outside the mask are counted
+  with the host sample position of the trigger that started them, and the
+  first `kMaxFailures` of them are kept for browsing.
+
+  The mask is in pixels, so it only applies at the Time and Amp settings it
+  was made at. Frames captured at other settings aren't tested.
+
+  Like SegmentPool, the storage is allocated by `start` on the message
+  thread and the audio thread only uses it through a Checker.
+*/
+class MaskTest
+{
+private:
+    struct Storage;
+
+public:
+    // Same layout as Mexoscope::PeaksArray.
+    using Frame = std::array<juce::Point<int>, OSC_WIDTH * 2>;
+
+    struct Mask
+    {
+        // Allowed range for every reading, in the same order as the frames.
+        std::array<int, OSC_WIDTH * 2> top {};
+        std::array<int, OSC_WIDTH * 2> bottom {};
+
+        // The Time and Amp parameters the mask was made at.
+        float timeWindow = 0.0f;
+        float ampWindow = 0.0f;
+    };
+
+    struct Failure
+    {
+        juce::int64 timestamp = 0;
+        int numViolations = 0;
+        std::array<int16_t, OSC_WIDTH * 2> y {};
+    };
+
+    struct Results
+    {
+        uint64_t numTested = 0;
+        uint64_t numFailed = 0;
+        juce::int64 lastFailure = -1;
+    };
+
+    static constexpr int kMaxFailures = 1000;
+
+    // Makes a mask from a frame, or from an envelope laid out as top and
+    // bottom per column, widened by `tolerance` pixels in every direction.
+    static Mask makeMask(const Frame& frame, int tolerance, float timeWindow, float ampWindow);
+
+    MaskTest() = default;
+    ~MaskTest();
+
+    // Message thread. Starts testing against a new mask, which also resets
+    // the results. Returns false if there isn't enough memory.
+    bool start(const Mask& mask);
+
+    // Message thread. Stops testing and throws away the mask and failures.
+    void clear();
+
+    // Message thread.
+    bool isActive() const { return storage.get() != nullptr; }
+    const Mask* getMask() const;
+    int getNumFailuresKept() const;
+    const Failure& getFailure(int index) const;
+
+    // Writes the results and the kept failures into a CSV file.
+    bool exportTo(const juce::File& file) const;
+
+    // Any thread.
+    Results getResults() const;
+
+    // Audio thread. Holds on to the mask while testing against it.
+    class Checker
+    {
+    public:
+        Checker(MaskTest& test, float timeWindow, float ampWindow);
+
+        // Whether there's a mask for the current settings.
+        bool isActive() const noexcept { return active; }
+
+        // Tests the first `numColumns` columns of a frame that started at
+        // the given host sample position. Returns false if it failed.
+        bool check(const Frame& frame, int numColumns, juce::int64 timestamp) noexcept;
+
+    private:
+        MaskTest& test;
+        RetiringPointer<Storage>::Reader reader;
+        Storage* storage;
+        bool active;
+
+        JUCE_DECLARE_NON_COPYABLE(Checker)
+    };
+
+private:
+    RetiringPointer<Storage> storage;
+
+    // These outlive the storage, so they can be read from anywhere. Only
+    // the audio thread writes them while a mask is set.
+    std::atomic<uint64_t> numTested { 0 };
+    std::atomic<uint64_t> numFailed { 0 };
+    std::atomic<juce::int64> lastFailure { -1 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MaskTest)
+};
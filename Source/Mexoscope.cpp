@@ -1,5 +1,9 @@
 #include "Mexoscope.h"
+#include "MexoscopeReference.h"
+#include "RealtimeCheck.h"
 #include <cmath>
+#include <cstring>
+#include <limits>
 
 Mexoscope::Mexoscope()
 {
@@ -12,184 +16,970 @@ Mexoscope::Mexoscope()
         copy[j] = tmp;
     }
 
-    // Default parameter values.
-    setParameter(kTriggerSpeed, 0.5f);
-    setParameter(kTriggerType, 0.0f);
-    setParameter(kTriggerLevel, 0.5f);
-    setParameter(kTriggerLimit, 0.5f);
-    setParameter(kTimeWindow, 0.75f);
-    setParameter(kAmpWindow, 0.5f);
-    setParameter(kSyncDraw, 0.0f);
-    setParameter(kChannel, 0.0f);
-    setParameter(kFreeze, 0.0f);
-    setParameter(kDCKill, 0.0f);
+    // Default parameter values. Nothing is running yet, so these can go
+    // straight into the audio thread's copy instead of through the queue.
+    const float defaults[kNumParams] = {
+        0.5f,   // kTriggerSpeed
+        0.0f,   // kTriggerType
+        0.5f,   // kTriggerLevel
+        0.5f,   // kTriggerLimit
+        0.75f,  // kTimeWindow
+        0.5f,   // kAmpWindow
+        0.0f,   // kSyncDraw
+        0.0f,   // kChannel
+        0.0f,   // kFreeze
+        0.0f,   // kDCKill
+        0.0f,   // kTriggerFilter
+        0.5f,   // kTriggerFreq
+        0.0f,   // kTriggerHyst
+        0.0f,   // kMathChannel
+        0.5f,   // kChannelTrim
+        0.5f,   // kChannelOffset
+        0.0f,   // kTruePeak
+    };
+
+    // The filters need coefficient objects before the parameters can be
+    // applied. After this they're only ever overwritten, so the audio thread
+    // never allocates. Resetting allocates the filter state.
+    dcFilter.coefficients = new juce::dsp::IIR::Coefficients<float>(1.0f, -1.0f, 1.0f, 0.0f);
+    triggerFilter.coefficients = new juce::dsp::IIR::Coefficients<float>(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+    dcFilter.reset();
+    triggerFilter.reset();
+
+    // The true-peak filters never change, only which banks are used.
+    size_t bank = 0;
+    for (const int factor : { 4, 8 }) {
+        float coefficients[kMaxOversampling * kTruePeakTaps];
+        makeTruePeakFilter(factor, coefficients);
+
+        for (int firstPhase = 0; firstPhase < factor; firstPhase += kPhasesPerBank, ++bank) {
+            for (int tap = 0; tap < kTruePeakTaps; ++tap) {
+                alignas(32) float phases[Lanes::size()] = {};
+                for (int j = 0; j < kPhasesPerBank; ++j) {
+                    phases[j] = coefficients[(firstPhase + j) * kTruePeakTaps + tap];
+                }
+                truePeakBanks[bank][size_t(tap)] = Lanes::fromRawArray(phases);
+            }
+        }
+    }
+
+#if MEXOSCOPE_REFERENCE_CHECK
+    reference = std::make_unique<MexoscopeReference>();
+#endif
+
+    for (int i = 0; i < kNumParams; ++i) {
+        SAVE[i] = defaults[i];
+        applyParameter(i, defaults[i]);
+#if MEXOSCOPE_REFERENCE_CHECK
+        reference->setParameter(i, defaults[i]);
+#endif
+    }
 }
 
-void Mexoscope::setParameter(int paramIndex, float value)
+// Out of line, so MexoscopeReference can stay an incomplete type in the header.
+Mexoscope::~Mexoscope() = default;
+
+int Mexoscope::getNumChoices(int paramIndex)
+{
+    switch (paramIndex) {
+        case kTriggerType:
+            return kNumTriggerTypes;
+        case kTriggerFilter:
+            return kNumTriggerFilters;
+        case kMathChannel:
+            return kNumMathChannels;
+        case kTruePeak:
+            return kNumTruePeakModes;
+        default:
+            return 0;
+    }
+}
+
+void Mexoscope::setParameter(int paramIndex, float value, int sampleOffset)
 {
-    SAVE[paramIndex] = value;
+    SAVE[paramIndex].store(value, std::memory_order_relaxed);
+
+    if (!parameterEvents.push({ sampleOffset, paramIndex, value })) {
+        parametersNeedResync.store(true);
+    }
 }
 
 float Mexoscope::getParameter(int paramIndex) const
 {
-    return SAVE[paramIndex];
+    return SAVE[paramIndex].load(std::memory_order_relaxed);
+}
+
+void Mexoscope::applyParameter(int paramIndex, float value)
+{
+    // Hosts often send the same value again, which changes nothing.
+    if (params[paramIndex] != value && paramIndex != kSyncDraw) {
+        // Only the gain and the way the frame is shown can change without
+        // throwing away the averaged sweeps.
+        if (paramIndex != kAmpWindow && paramIndex != kFreeze && paramIndex != kTruePeak) {
+            sweepGeneration++;
+        }
+
+        // The frame in progress is a mix of the old and new settings, so
+        // it can't be mask tested.
+        frameStartPosition = -1;
+    }
+
+    params[paramIndex] = value;
+
+    switch (paramIndex) {
+        case kAmpWindow:
+            // Linear amplification factor between 0.001 (= -60 dB) and 1000
+            // (+60 dB). Default value is 1.0 = 0 dB gain. Same formula as for
+            // the AMP knob text in the editor window.
+            gain = std::pow(10.0f, value * 6.0f - 3.0f);
+            break;
+        case kTriggerLevel:
+            // Linear level value between -1.0f and 1.0f.
+            triggerLevel = value * 2.0f - 1.0f;
+            break;
+        case kTriggerType:
+            // Convert the 0-1 float into one of the kTriggerXXX enum values.
+            triggerType = int(value * float(kNumTriggerTypes) + 0.0001f);
+            break;
+        case kTriggerLimit:
+            // This is a number of samples between 1 and 10000.
+            triggerLimit = int(std::pow(10.0, value * 4.0));
+            break;
+        case kTriggerSpeed:
+            // Increment for the phase of the oscillator for the Internal
+            // trigger mode. Normally the increment is freq/sample rate. This
+            // is why the TRIG SPEED knob multiplies this same value by the
+            // sample rate to show the frequency. Might have been easier to
+            // make the parameter the frequency and divide by the sample rate
+            // here instead, making the knob independent of sample rate.
+            // The oscillator carries on from where the old speed got it.
+            triggerPhase = triggerPhase + double(triggerElapsed) * triggerSpeed;
+            triggerElapsed = 0;
+            triggerSpeed = std::pow(10.0, value * 2.5 - 5.0);
+
+            // In Tempo mode the same knob picks the division.
+            tempoDivision = getTempoDivisionIndex(value);
+            break;
+        case kTimeWindow:
+            // Number of pixels per sample. Same formula as for the TIME knob
+            // text. If the TIME knob is at 30% or higher, `counterSpeed` will
+            // be less than 1.0 and a single pixel describes multiple samples.
+            // In that case, we do not store individual sample readings but the
+            // max/min over that range.
+            counterSpeed = std::pow(10.0, 1.5 - value * 5.0);
+
+            // One reading per sample when zoomed in, otherwise one every
+            // 1 / counterSpeed samples, starting with the trigger sample.
+            sweepLength = int(juce::jmin(double(SweepFifo::kMaxSweepLength),
+                                         std::ceil(double(OSC_WIDTH) / juce::jmin(counterSpeed, 1.0)) + 1.0));
+            break;
+        case kTriggerFilter:
+            triggerFilterType = int(value * float(kNumTriggerFilters) + 0.0001f);
+            triggerFilter.reset();
+            updateTriggerFilter();
+            break;
+        case kTriggerFreq:
+            updateTriggerFilter();
+            break;
+        case kTriggerHyst:
+            // Up to a quarter of the full range of the trigger level.
+            hysteresis = value * 0.5f;
+            break;
+        case kMathChannel:
+            mathChannel = int(value * float(kNumMathChannels) + 0.0001f);
+            break;
+        case kChannelTrim:
+            // Between -24 and +24 dB, exactly 1.0 in the middle.
+            channelTrim = std::pow(10.0f, (value * 48.0f - 24.0f) / 20.0f);
+            break;
+        case kChannelOffset:
+            channelOffset = value * 2.0f - 1.0f;
+            break;
+        case kTruePeak: {
+            const int mode = int(value * float(kNumTruePeakModes) + 0.0001f);
+            truePeakFactor = (mode == kTruePeak8x) ? 8 : (mode == kTruePeak4x) ? 4 : 0;
+            break;
+        }
+        default:
+            break;
+    }
+
+    // True peaks only make a difference when a column spans many samples.
+    // Zoomed in further, the display already connects every sample.
+    truePeakActive = (truePeakFactor > 0 && counterSpeed * kTruePeakMinSamplesPerPixel <= 1.0);
+}
+
+void Mexoscope::makeTruePeakFilter(int factor, float* coefficients)
+{
+    // Kaiser-windowed sinc with its cutoff at the Nyquist frequency of the
+    // original sample rate, split into `factor` phases.
+    const int length = factor * kTruePeakTaps;
+    const double beta = 6.0;
+    const double centre = double(length - 1) * 0.5;
+
+    const auto besselI0 = [](double x) {
+        double sum = 1.0, term = 1.0;
+        for (int k = 1; k < 32; ++k) {
+            term *= (x * 0.5 / k) * (x * 0.5 / k);
+            sum += term;
+        }
+        return sum;
+    };
+
+    for (int phase = 0; phase < factor; ++phase) {
+        double taps[kTruePeakTaps];
+        double sum = 0.0;
+        for (int tap = 0; tap < kTruePeakTaps; ++tap) {
+            const double n = double(tap * factor + phase);
+            const double t = (n - centre) / double(factor);
+            const double sinc = (t == 0.0) ? 1.0 : std::sin(juce::MathConstants<double>::pi * t) / (juce::MathConstants<double>::pi * t);
+            const double r = (n - centre) / centre;
+            taps[tap] = sinc * besselI0(beta * std::sqrt(juce::jmax(0.0, 1.0 - r * r))) / besselI0(beta);
+            sum += taps[tap];
+        }
+
+        for (int tap = 0; tap < kTruePeakTaps; ++tap) {
+            coefficients[phase * kTruePeakTaps + tap] = float(taps[tap] / sum);
+        }
+    }
+}
+
+int Mexoscope::collectParameterEvents(int numSamples)
+{
+    ParameterEventQueue::Event event;
+
+    if (parametersNeedResync.exchange(false)) {
+        // Everything still in the queue is older than SAVE, which already
+        // has the value that didn't fit. Applying those events after SAVE
+        // would leave the parameters on stale values, so drop them. At most
+        // one queue's worth, in case other threads keep pushing.
+        size_t numDropped = 0;
+        while (numDropped < ParameterEventQueue::kCapacity && parameterEvents.pop(event)) {
+            numDropped++;
+        }
+
+        for (int i = 0; i < kNumParams; ++i) {
+            applyParameter(i, SAVE[i].load(std::memory_order_relaxed));
+#if MEXOSCOPE_REFERENCE_CHECK
+            reference->setParameter(i, params[i]);
+#endif
+        }
+    }
+
+    // Insertion sort by sample offset. There are only ever a handful of
+    // events per block, and equal offsets keep their original order.
+    int numEvents = 0;
+    while (numEvents < int(pendingEvents.size()) && parameterEvents.pop(event)) {
+        event.sampleOffset = juce::jlimit(0, numSamples, event.sampleOffset);
+
+        int j = numEvents++;
+        while (j > 0 && pendingEvents[size_t(j - 1)].sampleOffset > event.sampleOffset) {
+            pendingEvents[size_t(j)] = pendingEvents[size_t(j - 1)];
+            --j;
+        }
+        pendingEvents[size_t(j)] = event;
+    }
+    return numEvents;
 }
 
 void Mexoscope::prepareToPlay(double newSampleRate)
 {
     sampleRate = newSampleRate;
+    sweepGeneration++;
 
     // Filter coefficient for the DC killer.
-    R = 1.0 - 250.0 / sampleRate;
+    const float R = float(1.0 - 250.0 / sampleRate);
+    *dcFilter.coefficients = std::array<float, 4> { 1.0f, -1.0f, 1.0f, -R };
 
+    updateTriggerFilter();
     reset();
+
+#if MEXOSCOPE_REFERENCE_CHECK
+    reference->prepareToPlay(newSampleRate);
+#endif
+}
+
+void Mexoscope::updateTriggerFilter()
+{
+    using Coefficients = juce::dsp::IIR::ArrayCoefficients<float>;
+
+    // Between 20 Hz and 20 kHz, but never above Nyquist.
+    const double frequency = juce::jmin(20.0 * std::pow(1000.0, double(params[kTriggerFreq])), sampleRate * 0.45);
+
+    switch (triggerFilterType) {
+        case kFilterHighPass:
+            *triggerFilter.coefficients = Coefficients::makeHighPass(sampleRate, float(frequency));
+            break;
+        case kFilterLowPass:
+            *triggerFilter.coefficients = Coefficients::makeLowPass(sampleRate, float(frequency));
+            break;
+        case kFilterBandPass:
+            *triggerFilter.coefficients = Coefficients::makeBandPass(sampleRate, float(frequency), 2.0f);
+            break;
+        default:
+            break;
+    }
 }
 
 void Mexoscope::reset()
 {
+    endFrame();
+    markChanged(0, OSC_WIDTH, false);
     index = 0;
     counter = 1.0;
     max = -MAX_FLOAT;
     min = MAX_FLOAT;
-    previousSample = 0.0f;
-    triggerPhase = 0.0f;
+    previousSample = 0.0;
+    triggerArmed = true;
+    triggerPhase = 0.0;
+    triggerElapsed = 0;
     triggerLimitPhase = 0;
-    dcKill = dcFilterTemp = 0.0;
+    columnOver = false;
+    dcFilter.reset();
+    triggerFilter.reset();
+    truePeakInput.fill(0.0f);
+    sweeps.cancelSweep();
+    SegmentPool::Writer(segments).cancel();
+    triggerLog.addGap();
+    frameStartPosition = -1;
+}
+
+template <typename SampleType>
+void Mexoscope::process(const juce::AudioBuffer<SampleType>& buffer, const juce::AudioBuffer<SampleType>* sidechain)
+{
+    const int numSamples = buffer.getNumSamples();
+    int numEvents = 0;
+
+    const bool resumed = hasConsumers() && !capturing;
+    capturing = hasConsumers();
+
+    {
+        MEXOSCOPE_PROBE_BLOCK(captureProbe, numSamples, sampleRate);
+
+        if (resumed) {
+            resume();
+        }
+
+        numEvents = collectParameterEvents(numSamples);
+
+        // Split the block at the parameter changes, so that every change takes
+        // effect at exactly the right sample.
+        int position = 0;
+        for (int e = 0; e <= numEvents; ++e) {
+            const int end = (e < numEvents) ? pendingEvents[size_t(e)].sampleOffset : numSamples;
+            if (end > position) {
+                if (capturing) {
+                    processSegment(buffer, sidechain, position, end - position);
+                } else {
+                    skipSegment(buffer.getNumChannels(), end - position);
+                }
+                position = end;
+            }
+            if (e < numEvents) {
+                applyParameter(pendingEvents[size_t(e)].index, pendingEvents[size_t(e)].value);
+            }
+        }
+    }
+
+    blockPosition += numSamples;
+
+#if MEXOSCOPE_REFERENCE_CHECK
+    checkAgainstReference(buffer, sidechain, numEvents);
+#else
+    juce::ignoreUnused(numEvents);
+#endif
+}
+
+#if MEXOSCOPE_REFERENCE_CHECK
+template <typename SampleType>
+void Mexoscope::checkAgainstReference(const juce::AudioBuffer<SampleType>& buffer, const juce::AudioBuffer<SampleType>* sidechain,
+                                      int numEvents)
+{
+    const int numSamples = buffer.getNumSamples();
+
+    {
+        MEXOSCOPE_PROBE_BLOCK(referenceProbe, numSamples, sampleRate);
+
+        reference->setCapturing(capturing);
+        reference->setHostTempo(hostTempo);
+
+        int position = 0;
+        for (int e = 0; e <= numEvents; ++e) {
+            const int end = (e < numEvents) ? pendingEvents[size_t(e)].sampleOffset : numSamples;
+            if (end > position) {
+                reference->process(buffer, sidechain, position, end - position);
+                position = end;
+            }
+            if (e < numEvents) {
+                reference->setParameter(pendingEvents[size_t(e)].index, pendingEvents[size_t(e)].value);
+            }
+        }
+    }
+
+    bool same = (reference->getTriggerCount() == triggerCount);
+    for (size_t j = 0; same && j < peaks.size(); ++j) {
+        same = (reference->getPeaks()[j].y == peaks[j].y && reference->getCopy()[j].y == copy[j].y);
+    }
+    same = same && reference->getOvers() == overs && reference->getOversCopy() == oversCopy;
+
+    if (!same) {
+        // Only stop once, every block after this one will differ too.
+        jassert(referenceMismatches.load(std::memory_order_relaxed) > 0);
+        referenceMismatches.store(referenceMismatches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
 }
+#endif
 
-void Mexoscope::process(juce::AudioBuffer<float>& buffer)
+template <typename SampleType>
+void Mexoscope::processSegment(const juce::AudioBuffer<SampleType>& buffer, const juce::AudioBuffer<SampleType>* sidechain,
+                               int startSample, int sampleFrames)
 {
     // In freeze mode, don't process any incoming data.
-    if (SAVE[kFreeze] > 0.5) {
+    if (params[kFreeze] > 0.5f || buffer.getNumChannels() == 0) {
         reset();
         return;
     }
 
-    // Read from left or right channel?
-    float* samples;
-    if (buffer.getNumChannels() > 1) {
-        samples = (SAVE[kChannel] > 0.5) ? buffer.getWritePointer(1) : buffer.getWritePointer(0);
-    } else {
-        samples = buffer.getWritePointer(0);
+    // The input channels in lane order. Mono buses use the same channel
+    // for left and right, a missing sidechain is silent.
+    const SampleType* inputs[kNumLanes] = {};
+    inputs[0] = buffer.getReadPointer(0, startSample);
+    inputs[1] = buffer.getReadPointer(juce::jmin(1, buffer.getNumChannels() - 1), startSample);
+
+    if (sidechain != nullptr && sidechain->getNumChannels() > 0) {
+        inputs[kSidechainLane] = sidechain->getReadPointer(0, startSample);
+        inputs[kSidechainLane + 1] = sidechain->getReadPointer(juce::jmin(1, sidechain->getNumChannels() - 1), startSample);
     }
 
-    const int sampleFrames = buffer.getNumSamples();
+    // Read from left or right channel? This applies to the sidechain too,
+    // and so does the math channel.
+    const int channel = (params[kChannel] > 0.5f) ? 1 : 0;
+    const bool filtered = (triggerFilterType != kFilterOff);
 
-    // Linear amplification factor between 0.001 (= -60 dB) and 1000 (+60 dB).
-    // Default value is 1.0 = 0 dB gain. Same formula as for the AMP knob text
-    // in the editor window.
-    const float gain = std::pow(10.0f, SAVE[kAmpWindow] * 6.0f - 3.0f);
+    const bool recordingSweeps = sweeps.isEnabled();
+    if (!recordingSweeps) {
+        sweeps.cancelSweep();
+    }
+    SegmentPool::Writer segmentWriter(segments);
+    SampleHistory::Writer historyWriter(history);
+    MaskTest::Checker maskChecker(maskTest, params[kTimeWindow], params[kAmpWindow]);
 
-    // Linear level value between -1.0f and 1.0f.
-    const float triggerLevel = SAVE[kTriggerLevel] * 2.0f - 1.0f;
+    // Right after `resume`, only run the filters until they've settled.
+    int offset = 0;
+    while (warmUpRemaining > 0 && offset < sampleFrames) {
+        const int numSamples = juce::jmin(kChunkSize, sampleFrames - offset, warmUpRemaining);
+        conditionChunk(inputs, offset, numSamples, channel);
+        offset += numSamples;
+        warmUpRemaining -= numSamples;
+    }
 
-    // Convert the 0-1 float into one of the kTriggerXXX enum values.
-    const int triggerType = int(SAVE[kTriggerType] * float(kNumTriggerTypes) + 0.0001f);
+    // Work through the segment in chunks that fit in the scratch buffers.
+    for (; offset < sampleFrames; offset += kChunkSize) {
+        const int numSamples = juce::jmin(kChunkSize, sampleFrames - offset);
 
-    // This is a number of samples between 1 and 10000.
-    const int triggerLimit = int(std::pow(10.0, SAVE[kTriggerLimit] * 4.0));
+        conditionChunk(inputs, offset, numSamples, channel);
 
-    // Increment for the phase of the oscillator for the Internal trigger mode.
-    // Normally the increment is freq/sample rate. This is why the TRIG SPEED
-    // knob multiplies this same value by the sample rate to show the frequency.
-    // Might have been easier to make the parameter the frequency and divide by
-    // the sample rate here instead, making the knob independent of sample rate.
-    const double triggerSpeed = std::pow(10.0, SAVE[kTriggerSpeed] * 2.5 - 5.0);
+        // Find the edges for this chunk in one go. External mode looks for
+        // them in the sidechain, straight from the host's buffer unless it
+        // needs filtering first. The trigger statistics look at the same
+        // samples again.
+        const double edgeBefore = previousSample;
+        const float* edgeSource = nullptr;
+        const SampleType* hostEdgeSource = nullptr;
+        if (triggerType == kTriggerRising || triggerType == kTriggerFalling) {
+            edgeSource = filtered ? triggerInput.data() : display.data();
+            detectEdges(edgeSource, numSamples, triggerType == kTriggerRising);
+        } else if (triggerType == kTriggerExternal) {
+            if (filtered || mathChannel != kMathOff) {
+                edgeSource = triggerInput.data();
+                detectEdges(edgeSource, numSamples, true);
+            } else if (inputs[kSidechainLane + channel] != nullptr) {
+                hostEdgeSource = inputs[kSidechainLane + channel] + offset;
+                detectEdges(hostEdgeSource, numSamples, true);
+            } else {
+                std::fill(edges.begin(), edges.begin() + numSamples, uint8_t(0));
+            }
+        }
 
-    // Number of pixels per sample. Same formula as for the TIME knob text.
-    // If the TIME knob is at 30% or higher, `counterSpeed` will be less than
-    // 1.0 and a single pixel describes multiple samples. In that case, we do
-    // not store individual sample readings but the max/min over that range.
-    const double counterSpeed = std::pow(10.0, 1.5 - SAVE[kTimeWindow] * 5.0);
+        chunkPosition = blockPosition + startSample + offset;
+        chunkBlockSample = startSample + offset;
+        chunkHistoryPosition = historyWriter.getPosition();
+        historyWriter.write(channelSamples.data(), numSamples);
 
-    const bool dcOn = SAVE[kDCKill] > 0.5f;
+        captureChunk(numSamples, maskChecker);
+        if (hostEdgeSource != nullptr) {
+            logTriggers(hostEdgeSource, edgeBefore, numSamples);
+        } else {
+            logTriggers(edgeSource, edgeBefore, numSamples);
+        }
+        recordChunk(numSamples, recordingSweeps, segmentWriter);
+    }
+}
 
-    for (int i = 0; i < sampleFrames; i++) {
-        // DC filter. This is a simple high pass filter.
-        dcKill = samples[i] - dcFilterTemp + R * dcKill;
-        dcFilterTemp = samples[i];
+void Mexoscope::skipSegment(int numChannels, int numSamples)
+{
+    // Same as in `processSegment`.
+    if (params[kFreeze] > 0.5f || numChannels == 0) {
+        reset();
+        return;
+    }
+
+    // Keep the Internal trigger running, so it stays in step with the
+    // audio while nobody is watching, and let the retrigger limit expire.
+    if (triggerType == kTriggerInternal) {
+        triggerPhase = std::fmod(triggerPhase + double(triggerElapsed + numSamples) * triggerSpeed, 1.0);
+        triggerElapsed = 0;
+    }
+    triggerLimitPhase = int(juce::jmin(juce::int64(triggerLimitPhase) + numSamples,
+                                       juce::int64(std::numeric_limits<int>::max())));
+}
+
+void Mexoscope::resume()
+{
+    // Start a fresh frame. The Internal trigger's phase and the retrigger
+    // limit carry on from `skipSegment`.
+    endFrame();
+    markChanged(0, OSC_WIDTH, false);
+    index = 0;
+    counter = 1.0;
+    max = -MAX_FLOAT;
+    min = MAX_FLOAT;
+    columnOver = false;
+    previousSample = 0.0;
+    triggerArmed = true;
+
+    // The filters missed everything while nobody was watching. The DC killer
+    // has a time constant of sampleRate / 250 samples, after eight of those
+    // any offset is down to 0.03%.
+    dcFilter.reset();
+    triggerFilter.reset();
+    truePeakInput.fill(0.0f);
+    warmUpRemaining = int(8.0 * sampleRate / 250.0);
+
+    // Whatever the averager has collected is from before the gap.
+    sweeps.cancelSweep();
+    sweepGeneration++;
+    SegmentPool::Writer(segments).cancel();
+    triggerLog.addGap();
+    frameStartPosition = -1;
+}
 
-        // Handle denormals. We don't actually need to do this manually here
-        // because juce::ScopedNoDenormals will do it automatically.
-        if (std::abs(dcKill) < 1e-10f) {
-            dcKill = 0.0f;
+template <typename SampleType>
+void Mexoscope::conditionChunk(const SampleType* const* inputs, int offset, int numSamples, int channel)
+{
+    // Put one sample of every input channel into the lanes of a register.
+    for (int i = 0; i < numSamples; i++) {
+        alignas(32) float frame[Lanes::size()] = {};
+        for (int lane = 0; lane < kNumLanes; ++lane) {
+            if (inputs[lane] != nullptr) {
+                frame[lane] = float(inputs[lane][offset + i]);
+            }
         }
+        inputLanes[size_t(i)] = Lanes::fromRawArray(frame);
+    }
 
-        // Use the raw input sample if DC killer is turned off.
-        float sample = dcOn ? float(dcKill) : samples[i];
+    // DC filter. This is a simple high pass filter. It always runs, so that
+    // it has settled by the time DC-Kill is turned on.
+    for (int i = 0; i < numSamples; i++) {
+        dcLanes[size_t(i)] = dcFilter.processSample(inputLanes[size_t(i)]);
+    }
 
-        // Apply gain from the AMP knob. Clip to [-1, 1].
-        sample = clip(sample * gain, 1.0f);
+    // Handle denormals. The filter state is flushed to zero explicitly, on
+    // top of what juce::ScopedNoDenormals does.
+    dcFilter.snapToZero();
 
-        // Was the trigger hit?
-        bool trigger = false;
-        switch (triggerType) {
-            case kTriggerFree:
-                // Trigger when we've run out of the screen area :-)
-                if (index >= OSC_WIDTH) {
-                    trigger = true;
-                }
-                break;
-            case kTriggerRising:
-                // Trigger on a rising edge.
-                if (sample >= triggerLevel && previousSample < triggerLevel) {
-                    trigger = true;
-                }
-                break;
-            case kTriggerFalling:
-                // Trigger on a falling edge.
-                if (sample <= triggerLevel && previousSample > triggerLevel) {
-                    trigger = true;
+    // Use the raw input if DC killer is turned off.
+    const auto& source = (params[kDCKill] > 0.5f) ? dcLanes : inputLanes;
+
+    // Pick the channel, apply the trim and offset, then the gain from the
+    // AMP knob. Clip to [-1, 1].
+    readChannel(source, 0, channel, numSamples, channelSamples.data());
+    for (int i = 0; i < numSamples; i++) {
+        channelSamples[size_t(i)] = channelSamples[size_t(i)] * channelTrim + channelOffset;
+    }
+    for (int i = 0; i < numSamples; i++) {
+        display[size_t(i)] = clip(channelSamples[size_t(i)] * gain, 1.0f);
+    }
+
+    constexpr int history = kTruePeakTaps - 1;
+    std::copy(channelSamples.begin(), channelSamples.begin() + numSamples, truePeakInput.begin() + history);
+    if (truePeakActive) {
+        findTruePeaks(numSamples);
+    }
+    std::memmove(truePeakInput.data(), truePeakInput.data() + numSamples, sizeof(float) * size_t(history));
+
+    // The trigger filter only feeds the trigger. It filters the input lanes,
+    // so the math is done on the filtered inputs. The External trigger looks
+    // at the sidechain without any gain, the others at the scaled input.
+    if (triggerFilterType != kFilterOff) {
+        for (int i = 0; i < numSamples; i++) {
+            filteredLanes[size_t(i)] = triggerFilter.processSample(source[size_t(i)]);
+        }
+        triggerFilter.snapToZero();
+
+        if (triggerType == kTriggerExternal) {
+            readChannel(filteredLanes, kSidechainLane, channel, numSamples, triggerInput.data());
+        } else {
+            readChannel(filteredLanes, 0, channel, numSamples, triggerInput.data());
+            for (int i = 0; i < numSamples; i++) {
+                triggerInput[size_t(i)] = clip((triggerInput[size_t(i)] * channelTrim + channelOffset) * gain, 1.0f);
+            }
+        }
+    } else if (triggerType == kTriggerExternal && mathChannel != kMathOff) {
+        // Without math, the External trigger reads the host's buffer.
+        readChannel(inputLanes, kSidechainLane, channel, numSamples, triggerInput.data());
+    }
+}
+
+void Mexoscope::findTruePeaks(int numSamples)
+{
+    const size_t firstBank = (truePeakFactor == 8) ? 1 : 0;
+    const size_t numBanks = size_t(truePeakFactor / kPhasesPerBank);
+
+    for (int i = 0; i < numSamples; i++) {
+        // `x[-k]` is the sample `k` samples before this one.
+        const float* x = truePeakInput.data() + (kTruePeakTaps - 1) + i;
+        float top = x[0];
+        float bottom = x[0];
+
+        for (size_t bank = firstBank; bank < firstBank + numBanks; ++bank) {
+            const auto& taps = truePeakBanks[bank];
+            auto sum = Lanes::expand(0.0f);
+            for (int k = 0; k < kTruePeakTaps; ++k) {
+                sum += taps[size_t(k)] * Lanes::expand(x[-k]);
+            }
+
+            // Plain comparisons rather than Lanes::max, so a NaN is skipped
+            // the same way `captureChunk` skips it.
+            for (size_t phase = 0; phase < size_t(kPhasesPerBank); ++phase) {
+                const float y = sum.get(phase);
+                if (y > top) {
+                    top = y;
                 }
-                break;
-            case kTriggerInternal:
-                // Internal oscillator, nothing fancy.
-                triggerPhase += triggerSpeed;
-                if (triggerPhase >= 1.0) {
-                    triggerPhase -= 1.0;
-                    trigger = true;
+                if (y < bottom) {
+                    bottom = y;
                 }
-                break;
+            }
         }
-        
-        // If there's a retrigger, but too fast, kill it. The trigger limit
-        // value is determined by the RETRIGGER THRES knob and is expressed
-        // as a number of samples. Only in Rising/Falling modes.
-        triggerLimitPhase++;
-        if (trigger && triggerLimitPhase < triggerLimit && triggerType != kTriggerFree && triggerType != kTriggerInternal) {
-            trigger = false;
+
+        truePeakOvers[size_t(i)] = uint8_t(top > 1.0f || bottom < -1.0f);
+        truePeakUpper[size_t(i)] = clip(top * gain, 1.0f);
+        truePeakLower[size_t(i)] = clip(bottom * gain, 1.0f);
+    }
+}
+
+void Mexoscope::readChannel(const std::array<Lanes, kChunkSize>& lanes, int firstLane, int channel, int numSamples,
+                            float* destination) const
+{
+    // One loop per math channel, so there's no switch inside the loop.
+    const auto a = size_t(firstLane);
+    const auto b = size_t(firstLane + 1);
+
+    switch (mathChannel) {
+        case kMathSum:
+            for (int i = 0; i < numSamples; i++) {
+                destination[i] = lanes[size_t(i)].get(a) + lanes[size_t(i)].get(b);
+            }
+            break;
+        case kMathDifference:
+            for (int i = 0; i < numSamples; i++) {
+                destination[i] = lanes[size_t(i)].get(a) - lanes[size_t(i)].get(b);
+            }
+            break;
+        case kMathMid:
+            for (int i = 0; i < numSamples; i++) {
+                destination[i] = (lanes[size_t(i)].get(a) + lanes[size_t(i)].get(b)) * 0.5f;
+            }
+            break;
+        case kMathSide:
+            for (int i = 0; i < numSamples; i++) {
+                destination[i] = (lanes[size_t(i)].get(a) - lanes[size_t(i)].get(b)) * 0.5f;
+            }
+            break;
+        case kMathProduct:
+            for (int i = 0; i < numSamples; i++) {
+                destination[i] = lanes[size_t(i)].get(a) * lanes[size_t(i)].get(b);
+            }
+            break;
+        default: {
+            const auto lane = a + size_t(channel);
+            for (int i = 0; i < numSamples; i++) {
+                destination[i] = lanes[size_t(i)].get(lane);
+            }
+            break;
         }
+    }
+}
+
+template <typename SampleType>
+void Mexoscope::detectEdges(const SampleType* source, int numSamples, bool rising)
+{
+    const auto level = SampleType(triggerLevel);
+    const auto before = SampleType(previousSample);
+
+    if (hysteresis > 0.0f) {
+        // Noise reject. This works like a Schmitt trigger: after an edge,
+        // the signal must first go back past the level by the hysteresis
+        // amount before the next edge counts. This needs to keep state from
+        // sample to sample, so it's a plain loop.
+        const auto rearm = rising ? level - SampleType(hysteresis) : level + SampleType(hysteresis);
+
+        for (int i = 0; i < numSamples; ++i) {
+            const auto x = source[i];
+            const bool crossed = rising ? (x >= level) : (x <= level);
+            edges[size_t(i)] = uint8_t(triggerArmed && crossed);
+
+            if (crossed) {
+                triggerArmed = false;
+            } else if (rising ? (x < rearm) : (x > rearm)) {
+                triggerArmed = true;
+            }
+        }
+    } else if (rising) {
+        // Mark every sample where the signal crosses the trigger level. This
+        // has no branches and no early exit, so the compiler vectorises it.
+        // The first sample is compared against the last sample of the
+        // previous chunk.
+        edges[0] = uint8_t(source[0] >= level && before < level);
+        for (int i = 1; i < numSamples; ++i) {
+            edges[size_t(i)] = uint8_t((source[i] >= level) & (source[i - 1] < level));
+        }
+    } else {
+        edges[0] = uint8_t(source[0] <= level && before > level);
+        for (int i = 1; i < numSamples; ++i) {
+            edges[size_t(i)] = uint8_t((source[i] <= level) & (source[i - 1] > level));
+        }
+    }
+
+    previousSample = double(source[numSamples - 1]);
+}
+
+int Mexoscope::findNextEdge(int from, int numSamples) const
+{
+    if (from >= numSamples) {
+        return numSamples;
+    }
+
+    const void* found = std::memchr(edges.data() + from, 1, size_t(numSamples - from));
+    return (found != nullptr) ? int(static_cast<const uint8_t*>(found) - edges.data()) : numSamples;
+}
+
+int Mexoscope::findNextTrigger(int from, int numSamples) const
+{
+    switch (triggerType) {
+        case kTriggerRising:
+        case kTriggerFalling:
+        case kTriggerExternal:
+            return findNextEdge(from, numSamples);
+        case kTriggerInternal:
+            return findInternalTrigger(from, numSamples);
+        case kTriggerTempo:
+            return findTempoTrigger(from, numSamples);
+        default:
+            return numSamples;
+    }
+}
+
+int Mexoscope::findInternalTrigger(int from, int numSamples) const
+{
+    if (from >= numSamples) {
+        return numSamples;
+    }
+
+    // The phase at sample `i` of the chunk is `triggerPhase + (triggerElapsed
+    // + i + 1) * triggerSpeed`, the trigger fires when it reaches 1. Dividing
+    // gets within a sample of that, and the test takes care of the rounding.
+    const auto first = triggerElapsed + from + 1;
+    auto elapsed = juce::jmax(first, juce::int64(std::ceil((1.0 - triggerPhase) / triggerSpeed)) - 1);
+    while (triggerPhase + double(elapsed) * triggerSpeed < 1.0) {
+        ++elapsed;
+    }
+    return int(juce::jmin(juce::int64(numSamples), elapsed - triggerElapsed - 1));
+}
+
+int Mexoscope::findTempoTrigger(int from, int numSamples) const
+{
+    if (!hostTempo.playing || hostTempo.perSample <= 0.0 || from >= numSamples) {
+        return numSamples;
+    }
+
+    // The next multiple of the division after the sample before `from`, and
+    // the sample just before it. From there `isTempoTrigger` settles the
+    // rounding, a sample or two on.
+    const double division = getTempoDivision(tempoDivision, hostTempo.quarterNotesPerBar);
+    const int begin = chunkBlockSample + from;
+    const int end = chunkBlockSample + numSamples;
+    const double before = hostTempo.position + double(begin - 1) * hostTempo.perSample - hostTempo.barStart;
+    const double next = (std::floor(before / division) + 1.0) * division + hostTempo.barStart;
+    const double estimate = std::ceil((next - hostTempo.position) / hostTempo.perSample) - 1.0;
+
+    for (int n = int(juce::jlimit(double(begin), double(end), estimate)); n < end; ++n) {
+        if (isTempoTrigger(hostTempo, division, n)) {
+            return n - chunkBlockSample;
+        }
+    }
+    return numSamples;
+}
+
+int Mexoscope::getTempoDivisionIndex(float speedValue)
+{
+    return juce::jlimit(0, kNumTempoDivisions - 1, int(speedValue * float(kNumTempoDivisions)));
+}
+
+const char* Mexoscope::getTempoDivisionName(int division)
+{
+    static const char* const names[kNumTempoDivisions] = { "1/16", "1/8", "1/4", "1/2", "1 bar", "2 bars", "4 bars" };
+    return names[juce::jlimit(0, kNumTempoDivisions - 1, division)];
+}
+
+double Mexoscope::getTempoDivision(int division, double quarterNotesPerBar)
+{
+    static const double notes[] = { 0.25, 0.5, 1.0, 2.0 };
+    static const double bars[] = { 1.0, 2.0, 4.0 };
+    division = juce::jlimit(0, kNumTempoDivisions - 1, division);
+    return (division < 4) ? notes[division] : bars[division - 4] * juce::jmax(quarterNotesPerBar, 0.25);
+}
+
+bool Mexoscope::isTempoTrigger(const HostTempo& tempo, double division, int n)
+{
+    const double now = tempo.position + double(n) * tempo.perSample - tempo.barStart;
+    const double before = tempo.position + double(n - 1) * tempo.perSample - tempo.barStart;
+    return std::floor(now / division) > std::floor(before / division);
+}
+
+template <typename SampleType>
+void Mexoscope::logTriggers(const SampleType* edgeSource, double before, int numSamples)
+{
+    if (edgeSource != nullptr) {
+        // Every edge the trigger didn't take was too soon after the last
+        // trigger. Summing the flags vectorises, so this is cheap whatever
+        // the number of edges.
+        int numEdges = 0;
+        for (int i = 0; i < numSamples; ++i) {
+            numEdges += edges[size_t(i)];
+        }
+        triggerLog.addRejected(uint32_t(numEdges - numTriggerOffsets));
+    }
+
+    for (int k = 0; k < numTriggerOffsets; ++k) {
+        double time = triggerTimes[size_t(k)];
+
+        // Where the straight line between the sample before the edge and
+        // the edge crosses the level.
+        if (edgeSource != nullptr) {
+            const int i = triggerOffsets[size_t(k)];
+            const double from = (i > 0) ? double(edgeSource[i - 1]) : before;
+            const double to = double(edgeSource[i]);
+            const double fraction = (to != from) ? (double(triggerLevel) - from) / (to - from) : 1.0;
+            time = double(i - 1) + juce::jlimit(0.0, 1.0, fraction);
+        }
+
+        triggerLog.addTrigger(double(chunkHistoryPosition) + time);
+    }
+}
+
+void Mexoscope::captureChunk(int sampleFrames, MaskTest::Checker& maskChecker)
+{
+    const bool edgeMode = (triggerType == kTriggerRising || triggerType == kTriggerFalling
+                           || triggerType == kTriggerExternal);
+
+    // If there's a retrigger, but too fast, kill it. The trigger limit value
+    // is determined by the RETRIGGER THRES knob and is expressed as a number
+    // of samples. Only in the edge modes. The edges were already found, so
+    // this just skips the ones that are too soon after the last trigger.
+    // The other modes know where they fire beforehand, so the loop below
+    // only has to compare the sample with `nextTrigger`.
+    numTriggerOffsets = 0;
+    int nextTrigger = findNextTrigger(edgeMode ? juce::jmax(0, triggerLimit - 1 - triggerLimitPhase) : 0, sampleFrames);
+    int lastTrigger = -1;
+
+    // The first frame after a reset starts here rather than at a trigger.
+    if (frameHistoryStart < 0) {
+        frameHistoryStart = chunkHistoryPosition;
+        liveFrameStart.store(frameHistoryStart, std::memory_order_relaxed);
+    }
+
+    // The columns this chunk writes, for `takeChanges`.
+    const int firstColumn = int(juce::jmin(index, size_t(OSC_WIDTH)));
+    bool triggered = false;
+
+    // Without true peaks, the largest and smallest values are the sample.
+    const float* upper = truePeakActive ? truePeakUpper.data() : display.data();
+    const float* lower = truePeakActive ? truePeakLower.data() : display.data();
+
+    for (int i = 0; i < sampleFrames; i++) {
+
+        // Was the trigger hit? In Free mode, trigger when we've run out of
+        // the screen area :-)
+        if (i == nextTrigger || (triggerType == kTriggerFree && index >= OSC_WIDTH)) {
+            // The frame is complete, test it before it's cleared.
+            if (frameStartPosition >= 0 && maskChecker.isActive()) {
+                maskChecker.check(peaks, int(index), frameStartPosition);
+            }
+            frameStartPosition = chunkPosition + i;
+            lastTriggerPosition = chunkPosition + i;
 
-        if (trigger) {
             // Zero out the remainder of the peaks array.
             for (size_t j = index * 2; j < peaks.size(); j += 2) {
                 peaks[j].y = peaks[j + 1].y = OSC_CENTER;
             }
+            std::fill(overs.begin() + std::ptrdiff_t(juce::jmin(index, size_t(OSC_WIDTH))), overs.end(), uint8_t(0));
 
             // Copy to a buffer for synced drawing.
             for (size_t j = 0; j < peaks.size(); ++j) {
                 copy[j].y = peaks[j].y;
             }
+            oversCopy = overs;
+            columnEndsCopy = columnEnds;
+            copyColumns.store(int(index), std::memory_order_relaxed);
+            copyFrameStart.store(frameHistoryStart, std::memory_order_relaxed);
+            endFrame();
+            frameHistoryStart = chunkHistoryPosition + i;
+            liveFrameStart.store(frameHistoryStart, std::memory_order_relaxed);
 
             // Reset everything.
             index = 0;
             counter = 1.0;
             max = -MAX_FLOAT;
             min = MAX_FLOAT;
-            triggerLimitPhase = 0;
+            columnOver = false;
+            triggerCount++;
+
+            // When the trigger really fired, between samples for the
+            // oscillator-style modes.
+            double time = double(i);
+            if (triggerType == kTriggerInternal) {
+                // The phase wraps, and the oscillator counts from here.
+                triggerPhase = triggerPhase + double(triggerElapsed + i + 1) * triggerSpeed - 1.0;
+                triggerElapsed = -(i + 1);
+                time -= triggerPhase / triggerSpeed;
+            } else if (triggerType == kTriggerTempo) {
+                const double division = getTempoDivision(tempoDivision, hostTempo.quarterNotesPerBar);
+                const double position = hostTempo.position + double(chunkBlockSample + i) * hostTempo.perSample - hostTempo.barStart;
+                time -= (position - std::floor(position / division) * division) / hostTempo.perSample;
+            }
+            triggerTimes[size_t(numTriggerOffsets)] = time;
+            triggerOffsets[size_t(numTriggerOffsets++)] = i;
+            triggered = true;
+            lastTrigger = i;
+
+            nextTrigger = findNextTrigger(i + (edgeMode ? juce::jmax(1, triggerLimit) : 1), sampleFrames);
         }
 
         // Keep track of the largest and smallest sample seen since last
         // writing to the peaks array. Note that `max` and `min` are always
         // in the range [-1, 1] because we clipped the sample value earlier.
-        if (sample > max) {
-            max = sample;
+        if (upper[i] > max) {
+            max = upper[i];
             lastIsMax = true;
         }
-        if (sample < min) {
-            min = sample;
+        if (lower[i] < min) {
+            min = lower[i];
             lastIsMax = false;
         }
+        if (truePeakActive && truePeakOvers[size_t(i)] != 0) {
+            columnOver = true;
+        }
 
         // The counter is used to sample the signal at a lower rate. Every X
         // samples we'll write a new value into the peaks array. This speed is
@@ -218,16 +1008,228 @@ void Mexoscope::process(juce::AudioBuffer<float>& buffer)
                 // value instead of using a juce::Point.
                 peaks[index*2    ].y = lastIsMax ? min_Y : max_Y;
                 peaks[index*2 + 1].y = lastIsMax ? max_Y : min_Y;
+                overs[index] = uint8_t(columnOver);
+                columnEnds[index] = int(chunkHistoryPosition + i + 1 - frameHistoryStart);
 
                 index++;
             }
             
             max = -MAX_FLOAT;
             min = MAX_FLOAT;
+            columnOver = false;
             counter -= 1.0;
         }
 
-        // Store the previous sample for edge triggers.
-        previousSample = sample;
     }
+
+    liveColumns.store(int(index), std::memory_order_relaxed);
+
+    // The samples since the last trigger, for the retrigger limit. Saturate
+    // rather than overflow when there are no triggers for a very long time.
+    if (lastTrigger >= 0) {
+        triggerLimitPhase = sampleFrames - 1 - lastTrigger;
+    } else {
+        triggerLimitPhase = int(juce::jmin(juce::int64(triggerLimitPhase) + sampleFrames,
+                                           juce::int64(std::numeric_limits<int>::max())));
+    }
+    if (triggerType == kTriggerInternal) {
+        triggerElapsed += sampleFrames;
+    }
+
+    // A trigger cleared the rest of the frame and started at the left.
+    if (triggered) {
+        markChanged(0, OSC_WIDTH, true);
+    } else if (int(index) > firstColumn) {
+        markChanged(firstColumn, int(index), false);
+    }
+}
+
+void Mexoscope::recordChunk(int numSamples, bool recordSweeps, SegmentPool::Writer& segmentWriter)
+{
+    const bool recordSegments = segmentWriter.isRecording();
+    if (!recordSweeps && !recordSegments) {
+        return;
+    }
+
+    if (numTriggerOffsets == 0 && sweeps.getRemaining() == 0 && segmentWriter.getRemaining() == 0) {
+        return;
+    }
+
+    // Both record `channelSamples`, which is the signal as it's displayed
+    // but before the gain and the clipping, so it can be scaled afterwards.
+    if (recordSweeps) {
+        recordAfterTriggers(sweeps, numSamples, [this](int) { return sweeps.beginSweep(sweepLength, sweepGeneration); });
+    }
+    if (recordSegments) {
+        recordAfterTriggers(segmentWriter, numSamples, [this, &segmentWriter](int offset) {
+            return segmentWriter.begin(chunkPosition + offset);
+        });
+    }
+}
+
+template <typename Recorder, typename Begin>
+void Mexoscope::recordAfterTriggers(Recorder& recorder, int numSamples, Begin&& begin)
+{
+    int position = 0;
+    int nextTrigger = 0;
+    while (position < numSamples) {
+        if (recorder.getRemaining() == 0) {
+            // Triggers during a recording don't start a new one, so
+            // consecutive recordings never overlap. The next one starts at
+            // the first trigger after the previous one ended.
+            while (nextTrigger < numTriggerOffsets && triggerOffsets[size_t(nextTrigger)] < position) {
+                nextTrigger++;
+            }
+            if (nextTrigger == numTriggerOffsets) {
+                break;
+            }
+
+            position = triggerOffsets[size_t(nextTrigger++)];
+            if (!begin(position)) {
+                continue;
+            }
+        }
+
+        const int n = juce::jmin(numSamples - position, recorder.getRemaining());
+        recorder.write(channelSamples.data() + position, n);
+        position += n;
+    }
+}
+
+void Mexoscope::endFrame()
+{
+    // Resetting again, without a frame in between, changes nothing.
+    if (frameHistoryStart >= 0) {
+        liveColumns.store(0, std::memory_order_relaxed);
+        previousColumns.store(int(index), std::memory_order_relaxed);
+        previousFrameStart.store(frameHistoryStart, std::memory_order_relaxed);
+        frameHistoryStart = -1;
+    }
+}
+
+void Mexoscope::markChanged(int begin, int end, bool copyChanged)
+{
+    auto expected = changes.load(std::memory_order_relaxed);
+    uint32_t desired;
+    do {
+        // Nothing changed yet when `end` is 0.
+        auto newBegin = uint32_t(begin);
+        auto newEnd = uint32_t(end);
+        if ((expected & 0xFFFFu) != 0) {
+            newBegin = juce::jmin(newBegin, (expected >> 16) & 0x7FFFu);
+            newEnd = juce::jmax(newEnd, expected & 0xFFFFu);
+        }
+        desired = (expected & 0x80000000u) | (copyChanged ? 0x80000000u : 0u) | (newBegin << 16) | newEnd;
+    } while (!changes.compare_exchange_weak(expected, desired, std::memory_order_release, std::memory_order_relaxed));
 }
+
+bool Mexoscope::restoreFrame(const PeaksArray& frame, const OversArray& frameOvers)
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    if (hasConsumers()) {
+        return false;
+    }
+
+    for (size_t j = 0; j < peaks.size(); ++j) {
+        peaks[j].y = copy[j].y = frame[j].y;
+    }
+    overs = oversCopy = frameOvers;
+
+    liveColumns.store(0, std::memory_order_relaxed);
+    previousColumns.store(0, std::memory_order_relaxed);
+    copyColumns.store(0, std::memory_order_relaxed);
+    liveFrameStart.store(-1, std::memory_order_relaxed);
+    previousFrameStart.store(-1, std::memory_order_relaxed);
+    copyFrameStart.store(-1, std::memory_order_relaxed);
+    markChanged(0, OSC_WIDTH, true);
+
+#if MEXOSCOPE_REFERENCE_CHECK
+    reference->restoreFrame(frame, frameOvers);
+#endif
+    return true;
+}
+
+Mexoscope::Changes Mexoscope::takeChanges()
+{
+    const auto taken = changes.exchange(0, std::memory_order_acquire);
+    Changes result;
+    result.begin = int((taken >> 16) & 0x7FFFu);
+    result.end = int(taken & 0xFFFFu);
+    result.copy = (taken & 0x80000000u) != 0;
+    return result;
+}
+
+bool Mexoscope::getColumnSamples(bool fromCopy, int column, juce::int64& begin, juce::int64& end,
+                                 juce::int64& frameStart) const
+{
+    if (!juce::isPositiveAndBelow(column, OSC_WIDTH)) {
+        return false;
+    }
+
+    // The columns of `peaks` are from the current frame up to where it
+    // got to, and from the frame before after that.
+    int numColumns = copyColumns.load(std::memory_order_relaxed);
+    frameStart = copyFrameStart.load(std::memory_order_relaxed);
+    if (!fromCopy) {
+        numColumns = liveColumns.load(std::memory_order_relaxed);
+        frameStart = liveFrameStart.load(std::memory_order_relaxed);
+        if (column >= numColumns) {
+            numColumns = previousColumns.load(std::memory_order_relaxed);
+            frameStart = previousFrameStart.load(std::memory_order_relaxed);
+        }
+    }
+    if (column >= numColumns) {
+        return false;
+    }
+
+    const auto& ends = fromCopy ? columnEndsCopy : columnEnds;
+    begin = frameStart + (column > 0 ? ends[size_t(column - 1)] : 0);
+    end = frameStart + ends[size_t(column)];
+    return frameStart >= 0 && end > begin;
+}
+
+void Mexoscope::makeFrame(const float* samples, int numSamples, float gain, double counterSpeed, PeaksArray& frame)
+{
+    // The same as `captureChunk`, starting right after a trigger.
+    size_t index = 0;
+    double counter = 1.0;
+    float max = -MAX_FLOAT;
+    float min = MAX_FLOAT;
+    bool lastIsMax = false;
+
+    for (int i = 0; i < numSamples && index < OSC_WIDTH; ++i) {
+        const float sample = clip(samples[i] * gain, 1.0f);
+
+        if (sample > max) {
+            max = sample;
+            lastIsMax = true;
+        }
+        if (sample < min) {
+            min = sample;
+            lastIsMax = false;
+        }
+
+        counter += counterSpeed;
+        if (counter >= 1.0) {
+            const int maxY = int(OSC_CENTER - max * OSC_CENTER);
+            const int minY = int(OSC_CENTER - min * OSC_CENTER);
+            frame[index * 2].y = lastIsMax ? minY : maxY;
+            frame[index * 2 + 1].y = lastIsMax ? maxY : minY;
+            index++;
+
+            max = -MAX_FLOAT;
+            min = MAX_FLOAT;
+            counter -= 1.0;
+        }
+    }
+
+    for (size_t j = 0; j < frame.size(); ++j) {
+        frame[j].x = int(j / 2);
+        if (j >= index * 2) {
+            frame[j].y = OSC_CENTER;
+        }
+    }
+}
+
+template void Mexoscope::process(const juce::AudioBuffer<float>&, const juce::AudioBuffer<float>*);
+template void Mexoscope::process(const juce::AudioBuffer<double>&, const juce::AudioBuffer<double>*);
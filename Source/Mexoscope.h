@@ -2,6 +2,24 @@
 
 #include <JuceHeader.h>
 #include "Defines.h"
+#include "Instrumentation.h"
+#include "MaskTest.h"
+#include "ParameterEventQueue.h"
+#include "SampleHistory.h"
+#include "SegmentPool.h"
+#include "SweepFifo.h"
+#include "TriggerLog.h"
+
+/*
+  Runs MexoscopeReference next to the real capture engine and compares the
+  frames after every block. Expensive, so it's off even in debug builds.
+  Turn it on with -DMEXOSCOPE_REFERENCE_CHECK=1 when changing the engine.
+*/
+#ifndef MEXOSCOPE_REFERENCE_CHECK
+ #define MEXOSCOPE_REFERENCE_CHECK 0
+#endif
+
+class MexoscopeReference;
 
 /*
   This was CSmartelectronixDisplay in the original code, but there the class
@@ -13,7 +31,7 @@ public:
     // Parameters
     enum
     {
-        kTriggerSpeed,  // internal trigger speed, knob
+        kTriggerSpeed,  // internal trigger speed or tempo division, knob
         kTriggerType,   // trigger type, selection
         kTriggerLevel,  // trigger level, slider
         kTriggerLimit,  // retrigger threshold, knob
@@ -23,33 +41,149 @@ public:
         kChannel,       // channel selection, left/right
         kFreeze,        // freeze display, on/off
         kDCKill,        // kill DC, on/off
+        kTriggerFilter, // trigger conditioning filter, selection
+        kTriggerFreq,   // trigger filter frequency, knob
+        kTriggerHyst,   // trigger hysteresis (noise reject), knob
+        kMathChannel,   // math channel instead of left/right, selection
+        kChannelTrim,   // gain for the channel before the Amp gain, knob
+        kChannelOffset, // offset for the channel, knob
+        kTruePeak,      // true-peak (oversampled) min/max, selection
         kNumParams
     };
 
-    // Trigger types
+    // Trigger types. Tempo comes last, so that settings saved before it
+    // existed still pick the same modes.
     enum
     {
         kTriggerFree = 0,
-        //kTriggerTempo,
         kTriggerRising,
         kTriggerFalling,
         kTriggerInternal,
-        //kTriggerExternal,
+        kTriggerExternal,
+        kTriggerTempo,
         kNumTriggerTypes
     };
 
+    // What the Speed knob picks in Tempo mode: 1/16, 1/8, 1/4 and 1/2
+    // notes, then 1, 2 and 4 bars.
+    static constexpr int kNumTempoDivisions = 7;
+    static int getTempoDivisionIndex(float speedValue);
+    static const char* getTempoDivisionName(int division);
+
+    // Length of a division in quarter notes.
+    static double getTempoDivision(int division, double quarterNotesPerBar);
+
+    // The host's musical position at the first sample of a block, for the
+    // Tempo trigger mode. Positions are in quarter notes.
+    struct HostTempo
+    {
+        bool playing = false;
+        double position = 0.0;
+        double perSample = 0.0;
+        double barStart = 0.0;
+        double quarterNotesPerBar = 4.0;
+    };
+
+    // Whether the Tempo trigger fires at sample `n` of the block: the first
+    // sample at or past a multiple of `division` from the bar start. Both
+    // Mexoscope and MexoscopeReference ask this, so they agree to the sample.
+    static bool isTempoTrigger(const HostTempo& tempo, double division, int n);
+
+    // Trigger conditioning filters. These only filter the signal that the
+    // trigger looks at, never the signal that is displayed.
+    enum
+    {
+        kFilterOff = 0,
+        kFilterHighPass,
+        kFilterLowPass,
+        kFilterBandPass,
+        kNumTriggerFilters
+    };
+
+    // Math channels. These are worked out from the left and right channels
+    // and replace them for both the display and the trigger. The External
+    // trigger uses the same math on the sidechain.
+    enum
+    {
+        kMathOff = 0,      // left or right, see kChannel
+        kMathSum,          // L + R
+        kMathDifference,   // L - R
+        kMathMid,          // (L + R) / 2
+        kMathSide,         // (L - R) / 2
+        kMathProduct,      // L * R
+        kNumMathChannels
+    };
+
+    // True-peak modes. The min/max of every column also includes the
+    // signal between the samples, reconstructed by oversampling, so peaks
+    // that fall between two samples aren't hidden.
+    enum
+    {
+        kTruePeakOff = 0,
+        kTruePeak4x,
+        kTruePeak8x,
+        kNumTruePeakModes
+    };
+
+    // The true-peak interpolator has this many taps per phase. Its delay is
+    // half of that, so it's only used when a column spans at least as many
+    // samples and the peaks land less than a pixel late.
+    static constexpr int kTruePeakTaps = 16;
+    static constexpr int kTruePeakMinSamplesPerPixel = 8;
+    static constexpr int kMaxOversampling = 8;
+
+    // Fills in the polyphase interpolation filter for an oversampling
+    // factor, one phase after the other: `coefficients[phase * kTruePeakTaps
+    // + tap]`, with tap 0 for the newest sample. Every phase has unity gain.
+    static void makeTruePeakFilter(int factor, float* coefficients);
+
+    // Selection parameters are stored as `choice / numChoices`. Returns the
+    // number of choices, or 0 if the parameter isn't a selection.
+    static int getNumChoices(int index);
+
     Mexoscope();
+    ~Mexoscope();
 
     void prepareToPlay(double sampleRate);
     void reset();
 
-    void process(juce::AudioBuffer<float>& buffer);
+    // Works on both single and double precision buffers, so hosts with a
+    // 64-bit mix engine don't need to convert every block to float. The
+    // sidechain is optional and only used by the External trigger mode.
+    template <typename SampleType>
+    void process(const juce::AudioBuffer<SampleType>& buffer,
+                 const juce::AudioBuffer<SampleType>* sidechain = nullptr);
 
-    void setParameter(int index, float value);
-    float getParameter(int index) const;
+    // Can be called from any thread. The new value takes effect at the given
+    // sample offset inside the next block that is processed.
+    void setParameter(int index, float value, int sampleOffset = 0);
+
+    /*
+      Capturing only happens while something uses the result: the editor,
+      the shared-memory export, and so on. Everything that reads the peaks
+      registers itself as a consumer for as long as it does. Without any
+      consumers, `process` only keeps the parameters and the Internal
+      trigger's timing up to date, which costs next to nothing.
+
+      When the first consumer arrives, the filters are run for a short while
+      before capturing starts again, so the first frame isn't drawn with
+      filters that are still settling. Consumers can come and go on any
+      thread.
+    */
+    class ScopedConsumer
+    {
+    public:
+        explicit ScopedConsumer(Mexoscope& m) : mexoscope(m) { mexoscope.numConsumers++; }
+        ~ScopedConsumer() { mexoscope.numConsumers--; }
 
-    std::atomic<float>* getSaveBlock() { return SAVE; }
-    constexpr size_t getSaveBlockSize() { return sizeof(float) * kNumParams; }
+    private:
+        Mexoscope& mexoscope;
+
+        JUCE_DECLARE_NON_COPYABLE(ScopedConsumer)
+    };
+
+    bool hasConsumers() const { return numConsumers.load(std::memory_order_relaxed) > 0; }
+    float getParameter(int index) const;
 
     double getSampleRate() const { return sampleRate; }
 
@@ -60,11 +194,239 @@ public:
     const PeaksArray& getPeaks() const { return peaks; }
     const PeaksArray& getCopy() const { return copy; }
 
+    // For every column of `peaks` and `copy`, whether the signal went over
+    // full scale there, before the Amp gain. Only set in True Peak mode.
+    using OversArray = std::array<uint8_t, OSC_WIDTH>;
+    const OversArray& getOvers() const { return overs; }
+    const OversArray& getOversCopy() const { return oversCopy; }
+
+    // Not the audio thread. Puts a frame in both `peaks` and `copy`, to be
+    // shown until capturing replaces it, e.g. the frame that was on screen
+    // when the session was saved. Only while nothing captures, because the
+    // audio thread then leaves the frames alone; returns false otherwise.
+    // The frame has no samples in the history.
+    bool restoreFrame(const PeaksArray& frame, const OversArray& frameOvers);
+
+    // Message thread, for the one display that draws the frames. The
+    // columns of `peaks` that changed since the last call, and whether
+    // `copy` did. After a trigger or a reset the whole frame has changed.
+    struct Changes
+    {
+        int begin = 0;
+        int end = 0;
+        bool copy = false;
+    };
+    Changes takeChanges();
+
+    // Number of times the trigger has fired. Each trigger completes a frame
+    // in the `copy` array. Only meaningful on the audio thread.
+    uint64_t getTriggerCount() const { return triggerCount; }
+
+    // Host sample position where the trigger last fired, or -1 before the
+    // first trigger. Only meaningful on the audio thread.
+    juce::int64 getLastTriggerPosition() const { return lastTriggerPosition; }
+
+    // Raw sweeps for signal averaging. Enabling the FIFO makes the audio
+    // thread copy the samples that follow each trigger into it, long enough
+    // to fill the screen at the current time window.
+    SweepFifo& getSweeps() { return sweeps; }
+
+    // Segmented memory. Stores the samples after every trigger, with the
+    // host sample position of the trigger, while the pool is recording.
+    SegmentPool& getSegments() { return segments; }
+
+    // What the trigger did, for the trigger statistics.
+    TriggerLog& getTriggerLog() { return triggerLog; }
+
+    // Pass/fail testing of every frame against a tolerance mask.
+    MaskTest& getMaskTest() { return maskTest; }
+
+    // The raw samples behind the frames, while the history is started.
+    SampleHistory& getHistory() { return history; }
+    const SampleHistory& getHistory() const { return history; }
+
+    // Not the audio thread. Where the frame in `peaks` (or in `copy`)
+    // starts in the history: where its trigger fired, or where capturing
+    // started again after a reset. -1 before the first frame.
+    juce::int64 getFrameStart(bool fromCopy) const
+    {
+        return (fromCopy ? copyFrameStart : liveFrameStart).load(std::memory_order_relaxed);
+    }
+
+    // Not the audio thread. Where the samples of a column of the live frame (in
+    // `peaks`) or the completed one (in `copy`) are in the history, and
+    // where their frame starts. Returns false if the column is empty. Like
+    // the peaks, this may be a frame ahead or behind while it's captured.
+    bool getColumnSamples(bool fromCopy, int column, juce::int64& begin, juce::int64& end, juce::int64& frameStart) const;
+
+    // Audio thread. The host's sample position of the first sample of the
+    // next block. Without it, the position just keeps counting samples.
+    void setHostPosition(juce::int64 position) { blockPosition = position; }
+
+    // Audio thread. The host's tempo and position for the next block. While
+    // the transport is stopped, the Tempo trigger doesn't fire.
+    void setHostTempo(const HostTempo& tempo) { hostTempo = tempo; }
+
+    // Reduces samples that follow a trigger to a frame, the same way the
+    // live frames are made, for showing stored sweeps. The samples are
+    // scaled by the gain and clipped first, like the input.
+    static void makeFrame(const float* samples, int numSamples, float gain, double counterSpeed, PeaksArray& frame);
+
+#if MEXOSCOPE_INSTRUMENTATION
+    // Time spent in `process`, recorded by the audio thread.
+    instrumentation::PerfProbe& getCaptureProbe() { return captureProbe; }
+#endif
+
+#if MEXOSCOPE_REFERENCE_CHECK
+    // Number of blocks after which the frames differed from the reference.
+    uint64_t getReferenceMismatches() const { return referenceMismatches.load(std::memory_order_relaxed); }
+
+ #if MEXOSCOPE_INSTRUMENTATION
+    instrumentation::PerfProbe& getReferenceProbe() { return referenceProbe; }
+ #endif
+#endif
+
 protected:
+    // Gathers the pending parameter changes for this block, sorted by time.
+    int collectParameterEvents(int numSamples);
+
+    // Updates the audio thread's copy of a parameter and recomputes only
+    // the coefficients that depend on it.
+    void applyParameter(int index, float value);
+
+    // Runs the capture loop over a stretch of samples that has no parameter
+    // changes in it.
+    template <typename SampleType>
+    void processSegment(const juce::AudioBuffer<SampleType>& buffer, const juce::AudioBuffer<SampleType>* sidechain,
+                        int startSample, int numSamples);
+
+    // Stands in for `processSegment` while there are no consumers.
+    void skipSegment(int numChannels, int numSamples);
+
+    // Gets ready to capture again after a while without consumers.
+    void resume();
+
+    // Recomputes the trigger filter coefficients. Doesn't allocate.
+    void updateTriggerFilter();
+
+    // Runs the DC killer and the trigger filter over a chunk of input, and
+    // fills in `channelSamples`, `display` and, if the trigger needs it,
+    // `triggerInput`.
+    template <typename SampleType>
+    void conditionChunk(const SampleType* const* inputs, int offset, int numSamples, int channel);
+
+    // Fills in `truePeakUpper`, `truePeakLower` and `truePeakOvers` from
+    // `channelSamples` and the samples before them in `truePeakInput`.
+    void findTruePeaks(int numSamples);
+
+    // Marks every sample in `source` that crosses the trigger level in
+    // `edges`. Used for both the main input and the sidechain.
+    template <typename SampleType>
+    void detectEdges(const SampleType* source, int numSamples, bool rising);
+
+    // Index of the first edge at or after `from`, or `numSamples` if none.
+    int findNextEdge(int from, int numSamples) const;
+
+    // Where the trigger fires next in the current chunk, at or after
+    // `from`, or `numSamples` if it doesn't. The edge modes look up the
+    // edges, the Internal and Tempo modes work it out in closed form. The
+    // Free mode fires when the screen is full, which this doesn't know.
+    int findNextTrigger(int from, int numSamples) const;
+    int findInternalTrigger(int from, int numSamples) const;
+    int findTempoTrigger(int from, int numSamples) const;
+
+    // Logs the triggers of the chunk that `captureChunk` just did. With the
+    // samples the edges were found in, the time is where the signal crossed
+    // the level between two samples, and the edges that didn't trigger are
+    // counted as held back by the retrigger limit. `before` is the sample
+    // before the chunk.
+    template <typename SampleType>
+    void logTriggers(const SampleType* edgeSource, double before, int numSamples);
+
+    // Fills the peaks array from the conditioned samples in `display`, or
+    // the true peaks around them, and
+    // tests every frame that a trigger completes against the mask.
+    void captureChunk(int numSamples, MaskTest::Checker& maskChecker);
+
+    // Copies the samples after this chunk's triggers into the sweep FIFO
+    // and the segment pool, if they're enabled.
+    void recordChunk(int numSamples, bool recordSweeps, SegmentPool::Writer& segmentWriter);
+
+    // Feeds one recording at a time to `recorder`, starting at the triggers
+    // in this chunk. `begin` starts a recording at a trigger offset, and
+    // returns false if there's no room for it.
+    template <typename Recorder, typename Begin>
+    void recordAfterTriggers(Recorder& recorder, int numSamples, Begin&& begin);
+
+#if MEXOSCOPE_REFERENCE_CHECK
+    // Runs the same block, with the same parameter changes, through the
+    // reference and compares the results.
+    template <typename SampleType>
+    void checkAgainstReference(const juce::AudioBuffer<SampleType>& buffer, const juce::AudioBuffer<SampleType>* sidechain,
+                               int numEvents);
+#endif
+
+    // The capture loop works on chunks of at most this many samples, so that
+    // the scratch buffers don't depend on the host's block size.
+    static constexpr int kChunkSize = 256;
+
+    // The filters work on all input channels at once, one channel per SIMD
+    // lane: main left, main right, sidechain left, sidechain right. Mono
+    // buses are duplicated. This costs the same as filtering one channel,
+    // and the filters are already settled when the channel is switched.
+    using Lanes = juce::dsp::SIMDRegister<float>;
+    static constexpr int kNumLanes = 4;
+    static constexpr int kSidechainLane = 2;
+    static_assert(Lanes::size() >= kNumLanes, "need a SIMD lane for every input channel");
+
+    // Reads the left or right channel, or the math channel, from the two
+    // lanes that start at `firstLane`.
+    void readChannel(const std::array<Lanes, kChunkSize>& lanes, int firstLane, int channel, int numSamples,
+                     float* destination) const;
+
+    alignas(32) std::array<Lanes, kChunkSize> inputLanes;
+    alignas(32) std::array<Lanes, kChunkSize> dcLanes;
+    alignas(32) std::array<Lanes, kChunkSize> filteredLanes;
+
+    // The channel that's shown, with the trim and offset but before the Amp
+    // gain and the clipping. The sweeps and the segments record this.
+    alignas(32) std::array<float, kChunkSize> channelSamples;
+
+    // Conditioned input for the current chunk, the input for the trigger if
+    // it's filtered or uses math on the sidechain, and the trigger edges.
+    alignas(32) std::array<float, kChunkSize> display;
+    alignas(32) std::array<float, kChunkSize> triggerInput;
+    alignas(32) std::array<uint8_t, kChunkSize> edges;
+
+    // The true-peak interpolator works on `channelSamples`, after the last
+    // `kTruePeakTaps - 1` samples of the previous chunk. It always keeps
+    // those, so switching it on doesn't start with a click. Each phase of
+    // the filter is a SIMD lane, four phases per bank: one bank for 4x, the
+    // next two for 8x. `truePeakUpper` and `truePeakLower` are the largest
+    // and smallest values from each sample back to the previous one, with
+    // the gain and clipping like `display`.
+    static constexpr int kPhasesPerBank = 4;
+    static_assert(Lanes::size() >= kPhasesPerBank && kMaxOversampling % kPhasesPerBank == 0);
+    alignas(32) std::array<float, kChunkSize + kTruePeakTaps - 1> truePeakInput {};
+    alignas(32) std::array<float, kChunkSize> truePeakUpper;
+    alignas(32) std::array<float, kChunkSize> truePeakLower;
+    alignas(32) std::array<uint8_t, kChunkSize> truePeakOvers;
+    std::array<std::array<Lanes, kTruePeakTaps>, (4 + kMaxOversampling) / kPhasesPerBank> truePeakBanks;
+    int truePeakFactor = 0;
+    bool truePeakActive = false;
+
+    // The DC killer is a one-pole high pass filter, the trigger filter is
+    // a biquad.
+    juce::dsp::IIR::Filter<Lanes> dcFilter;
+    juce::dsp::IIR::Filter<Lanes> triggerFilter;
+    int triggerFilterType = kFilterOff;
+
     // Array containing the waveform readings. The `copy` array is used
     // for Sync Redraw mode and is only updated when the trigger is hit.
     PeaksArray peaks;
     PeaksArray copy;
+    OversArray overs {};
+    OversArray oversCopy {};
 
     // Current write position into the peaks array.
     size_t index;
@@ -78,25 +440,148 @@ protected:
     // Whether the last peak we encountered was a maximum or minimum.
     bool lastIsMax;
 
-    // The previous sample, for edge triggers.
-    float previousSample;
+    // Whether the true peaks went over full scale since the last reading.
+    bool columnOver = false;
+
+    // The previous sample the trigger looked at, for edge triggers. Double,
+    // so a double precision sidechain compares the same across chunks.
+    double previousSample;
 
-    // Oscillator used for Internal trigger mode.
+    // Hysteresis for edge triggers. The trigger is only armed again after
+    // the signal has moved this far back past the trigger level.
+    float hysteresis = 0.0f;
+    bool triggerArmed = true;
+
+    // Oscillator used for Internal trigger mode. Its phase is
+    // `triggerPhase + triggerElapsed * triggerSpeed`, with `triggerElapsed`
+    // counting the samples since the last trigger or speed change (up to the
+    // start of the chunk), so every trigger can be worked out in one go and
+    // doesn't depend on how the samples were split into chunks.
     double triggerPhase;
+    juce::int64 triggerElapsed = 0;
+
+    HostTempo hostTempo;
+    int tempoDivision = 3;
 
     // Counter that limits how soon the trigger may happen again.
     int triggerLimitPhase;
 
-    // DC killer filter state and coefficient.
-    double dcKill, dcFilterTemp, R;
+    // How many frames have been completed.
+    uint64_t triggerCount = 0;
+
+    // Where the trigger fired in the current chunk, and when in samples
+    // from the start of the chunk. The Internal trigger fires between
+    // samples.
+    std::array<int, kChunkSize> triggerOffsets;
+    std::array<double, kChunkSize> triggerTimes;
+    int numTriggerOffsets = 0;
+
+    TriggerLog triggerLog;
+
+    // Sweeps are long enough to fill the screen. The generation goes up
+    // whenever a setting changes that makes new sweeps incompatible with
+    // the ones before, e.g. the trigger level or the channel.
+    SweepFifo sweeps;
+    int sweepLength = OSC_WIDTH;
+    uint32_t sweepGeneration = 0;
+
+    SegmentPool segments;
+
+    // Host sample position of the current block and chunk, and where the
+    // chunk starts in the block.
+    juce::int64 blockPosition = 0;
+    juce::int64 chunkPosition = 0;
+    int chunkBlockSample = 0;
+
+    MaskTest maskTest;
+
+    // The sample history counts every captured sample, whether it's started
+    // or not. These are the history positions of the current chunk and of
+    // the first sample of the current frame, or -1 until the first chunk
+    // after a reset.
+    SampleHistory history;
+    juce::int64 chunkHistoryPosition = 0;
+    juce::int64 frameHistoryStart = -1;
 
-    // This array holds the parameter values. They're stored in an array so
-    // they can be loaded & saved easily by copying (into) the whole array.
-    // The parameters are atomic since they'll be changed by the UI thread.
+    // Where the samples of every column end, counted from the start of the
+    // frame. `columnEndsCopy` belongs to the `copy` array.
+    std::array<int, OSC_WIDTH> columnEnds {};
+    std::array<int, OSC_WIDTH> columnEndsCopy {};
+
+    // The same for the message thread, with the number of columns that are
+    // filled in. The columns of `peaks` past `liveColumns` are still from
+    // the previous frame, which is the one in `copy` unless it was cut
+    // short by a reset.
+    std::atomic<juce::int64> liveFrameStart { -1 };
+    std::atomic<juce::int64> previousFrameStart { -1 };
+    std::atomic<juce::int64> copyFrameStart { -1 };
+    std::atomic<int> liveColumns { 0 };
+    std::atomic<int> previousColumns { 0 };
+    std::atomic<int> copyColumns { 0 };
+
+    // Makes the current frame the previous one, when a trigger completes it
+    // or a reset cuts it short.
+    void endFrame();
+
+    // The changes for `takeChanges`, packed as `copy << 31 | begin << 16 |
+    // end` so the audio thread can add to them without locking. The audio
+    // thread publishes them once per chunk.
+    std::atomic<uint32_t> changes { 0 };
+    void markChanged(int begin, int end, bool copyChanged);
+
+    // Host sample position of the trigger that started the current frame,
+    // or -1 if it didn't start at a trigger or the settings changed since.
+    // Only frames that run from trigger to trigger are mask tested.
+    juce::int64 frameStartPosition = -1;
+    juce::int64 lastTriggerPosition = -1;
+
+    std::atomic<int> numConsumers { 0 };
+    bool capturing = false;
+
+    // Samples left during which only the filters run, after `resume`.
+    int warmUpRemaining = 0;
+
+    // This array holds the latest parameter values, for the UI and for saving
+    // the plug-in state. The parameters are atomic since they're changed by
+    // the host and the UI thread. The audio thread doesn't read from here but
+    // receives the changes through `parameterEvents`.
     std::atomic<float> SAVE[kNumParams];
 
+    ParameterEventQueue parameterEvents;
+    std::array<ParameterEventQueue::Event, ParameterEventQueue::kCapacity> pendingEvents;
+
+    // Set when the queue overflowed, in which case the audio thread drops
+    // the queued changes and reloads all parameters from SAVE at the start
+    // of the next block.
+    std::atomic<bool> parametersNeedResync { false };
+
+    // The audio thread's copy of the parameters, and the coefficients that
+    // are derived from them. These only change in `applyParameter`.
+    float params[kNumParams] = {};
+    float gain = 1.0f;
+    int mathChannel = kMathOff;
+    float channelTrim = 1.0f;
+    float channelOffset = 0.0f;
+    float triggerLevel = 0.0f;
+    int triggerType = kTriggerFree;
+    int triggerLimit = 100;
+    double triggerSpeed = 0.0;
+    double counterSpeed = 1.0;
+
     // Sample rate that was passed into `prepareToPlay`.
     double sampleRate = 44100.0;
 
+#if MEXOSCOPE_INSTRUMENTATION
+    instrumentation::PerfProbe captureProbe;
+#endif
+
+#if MEXOSCOPE_REFERENCE_CHECK
+    std::unique_ptr<MexoscopeReference> reference;
+    std::atomic<uint64_t> referenceMismatches { 0 };
+ #if MEXOSCOPE_INSTRUMENTATION
+    instrumentation::PerfProbe referenceProbe;
+ #endif
+#endif
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Mexoscope)
 };
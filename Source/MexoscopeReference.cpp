@@ -0,0 +1,401 @@
+#include "MexoscopeReference.h"
+#include <limits>
+
+MexoscopeReference::MexoscopeReference()
+{
+    for (size_t j = 0; j < peaks.size(); ++j) {
+        peaks[j].x = copy[j].x = int(j / 2);
+        peaks[j].y = copy[j].y = OSC_CENTER;
+    }
+
+    dcCoefficients = new juce::dsp::IIR::Coefficients<float>(1.0f, -1.0f, 1.0f, 0.0f);
+    triggerCoefficients = new juce::dsp::IIR::Coefficients<float>(1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f);
+
+    Mexoscope::makeTruePeakFilter(4, truePeak4x);
+    Mexoscope::makeTruePeakFilter(8, truePeak8x);
+}
+
+void MexoscopeReference::prepareToPlay(double newSampleRate)
+{
+    sampleRate = newSampleRate;
+
+    const float R = float(1.0 - 250.0 / sampleRate);
+    *dcCoefficients = std::array<float, 4> { 1.0f, -1.0f, 1.0f, -R };
+
+    updateTriggerFilter();
+    reset();
+}
+
+void MexoscopeReference::reset()
+{
+    index = 0;
+    counter = 1.0;
+    max = -MAX_FLOAT;
+    min = MAX_FLOAT;
+    previousSample = 0.0;
+    triggerArmed = true;
+    triggerPhase = 0.0;
+    triggerElapsed = 0;
+    triggerLimitPhase = 0;
+    columnOver = false;
+
+    for (int lane = 0; lane < kNumLanes; ++lane) {
+        dcState[lane][0] = 0.0f;
+        triggerState[lane][0] = triggerState[lane][1] = 0.0f;
+    }
+    std::fill(std::begin(truePeakHistory), std::end(truePeakHistory), 0.0f);
+}
+
+void MexoscopeReference::restoreFrame(const Mexoscope::PeaksArray& frame, const Mexoscope::OversArray& frameOvers)
+{
+    for (size_t j = 0; j < peaks.size(); ++j) {
+        peaks[j].y = copy[j].y = frame[j].y;
+    }
+    overs = oversCopy = frameOvers;
+}
+
+void MexoscopeReference::setCapturing(bool shouldCapture)
+{
+    if (shouldCapture && !capturing) {
+        index = 0;
+        counter = 1.0;
+        max = -MAX_FLOAT;
+        min = MAX_FLOAT;
+        previousSample = 0.0;
+        triggerArmed = true;
+        columnOver = false;
+
+        for (int lane = 0; lane < kNumLanes; ++lane) {
+            dcState[lane][0] = 0.0f;
+            triggerState[lane][0] = triggerState[lane][1] = 0.0f;
+        }
+        std::fill(std::begin(truePeakHistory), std::end(truePeakHistory), 0.0f);
+        warmUpRemaining = int(8.0 * sampleRate / 250.0);
+    }
+    capturing = shouldCapture;
+}
+
+void MexoscopeReference::setParameter(int paramIndex, float value)
+{
+    params[paramIndex] = value;
+
+    switch (paramIndex) {
+        case Mexoscope::kAmpWindow:
+            gain = std::pow(10.0f, value * 6.0f - 3.0f);
+            break;
+        case Mexoscope::kTriggerLevel:
+            triggerLevel = value * 2.0f - 1.0f;
+            break;
+        case Mexoscope::kTriggerType:
+            triggerType = int(value * float(Mexoscope::kNumTriggerTypes) + 0.0001f);
+            break;
+        case Mexoscope::kTriggerLimit:
+            triggerLimit = int(std::pow(10.0, value * 4.0));
+            break;
+        case Mexoscope::kTriggerSpeed:
+            triggerPhase = triggerPhase + double(triggerElapsed) * triggerSpeed;
+            triggerElapsed = 0;
+            triggerSpeed = std::pow(10.0, value * 2.5 - 5.0);
+            tempoDivision = Mexoscope::getTempoDivisionIndex(value);
+            break;
+        case Mexoscope::kTimeWindow:
+            counterSpeed = std::pow(10.0, 1.5 - value * 5.0);
+            break;
+        case Mexoscope::kTriggerFilter:
+            triggerFilterType = int(value * float(Mexoscope::kNumTriggerFilters) + 0.0001f);
+            for (auto& state : triggerState) {
+                state[0] = state[1] = 0.0f;
+            }
+            updateTriggerFilter();
+            break;
+        case Mexoscope::kTriggerFreq:
+            updateTriggerFilter();
+            break;
+        case Mexoscope::kTriggerHyst:
+            hysteresis = value * 0.5f;
+            break;
+        case Mexoscope::kMathChannel:
+            mathChannel = int(value * float(Mexoscope::kNumMathChannels) + 0.0001f);
+            break;
+        case Mexoscope::kChannelTrim:
+            channelTrim = std::pow(10.0f, (value * 48.0f - 24.0f) / 20.0f);
+            break;
+        case Mexoscope::kChannelOffset:
+            channelOffset = value * 2.0f - 1.0f;
+            break;
+        case Mexoscope::kTruePeak: {
+            const int mode = int(value * float(Mexoscope::kNumTruePeakModes) + 0.0001f);
+            truePeakFactor = (mode == Mexoscope::kTruePeak8x) ? 8 : (mode == Mexoscope::kTruePeak4x) ? 4 : 0;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void MexoscopeReference::updateTriggerFilter()
+{
+    using Coefficients = juce::dsp::IIR::ArrayCoefficients<float>;
+
+    const double frequency = juce::jmin(20.0 * std::pow(1000.0, double(params[Mexoscope::kTriggerFreq])), sampleRate * 0.45);
+
+    switch (triggerFilterType) {
+        case Mexoscope::kFilterHighPass:
+            *triggerCoefficients = Coefficients::makeHighPass(sampleRate, float(frequency));
+            break;
+        case Mexoscope::kFilterLowPass:
+            *triggerCoefficients = Coefficients::makeLowPass(sampleRate, float(frequency));
+            break;
+        case Mexoscope::kFilterBandPass:
+            *triggerCoefficients = Coefficients::makeBandPass(sampleRate, float(frequency), 2.0f);
+            break;
+        default:
+            break;
+    }
+}
+
+float MexoscopeReference::readChannel(const float* lanes, int firstLane, int channel) const
+{
+    const float a = lanes[firstLane];
+    const float b = lanes[firstLane + 1];
+
+    switch (mathChannel) {
+        case Mexoscope::kMathSum:
+            return a + b;
+        case Mexoscope::kMathDifference:
+            return a - b;
+        case Mexoscope::kMathMid:
+            return (a + b) * 0.5f;
+        case Mexoscope::kMathSide:
+            return (a - b) * 0.5f;
+        case Mexoscope::kMathProduct:
+            return a * b;
+        default:
+            return lanes[firstLane + channel];
+    }
+}
+
+float MexoscopeReference::runFilter(const juce::dsp::IIR::Coefficients<float>& coefficients, float* state, float input)
+{
+    const auto* c = coefficients.getRawCoefficients();
+    const auto order = coefficients.getFilterOrder();
+
+    const float output = (c[0] * input) + state[0];
+    for (size_t j = 0; j + 1 < order; ++j) {
+        state[j] = (c[j + 1] * input) - (c[order + j + 1] * output) + state[j + 1];
+    }
+    state[order - 1] = (c[order] * input) - (c[order * 2] * output);
+    return output;
+}
+
+template <typename T>
+bool MexoscopeReference::detectEdge(T x, bool rising)
+{
+    const auto level = T(triggerLevel);
+    const auto before = T(previousSample);
+    previousSample = double(x);
+
+    if (hysteresis > 0.0f) {
+        const auto rearm = rising ? level - T(hysteresis) : level + T(hysteresis);
+        const bool crossed = rising ? (x >= level) : (x <= level);
+        const bool edge = triggerArmed && crossed;
+
+        if (crossed) {
+            triggerArmed = false;
+        } else if (rising ? (x < rearm) : (x > rearm)) {
+            triggerArmed = true;
+        }
+        return edge;
+    }
+
+    return rising ? (x >= level && before < level) : (x <= level && before > level);
+}
+
+template <typename SampleType>
+void MexoscopeReference::process(const juce::AudioBuffer<SampleType>& buffer, const juce::AudioBuffer<SampleType>* sidechain,
+                                 int startSample, int numSamples)
+{
+    const juce::int64 blockPosition = samplePosition;
+    samplePosition += numSamples;
+
+    if (params[Mexoscope::kFreeze] > 0.5f || buffer.getNumChannels() == 0) {
+        reset();
+        return;
+    }
+
+    if (!capturing) {
+        if (triggerType == Mexoscope::kTriggerInternal) {
+            triggerPhase = std::fmod(triggerPhase + double(triggerElapsed + numSamples) * triggerSpeed, 1.0);
+            triggerElapsed = 0;
+        }
+        triggerLimitPhase = int(juce::jmin(juce::int64(triggerLimitPhase) + numSamples,
+                                           juce::int64(std::numeric_limits<int>::max())));
+        return;
+    }
+
+    const SampleType* inputs[kNumLanes] = {};
+    inputs[0] = buffer.getReadPointer(0, startSample);
+    inputs[1] = buffer.getReadPointer(juce::jmin(1, buffer.getNumChannels() - 1), startSample);
+    if (sidechain != nullptr && sidechain->getNumChannels() > 0) {
+        inputs[kSidechainLane] = sidechain->getReadPointer(0, startSample);
+        inputs[kSidechainLane + 1] = sidechain->getReadPointer(juce::jmin(1, sidechain->getNumChannels() - 1), startSample);
+    }
+
+    const int channel = (params[Mexoscope::kChannel] > 0.5f) ? 1 : 0;
+    const bool filtered = (triggerFilterType != Mexoscope::kFilterOff);
+    const bool dcKill = (params[Mexoscope::kDCKill] > 0.5f);
+    const bool truePeak = (truePeakFactor > 0 && counterSpeed * Mexoscope::kTruePeakMinSamplesPerPixel <= 1.0);
+    const float* truePeakFilter = (truePeakFactor == 8) ? truePeak8x : truePeak4x;
+
+    for (int i = 0; i < numSamples; ++i) {
+        float input[kNumLanes] = {};
+        float highPassed[kNumLanes];
+        float triggerFiltered[kNumLanes] = {};
+
+        for (int lane = 0; lane < kNumLanes; ++lane) {
+            if (inputs[lane] != nullptr) {
+                input[lane] = float(inputs[lane][i]);
+            }
+            highPassed[lane] = runFilter(*dcCoefficients, dcState[lane], input[lane]);
+        }
+
+        const float* source = dcKill ? highPassed : input;
+        const float value = readChannel(source, 0, channel) * channelTrim + channelOffset;
+        const float sample = clip(value * gain, 1.0f);
+
+        for (int k = 0; k + 1 < Mexoscope::kTruePeakTaps; ++k) {
+            truePeakHistory[k] = truePeakHistory[k + 1];
+        }
+        truePeakHistory[Mexoscope::kTruePeakTaps - 1] = value;
+
+        // Every phase of the interpolator between the previous sample and
+        // this one, on top of the sample itself.
+        float upper = sample;
+        float lower = sample;
+        bool over = false;
+        if (truePeak) {
+            float top = value;
+            float bottom = value;
+            for (int phase = 0; phase < truePeakFactor; ++phase) {
+                float y = 0.0f;
+                for (int k = 0; k < Mexoscope::kTruePeakTaps; ++k) {
+                    y += truePeakFilter[phase * Mexoscope::kTruePeakTaps + k] * truePeakHistory[Mexoscope::kTruePeakTaps - 1 - k];
+                }
+                if (y > top) {
+                    top = y;
+                }
+                if (y < bottom) {
+                    bottom = y;
+                }
+            }
+            over = (top > 1.0f || bottom < -1.0f);
+            upper = clip(top * gain, 1.0f);
+            lower = clip(bottom * gain, 1.0f);
+        }
+
+        if (filtered) {
+            for (int lane = 0; lane < kNumLanes; ++lane) {
+                triggerFiltered[lane] = runFilter(*triggerCoefficients, triggerState[lane], source[lane]);
+            }
+        }
+
+        if (warmUpRemaining > 0) {
+            --warmUpRemaining;
+            continue;
+        }
+
+        bool trigger = false;
+        switch (triggerType) {
+            case Mexoscope::kTriggerFree:
+                trigger = (index >= OSC_WIDTH);
+                break;
+            case Mexoscope::kTriggerRising:
+            case Mexoscope::kTriggerFalling: {
+                const float filteredValue = readChannel(triggerFiltered, 0, channel) * channelTrim + channelOffset;
+                const float x = filtered ? clip(filteredValue * gain, 1.0f) : sample;
+                const bool edge = detectEdge(x, triggerType == Mexoscope::kTriggerRising);
+                trigger = edge && triggerLimitPhase >= triggerLimit - 1;
+                break;
+            }
+            case Mexoscope::kTriggerExternal: {
+                bool edge = false;
+                if (filtered) {
+                    edge = detectEdge(readChannel(triggerFiltered, kSidechainLane, channel), true);
+                } else if (mathChannel != Mexoscope::kMathOff) {
+                    edge = detectEdge(readChannel(input, kSidechainLane, channel), true);
+                } else if (inputs[kSidechainLane + channel] != nullptr) {
+                    edge = detectEdge(inputs[kSidechainLane + channel][i], true);
+                }
+                trigger = edge && triggerLimitPhase >= triggerLimit - 1;
+                break;
+            }
+            case Mexoscope::kTriggerInternal:
+                // Counted from the last trigger, see `triggerElapsed`.
+                triggerElapsed++;
+                if (triggerPhase + double(triggerElapsed) * triggerSpeed >= 1.0) {
+                    triggerPhase = triggerPhase + double(triggerElapsed) * triggerSpeed - 1.0;
+                    triggerElapsed = 0;
+                    trigger = true;
+                }
+                break;
+            case Mexoscope::kTriggerTempo:
+                trigger = hostTempo.playing && hostTempo.perSample > 0.0
+                          && Mexoscope::isTempoTrigger(hostTempo,
+                                                       Mexoscope::getTempoDivision(tempoDivision, hostTempo.quarterNotesPerBar),
+                                                       startSample + i);
+                break;
+        }
+
+        if (triggerLimitPhase < std::numeric_limits<int>::max()) {
+            triggerLimitPhase++;
+        }
+
+        if (trigger) {
+            for (size_t j = index * 2; j < peaks.size(); j += 2) {
+                peaks[j].y = peaks[j + 1].y = OSC_CENTER;
+                overs[j / 2] = 0;
+            }
+            copy = peaks;
+            oversCopy = overs;
+
+            index = 0;
+            counter = 1.0;
+            max = -MAX_FLOAT;
+            min = MAX_FLOAT;
+            columnOver = false;
+            triggerLimitPhase = 0;
+            triggerCount++;
+            lastTriggerPosition = blockPosition + i;
+        }
+
+        if (upper > max) {
+            max = upper;
+            lastIsMax = true;
+        }
+        if (lower < min) {
+            min = lower;
+            lastIsMax = false;
+        }
+        columnOver = columnOver || over;
+
+        counter += counterSpeed;
+        if (counter >= 1.0) {
+            if (index < OSC_WIDTH) {
+                const int maxY = int(OSC_CENTER - max * OSC_CENTER);
+                const int minY = int(OSC_CENTER - min * OSC_CENTER);
+                peaks[index * 2].y = lastIsMax ? minY : maxY;
+                peaks[index * 2 + 1].y = lastIsMax ? maxY : minY;
+                overs[index] = uint8_t(columnOver);
+                index++;
+            }
+
+            max = -MAX_FLOAT;
+            min = MAX_FLOAT;
+            columnOver = false;
+            counter -= 1.0;
+        }
+    }
+}
+
+template void MexoscopeReference::process(const juce::AudioBuffer<float>&, const juce::AudioBuffer<float>*, int, int);
+template void MexoscopeReference::process(const juce::AudioBuffer<double>&, const juce::AudioBuffer<double>*, int, int);
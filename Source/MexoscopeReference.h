@@ -0,0 +1,128 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Mexoscope.h"
+
+/*
+  Frozen, deliberately simple model of what Mexoscope draws. It processes
+  one sample at a time with plain scalar code: no chunks, no SIMD lanes, no
+  edge search. Its only job is to be obviously correct, so that faster
+  versions of Mexoscope can be checked against it sample for sample.
+
+  Don't optimise this class. If the behaviour of Mexoscope changes on
+  purpose, change this class in the same commit.
+
+  The parameters take effect immediately. Callers that want sample-accurate
+  changes split the block themselves, like Mexoscope does.
+*/
+class MexoscopeReference
+{
+public:
+    MexoscopeReference();
+
+    void prepareToPlay(double sampleRate);
+    void reset();
+
+    void setParameter(int index, float value);
+
+    // Mirrors Mexoscope's consumer handling. Without consumers, `process`
+    // only keeps the trigger timing going; when capturing starts again the
+    // filters get time to settle first.
+    void setCapturing(bool shouldCapture);
+
+    // Mirrors Mexoscope::restoreFrame.
+    void restoreFrame(const Mexoscope::PeaksArray& frame, const Mexoscope::OversArray& frameOvers);
+
+    // The transport for the Tempo trigger, for the whole block.
+    void setHostTempo(const Mexoscope::HostTempo& tempo) { hostTempo = tempo; }
+
+    template <typename SampleType>
+    void process(const juce::AudioBuffer<SampleType>& buffer, const juce::AudioBuffer<SampleType>* sidechain,
+                 int startSample, int numSamples);
+
+    const Mexoscope::PeaksArray& getPeaks() const { return peaks; }
+    const Mexoscope::PeaksArray& getCopy() const { return copy; }
+    const Mexoscope::OversArray& getOvers() const { return overs; }
+    const Mexoscope::OversArray& getOversCopy() const { return oversCopy; }
+    uint64_t getTriggerCount() const { return triggerCount; }
+
+    // Where the trigger last fired, or -1 before the first trigger. The
+    // position counts every sample passed to `process`, like Mexoscope's
+    // does without a host position.
+    juce::int64 getLastTriggerPosition() const { return lastTriggerPosition; }
+
+private:
+    static constexpr int kNumLanes = 4;
+    static constexpr int kSidechainLane = 2;
+
+    // Transposed direct form II, the same structure and rounding as
+    // juce::dsp::IIR::Filter.
+    static float runFilter(const juce::dsp::IIR::Coefficients<float>& coefficients, float* state, float input);
+
+    void updateTriggerFilter();
+
+    // The left or right channel, or the math channel, of the two lanes that
+    // start at `firstLane`.
+    float readChannel(const float* lanes, int firstLane, int channel) const;
+
+    // Returns true if `x` is a trigger edge. `x` is compared in its own
+    // precision, like the host's buffer would be.
+    template <typename T>
+    bool detectEdge(T x, bool rising);
+
+    Mexoscope::PeaksArray peaks;
+    Mexoscope::PeaksArray copy;
+    Mexoscope::OversArray overs {};
+    Mexoscope::OversArray oversCopy {};
+
+    size_t index = 0;
+    double counter = 1.0;
+    float max = -MAX_FLOAT;
+    float min = MAX_FLOAT;
+    bool lastIsMax = false;
+    bool columnOver = false;
+    double previousSample = 0.0;
+    bool triggerArmed = true;
+    // The Internal trigger's phase is `triggerPhase + triggerElapsed *
+    // triggerSpeed`, the phase at the last trigger or speed change plus the
+    // samples since then times the speed. That sum is the spec: adding the
+    // speed on every sample would round differently from Mexoscope, which
+    // works out the same sum for a whole chunk.
+    double triggerPhase = 0.0;
+    juce::int64 triggerElapsed = 0;
+    int triggerLimitPhase = 0;
+    uint64_t triggerCount = 0;
+    juce::int64 samplePosition = 0;
+    juce::int64 lastTriggerPosition = -1;
+    bool capturing = false;
+    int warmUpRemaining = 0;
+
+    juce::dsp::IIR::Coefficients<float>::Ptr dcCoefficients;
+    juce::dsp::IIR::Coefficients<float>::Ptr triggerCoefficients;
+    float dcState[kNumLanes][1] = {};
+    float triggerState[kNumLanes][2] = {};
+
+    // The channel's last samples, oldest first, and the filters for 4x and 8x.
+    float truePeakHistory[Mexoscope::kTruePeakTaps] = {};
+    float truePeak4x[4 * Mexoscope::kTruePeakTaps];
+    float truePeak8x[8 * Mexoscope::kTruePeakTaps];
+    int truePeakFactor = 0;
+
+    float params[Mexoscope::kNumParams] = {};
+    float gain = 1.0f;
+    int mathChannel = Mexoscope::kMathOff;
+    float channelTrim = 1.0f;
+    float channelOffset = 0.0f;
+    float triggerLevel = 0.0f;
+    int triggerType = Mexoscope::kTriggerFree;
+    int triggerLimit = 1;
+    double triggerSpeed = 0.0;
+    int tempoDivision = 3;
+    Mexoscope::HostTempo hostTempo;
+    double counterSpeed = 1.0;
+    float hysteresis = 0.0f;
+    int triggerFilterType = Mexoscope::kFilterOff;
+    double sampleRate = 44100.0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MexoscopeReference)
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+  Lock-free queue that delivers parameter changes to the audio thread.
+
+  Parameter changes can come from the host (often on the audio thread itself)
+  and from the editor (on the message thread) at the same time, so any thread
+  may push. Only the audio thread pops. This is a bounded multi-producer
+  queue in the style of Dmitry Vyukov's: every cell has a sequence number that
+  tells producers and the consumer whose turn it is, so nobody ever waits on a
+  lock, and nothing is allocated after construction.
+
+  Every event carries the sample offset inside the next processed block at
+  which it should take effect. Changes that have no timing information of
+  their own use offset 0, i.e. the start of the next block.
+*/
+class ParameterEventQueue
+{
+public:
+    struct Event
+    {
+        int sampleOffset;
+        int index;
+        float value;
+    };
+
+    static constexpr size_t kCapacity = 256;
+
+    ParameterEventQueue()
+    {
+        for (size_t i = 0; i < kCapacity; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    // Returns false if the queue is full and the event was dropped.
+    bool push(const Event& event) noexcept
+    {
+        size_t position = enqueuePosition.load(std::memory_order_relaxed);
+        Cell* cell;
+
+        while (true) {
+            cell = &cells[position & (kCapacity - 1)];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const auto difference = intptr_t(sequence) - intptr_t(position);
+
+            if (difference == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->event = event;
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Audio thread only.
+    bool pop(Event& event) noexcept
+    {
+        Cell& cell = cells[dequeuePosition & (kCapacity - 1)];
+        const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if (intptr_t(sequence) - intptr_t(dequeuePosition + 1) < 0) {
+            return false;
+        }
+
+        event = cell.event;
+        cell.sequence.store(dequeuePosition + kCapacity, std::memory_order_release);
+        dequeuePosition++;
+        return true;
+    }
+
+private:
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Event event;
+    };
+
+    std::array<Cell, kCapacity> cells;
+
+    alignas(64) std::atomic<size_t> enqueuePosition { 0 };
+    alignas(64) size_t dequeuePosition = 0;
+};
@@ -6,15 +6,25 @@ MexoscopeAudioProcessorEditor::MexoscopeAudioProcessorEditor(MexoscopeAudioProce
     : juce::AudioProcessorEditor(&p),
       audioProcessor(p),
       effect(audioProcessor.mexoscope),
+      consumer(effect),
       tooltipWindow(this, 700),
-      waveDisplay(effect)
+      waveDisplay(effect, audioProcessor.getAverager(), audioProcessor.getTracer()),
+      loudnessLanes(audioProcessor.getLoudnessMeter()),
+      segmentsPanel(audioProcessor),
+      maskPanel(audioProcessor),
+      triggerStatsPanel(audioProcessor.getTriggerStatistics()),
+      healthPanel(audioProcessor.getStreamMonitor())
 {
     setLookAndFeel(&lookAndFeel);
 
     configureKnob(timeKnob, 0.75, "Time window");
     configureKnob(ampKnob, 0.5, "Amplitude window");
-    configureKnob(intTrigSpeedKnob, 0.5, "Internal trigger speed");
+    configureKnob(trimKnob, 0.5, "Channel trim, before the amplitude window");
+    configureKnob(offsetKnob, 0.5, "Channel offset");
+    configureKnob(intTrigSpeedKnob, 0.5, "Internal trigger speed, or the note length in Tempo mode");
     configureKnob(retrigThreshKnob, 0.5, "Retrigger threshold");
+    configureKnob(triggerFreqKnob, 0.5, "Trigger filter frequency");
+    configureKnob(triggerHystKnob, 0.0, "Trigger hysteresis (noise reject)");
 
     retrigLevelSlider.setSliderStyle(juce::Slider::LinearVertical);
     retrigLevelSlider.setRange(0.0, 1.0, 0.0);
@@ -27,44 +37,220 @@ MexoscopeAudioProcessorEditor::MexoscopeAudioProcessorEditor(MexoscopeAudioProce
     triggerModeBox.addItem("Rising", 2);
     triggerModeBox.addItem("Falling", 3);
     triggerModeBox.addItem("Internal", 4);
+    triggerModeBox.addItem("External", 5);
+    triggerModeBox.addItem("Tempo", 6);
     triggerModeBox.setTooltip("Trigger mode");
 
+    triggerFilterBox.addItem("Off", 1);
+    triggerFilterBox.addItem("High-pass", 2);
+    triggerFilterBox.addItem("Low-pass", 3);
+    triggerFilterBox.addItem("Band-pass", 4);
+    triggerFilterBox.setTooltip("Filter the signal the trigger looks at (not the display)");
+
+    // Item IDs: 1 is off, then 10 + k for linear and 20 + k for exponential
+    // averaging of 4^k sweeps.
+    averageBox.addItem("No averaging", 1);
+    averageBox.addSectionHeading("Linear");
+    for (int k = 1; k <= 6; ++k) {
+        averageBox.addItem("Average " + juce::String(1 << (2 * k)), 10 + k);
+    }
+    averageBox.addSectionHeading("Exponential");
+    for (int k = 1; k <= 6; ++k) {
+        averageBox.addItem("Exp. average " + juce::String(1 << (2 * k)), 20 + k);
+    }
+    averageBox.setTooltip("Average triggered sweeps to bring out periodic detail under noise");
+
     configureToggle(syncRedrawButton, "Sync Redraw", "Refresh display on trigger only");
     configureToggle(freezeButton, "Freeze", "Freeze waveform rendering");
     configureToggle(dcKillButton, "DC-Kill", "Enable DC offset removal");
-    configureToggle(rightChannelButton, "Right Channel", "Toggle left/right monitored channel");
+    // Item IDs: 1 and 2 are left and right, then 2 + kMathXXX.
+    channelBox.addItem("Left", 1);
+    channelBox.addItem("Right", 2);
+    channelBox.addSectionHeading("Math");
+    channelBox.addItem("L + R", 2 + Mexoscope::kMathSum);
+    channelBox.addItem(juce::String::fromUTF8("L \xe2\x88\x92 R"), 2 + Mexoscope::kMathDifference);
+    channelBox.addItem("Mid", 2 + Mexoscope::kMathMid);
+    channelBox.addItem("Side", 2 + Mexoscope::kMathSide);
+    channelBox.addItem(juce::String::fromUTF8("L \xc3\x97 R"), 2 + Mexoscope::kMathProduct);
+    channelBox.setTooltip("Channel to show and trigger on. The External trigger uses the same channel of the sidechain");
+    channelBox.onChange = [this] { updateChannel(); };
+    truePeakBox.addItem("Sample peaks", 1);
+    truePeakBox.addItem("True peak 4x", 2);
+    truePeakBox.addItem("True peak 8x", 3);
+    truePeakBox.setTooltip("Include the peaks between the samples, found by oversampling, when a pixel spans "
+                           + juce::String(Mexoscope::kTruePeakMinSamplesPerPixel) + " samples or more. Overs are marked in red");
+    viewsBox.addItem("Main view", 1);
+    viewsBox.addItem("+ 1 detail view", 2);
+    viewsBox.addItem("+ 2 detail views", 3);
+    viewsBox.setSelectedId(1, juce::dontSendNotification);
+    viewsBox.setTooltip("Extra views under the display, with their own time window, amplitude and trigger position");
+    viewsBox.onChange = [this] {
+        for (int i = 0; i < kMaxDetailViews; ++i) {
+            detailViews[size_t(i)]->setVisible(i < viewsBox.getSelectedId() - 1);
+        }
+        resized();
+    };
+    for (int i = 0; i < kMaxDetailViews; ++i) {
+        detailViews.push_back(std::make_unique<DetailView>(effect));
+        addChildComponent(*detailViews.back());
+    }
+    configureToggle(exportButton, "Shared Memory", "Export the capture stream to shared memory as "
+                                                   + audioProcessor.getExportName());
+
+    exportButton.onClick = [this] {
+        if (!audioProcessor.setExportEnabled(exportButton.getToggleState())) {
+            exportButton.setToggleState(false, juce::dontSendNotification);
+        }
+    };
+
+    configureToggle(traceButton, "Trace", "Record a timeline trace for chrome://tracing or ui.perfetto.dev");
+    traceButton.onClick = [this] { updateTracing(); };
+
+    configureToggle(segmentsButton, "Segments", "Record a segment at every trigger, and browse or export them");
+    segmentsButton.onClick = [this] {
+        if (segmentsButton.getToggleState()) {
+            maskButton.setToggleState(false, juce::sendNotificationSync);
+        }
+        segmentsPanel.setVisible(segmentsButton.getToggleState());
+        if (!segmentsPanel.isVisible()) {
+            waveDisplay.setFrameOverride(nullptr, nullptr);
+        }
+    };
+    addChildComponent(segmentsPanel);
+    addAndMakeVisible(segmentsButton);
+
+    configureToggle(maskButton, "Mask", "Test every frame against a tolerance mask, and browse or export the failures");
+    maskButton.onClick = [this] {
+        if (maskButton.getToggleState()) {
+            segmentsButton.setToggleState(false, juce::sendNotificationSync);
+        }
+        maskPanel.setVisible(maskButton.getToggleState());
+        if (!maskPanel.isVisible()) {
+            waveDisplay.setFrameOverride(nullptr, nullptr);
+            waveDisplay.setMask(nullptr);
+        }
+    };
+    addChildComponent(maskPanel);
+    addAndMakeVisible(maskButton);
+
+    configureToggle(triggerStatsButton, "Stats", "Show the trigger rate, period and jitter. Click the panel to start over");
+    triggerStatsButton.onClick = [this] { triggerStatsPanel.setVisible(triggerStatsButton.getToggleState()); };
+    addChildComponent(triggerStatsPanel);
+    addAndMakeVisible(triggerStatsButton);
+
+    configureToggle(healthButton, "Health", "Show the NaN, denormals, clicks, dropouts, stuck samples and DC offsets "
+                                            "found in the main input, which is always watched");
+    healthButton.onClick = [this] { healthPanel.setVisible(healthButton.getToggleState()); };
+    addChildComponent(healthPanel);
+    addAndMakeVisible(healthButton);
 
     addAndMakeVisible(waveDisplay);
     addAndMakeVisible(timeKnob);
     addAndMakeVisible(ampKnob);
+    addAndMakeVisible(trimKnob);
+    addAndMakeVisible(offsetKnob);
     addAndMakeVisible(intTrigSpeedKnob);
     addAndMakeVisible(retrigThreshKnob);
     addAndMakeVisible(retrigLevelSlider);
+    addAndMakeVisible(triggerFreqKnob);
+    addAndMakeVisible(triggerHystKnob);
     addAndMakeVisible(triggerModeBox);
+    addAndMakeVisible(triggerFilterBox);
+    addAndMakeVisible(averageBox);
     addAndMakeVisible(syncRedrawButton);
     addAndMakeVisible(freezeButton);
     addAndMakeVisible(dcKillButton);
-    addAndMakeVisible(rightChannelButton);
-
-    timeKnob.setValue(effect.getParameter(Mexoscope::kTimeWindow));
-    ampKnob.setValue(effect.getParameter(Mexoscope::kAmpWindow));
-    intTrigSpeedKnob.setValue(effect.getParameter(Mexoscope::kTriggerSpeed));
-    retrigThreshKnob.setValue(effect.getParameter(Mexoscope::kTriggerLimit));
-    retrigLevelSlider.setValue(effect.getParameter(Mexoscope::kTriggerLevel));
+    addAndMakeVisible(channelBox);
+    addAndMakeVisible(truePeakBox);
+    addAndMakeVisible(viewsBox);
+    addAndMakeVisible(exportButton);
+    addAndMakeVisible(traceButton);
+
+    // The attachments also set the initial values of the controls.
+    const std::pair<juce::Slider*, int> sliders[] = {
+        { &timeKnob, Mexoscope::kTimeWindow },
+        { &ampKnob, Mexoscope::kAmpWindow },
+        { &trimKnob, Mexoscope::kChannelTrim },
+        { &offsetKnob, Mexoscope::kChannelOffset },
+        { &intTrigSpeedKnob, Mexoscope::kTriggerSpeed },
+        { &retrigThreshKnob, Mexoscope::kTriggerLimit },
+        { &retrigLevelSlider, Mexoscope::kTriggerLevel },
+        { &triggerFreqKnob, Mexoscope::kTriggerFreq },
+        { &triggerHystKnob, Mexoscope::kTriggerHyst },
+    };
+    for (auto [slider, index] : sliders) {
+        sliderAttachments.push_back(std::make_unique<juce::SliderParameterAttachment>(
+            audioProcessor.getScopeParameter(index), *slider));
+    }
 
-    const int triggerIndex = juce::jlimit(0, Mexoscope::kNumTriggerTypes - 1,
-                                          int(effect.getParameter(Mexoscope::kTriggerType) * float(Mexoscope::kNumTriggerTypes) + 0.0001f));
-    triggerModeBox.setSelectedItemIndex(triggerIndex, juce::dontSendNotification);
+    const std::pair<juce::Button*, int> buttons[] = {
+        { &syncRedrawButton, Mexoscope::kSyncDraw },
+        { &freezeButton, Mexoscope::kFreeze },
+        { &dcKillButton, Mexoscope::kDCKill },
+    };
+    for (auto [button, index] : buttons) {
+        buttonAttachments.push_back(std::make_unique<juce::ButtonParameterAttachment>(
+            audioProcessor.getScopeParameter(index), *button));
+    }
 
-    syncRedrawButton.setToggleState(effect.getParameter(Mexoscope::kSyncDraw) > 0.5f, juce::dontSendNotification);
-    freezeButton.setToggleState(effect.getParameter(Mexoscope::kFreeze) > 0.5f, juce::dontSendNotification);
-    dcKillButton.setToggleState(effect.getParameter(Mexoscope::kDCKill) > 0.5f, juce::dontSendNotification);
-    rightChannelButton.setToggleState(effect.getParameter(Mexoscope::kChannel) > 0.5f, juce::dontSendNotification);
+    triggerModeAttachment = std::make_unique<juce::ComboBoxParameterAttachment>(
+        audioProcessor.getScopeParameter(Mexoscope::kTriggerType), triggerModeBox);
+    triggerFilterAttachment = std::make_unique<juce::ComboBoxParameterAttachment>(
+        audioProcessor.getScopeParameter(Mexoscope::kTriggerFilter), triggerFilterBox);
+    truePeakAttachment = std::make_unique<juce::ComboBoxParameterAttachment>(
+        audioProcessor.getScopeParameter(Mexoscope::kTruePeak), truePeakBox);
+
+    exportButton.setToggleState(audioProcessor.isExportEnabled(), juce::dontSendNotification);
+
+    {
+        const auto& averager = audioProcessor.getAverager();
+        const int k = juce::roundToInt(std::log2(double(averager.getNumSweeps())) / 2.0);
+        switch (averager.getMode()) {
+            case SignalAverager::Mode::Off: averageBox.setSelectedId(1, juce::dontSendNotification); break;
+            case SignalAverager::Mode::Linear: averageBox.setSelectedId(10 + k, juce::dontSendNotification); break;
+            case SignalAverager::Mode::Exponential: averageBox.setSelectedId(20 + k, juce::dontSendNotification); break;
+        }
+    }
+    averageBox.onChange = [this] { updateAveraging(); };
+    traceButton.setToggleState(audioProcessor.getTracer().isRecording(), juce::dontSendNotification);
+    if (audioProcessor.getTracer().isRecording()) {
+        traceButton.setTooltip("Recording to " + audioProcessor.getTracer().getFile().getFullPathName());
+    }
 
-    constrainer.setSizeLimits(840, 400, 1800, 1000);
+    configureToggle(loudnessButton, "Loudness", "Meter the loudness and true peak of the main input, also while the editor is closed");
+    loudnessButton.setToggleState(audioProcessor.getLoudnessMeter().isEnabled(), juce::dontSendNotification);
+    loudnessButton.onClick = [this] {
+        audioProcessor.getLoudnessMeter().setEnabled(loudnessButton.getToggleState());
+        loudnessLanes.setVisible(loudnessButton.getToggleState());
+        resized();
+    };
+    addAndMakeVisible(loudnessButton);
+    addChildComponent(loudnessLanes);
+    loudnessLanes.setVisible(loudnessButton.getToggleState());
+
+#if MEXOSCOPE_INSTRUMENTATION
+    diagnosticsPanel.addProbe("processBlock", audioProcessor.getBlockProbe(), true);
+    diagnosticsPanel.addProbe("capture", effect.getCaptureProbe(), true);
+ #if MEXOSCOPE_REFERENCE_CHECK
+    diagnosticsPanel.addProbe("reference", effect.getReferenceProbe(), true);
+ #endif
+    diagnosticsPanel.addProbe("paint", waveDisplay.getPaintProbe(), false);
+    addChildComponent(diagnosticsPanel);
+
+    configureToggle(diagnosticsButton, "Diag", "Show the cost of the audio callback, capture and painting");
+    diagnosticsButton.onClick = [this] { diagnosticsPanel.setVisible(diagnosticsButton.getToggleState()); };
+    addAndMakeVisible(diagnosticsButton);
+#endif
+
+    // Only the cursor and the views use the raw samples, so they're only
+    // kept while the editor is open. Without them, the cursor reads out
+    // pixel positions.
+    effect.getHistory().start();
+
+    constrainer.setSizeLimits(840, 460, 1800, 1000);
     setResizable(true, true);
     setConstrainer(&constrainer);
-    setSize(1024, 480);
+    setSize(1024, 540);
 
     updateParameters();
     startTimerHz(30);
@@ -73,6 +259,7 @@ MexoscopeAudioProcessorEditor::MexoscopeAudioProcessorEditor(MexoscopeAudioProce
 MexoscopeAudioProcessorEditor::~MexoscopeAudioProcessorEditor()
 {
     stopTimer();
+    effect.getHistory().clear();
     setLookAndFeel(nullptr);
 }
 
@@ -141,17 +328,26 @@ void MexoscopeAudioProcessorEditor::paint(juce::Graphics& g)
 
     g.drawText("Time", timeLabelBounds, juce::Justification::centred, false);
     g.drawText("Amp", ampLabelBounds, juce::Justification::centred, false);
+    g.drawText("Trim", trimLabelBounds, juce::Justification::centred, false);
+    g.drawText("Offset", offsetLabelBounds, juce::Justification::centred, false);
     g.drawText("Speed", speedLabelBounds, juce::Justification::centred, false);
     g.drawText("Thresh", threshLabelBounds, juce::Justification::centred, false);
+    g.drawText("Freq", freqLabelBounds, juce::Justification::centred, false);
+    g.drawText("Hyst", hystLabelBounds, juce::Justification::centred, false);
     g.drawText("Mode", triggerModeLabelBounds, juce::Justification::centredLeft, false);
+    g.drawText("Filter", triggerFilterLabelBounds, juce::Justification::centredLeft, false);
     g.drawText("Level", triggerLevelLabelBounds, juce::Justification::centred, false);
 
     g.setColour(ui::kTextColour);
     g.setFont(ui::valueFont());
     g.drawText(timeValueText, timeValueBounds, juce::Justification::centred, false);
     g.drawText(ampValueText, ampValueBounds, juce::Justification::centred, false);
+    g.drawText(trimValueText, trimValueBounds, juce::Justification::centred, false);
+    g.drawText(offsetValueText, offsetValueBounds, juce::Justification::centred, false);
     g.drawText(speedValueText, speedValueBounds, juce::Justification::centred, false);
     g.drawText(threshValueText, threshValueBounds, juce::Justification::centred, false);
+    g.drawText(freqValueText, freqValueBounds, juce::Justification::centred, false);
+    g.drawText(hystValueText, hystValueBounds, juce::Justification::centred, false);
 
     auto rowsArea = analysisSection.reduced(ui::kSectionPadding);
     rowsArea.removeFromTop(26);
@@ -183,13 +379,30 @@ void MexoscopeAudioProcessorEditor::resized()
     auto sidebar = content.removeFromRight(sidebarWidth);
     content.removeFromRight(ui::kSectionGap);
 
-    waveDisplay.setBounds(content);
+    // The detail views share the space under the wave display, which gets
+    // twice the height of each. The loudness lanes go right under the wave
+    // display, at a fixed height.
+    auto displayArea = content;
+    const int lanesHeight = loudnessLanes.isVisible() ? LoudnessLanes::kPreferredHeight + ui::kSectionGap : 0;
+    const int numDetailViews = viewsBox.getSelectedId() - 1;
+    if (numDetailViews > 0) {
+        const int share = (content.getHeight() - lanesHeight - ui::kSectionGap * numDetailViews) / (numDetailViews + 2);
+        for (int i = numDetailViews - 1; i >= 0; --i) {
+            detailViews[size_t(i)]->setBounds(displayArea.removeFromBottom(share));
+            displayArea.removeFromBottom(ui::kSectionGap);
+        }
+    }
+    if (loudnessLanes.isVisible()) {
+        loudnessLanes.setBounds(displayArea.removeFromBottom(LoudnessLanes::kPreferredHeight));
+        displayArea.removeFromBottom(ui::kSectionGap);
+    }
+    waveDisplay.setBounds(displayArea);
 
     const int gap = ui::kSectionGap;
     const int availableHeight = juce::jmax(0, sidebar.getHeight() - gap * 3);
 
-    int displayHeight = int(std::round(float(availableHeight) * 0.21f));
-    int triggerHeight = int(std::round(float(availableHeight) * 0.32f));
+    int displayHeight = int(std::round(float(availableHeight) * 0.19f));
+    int triggerHeight = int(std::round(float(availableHeight) * 0.36f));
     int optionsHeight = int(std::round(float(availableHeight) * 0.25f));
     int analysisHeight = availableHeight - displayHeight - triggerHeight - optionsHeight;
 
@@ -201,14 +414,49 @@ void MexoscopeAudioProcessorEditor::resized()
     sidebar.removeFromTop(gap);
     analysisSection = sidebar.withHeight(analysisHeight);
 
+    auto analysisHeader = analysisSection.reduced(ui::kSectionPadding, 0).removeFromTop(24);
+
+    auto optionsHeader = optionsSection.reduced(ui::kSectionPadding, 0).removeFromTop(24);
+    segmentsButton.setBounds(optionsHeader.removeFromRight(90));
+    healthButton.setBounds(optionsHeader.removeFromRight(80));
+    healthPanel.setBounds(displayArea.reduced(int(ui::kScopePadding))
+                              .removeFromTop(StreamHealthPanel::kPreferredHeight)
+                              .withSizeKeepingCentre(StreamHealthPanel::kPreferredWidth, StreamHealthPanel::kPreferredHeight));
+    segmentsPanel.setBounds(displayArea.reduced(int(ui::kScopePadding))
+                                .removeFromBottom(SegmentsPanel::kPreferredHeight));
+    auto triggerHeader = triggerSection.reduced(ui::kSectionPadding, 0).removeFromTop(24);
+    maskButton.setBounds(triggerHeader.removeFromRight(70));
+    triggerStatsButton.setBounds(triggerHeader.removeFromRight(70));
+    triggerStatsPanel.setBounds(displayArea.reduced(int(ui::kScopePadding))
+                                    .removeFromTop(TriggerStatsPanel::kPreferredHeight)
+                                    .removeFromLeft(TriggerStatsPanel::kPreferredWidth));
+    maskPanel.setBounds(displayArea.reduced(int(ui::kScopePadding))
+                            .removeFromBottom(MaskPanel::kPreferredHeight));
+
+#if MEXOSCOPE_INSTRUMENTATION
+    diagnosticsButton.setBounds(analysisHeader.removeFromRight(64));
+    diagnosticsPanel.setBounds(displayArea.reduced(int(ui::kScopePadding))
+                                   .removeFromTop(diagnosticsPanel.getPreferredHeight())
+                                   .removeFromRight(220));
+#endif
+
+    loudnessButton.setBounds(analysisHeader.removeFromRight(96));
+
+    averageBox.setBounds(displaySection.reduced(ui::kSectionPadding, 0).removeFromTop(24).removeFromRight(140).reduced(0, 2));
+
     auto displayInner = displaySection.reduced(ui::kSectionPadding);
     displayInner.removeFromTop(24);
 
     auto displayRows = displayInner;
     const int displayGap = 8;
-    auto timeColumn = displayRows.removeFromLeft((displayRows.getWidth() - displayGap) / 2);
+    const int displayColumnWidth = (displayRows.getWidth() - displayGap * 3) / 4;
+    auto timeColumn = displayRows.removeFromLeft(displayColumnWidth);
+    displayRows.removeFromLeft(displayGap);
+    auto ampColumn = displayRows.removeFromLeft(displayColumnWidth);
+    displayRows.removeFromLeft(displayGap);
+    auto trimColumn = displayRows.removeFromLeft(displayColumnWidth);
     displayRows.removeFromLeft(displayGap);
-    auto ampColumn = displayRows;
+    auto offsetColumn = displayRows;
 
     const int labelHeight = 14;
     const int valueHeight = 16;
@@ -223,6 +471,14 @@ void MexoscopeAudioProcessorEditor::resized()
     ampLabelBounds = ampColumn.removeFromTop(labelHeight);
     ampValueBounds = ampColumn.removeFromTop(valueHeight);
 
+    trimKnob.setBounds(trimColumn.removeFromTop(knobSize).withSizeKeepingCentre(knobSize, knobSize));
+    trimLabelBounds = trimColumn.removeFromTop(labelHeight);
+    trimValueBounds = trimColumn.removeFromTop(valueHeight);
+
+    offsetKnob.setBounds(offsetColumn.removeFromTop(knobSize).withSizeKeepingCentre(knobSize, knobSize));
+    offsetLabelBounds = offsetColumn.removeFromTop(labelHeight);
+    offsetValueBounds = offsetColumn.removeFromTop(valueHeight);
+
     auto triggerInner = triggerSection.reduced(ui::kSectionPadding);
     triggerInner.removeFromTop(24);
 
@@ -230,6 +486,12 @@ void MexoscopeAudioProcessorEditor::resized()
     triggerModeLabelBounds = modeRow.removeFromLeft(52);
     triggerModeBox.setBounds(modeRow);
 
+    triggerInner.removeFromTop(4);
+
+    auto filterRow = triggerInner.removeFromTop(28);
+    triggerFilterLabelBounds = filterRow.removeFromLeft(52);
+    triggerFilterBox.setBounds(filterRow);
+
     triggerInner.removeFromTop(8);
 
     auto triggerControls = triggerInner;
@@ -239,9 +501,14 @@ void MexoscopeAudioProcessorEditor::resized()
     triggerLevelLabelBounds = levelColumn.removeFromTop(14);
     retrigLevelSlider.setBounds(levelColumn.reduced(4, 0));
 
-    auto speedColumn = triggerControls.removeFromLeft((triggerControls.getWidth() - displayGap) / 2);
+    const int triggerColumnWidth = (triggerControls.getWidth() - displayGap * 3) / 4;
+    auto speedColumn = triggerControls.removeFromLeft(triggerColumnWidth);
     triggerControls.removeFromLeft(displayGap);
-    auto threshColumn = triggerControls;
+    auto threshColumn = triggerControls.removeFromLeft(triggerColumnWidth);
+    triggerControls.removeFromLeft(displayGap);
+    auto freqColumn = triggerControls.removeFromLeft(triggerColumnWidth);
+    triggerControls.removeFromLeft(displayGap);
+    auto hystColumn = triggerControls;
 
     const int triggerKnobSize = juce::jlimit(28, 64, juce::jmin(speedColumn.getWidth(), speedColumn.getHeight() - labelHeight - valueHeight));
 
@@ -253,56 +520,166 @@ void MexoscopeAudioProcessorEditor::resized()
     threshLabelBounds = threshColumn.removeFromTop(labelHeight);
     threshValueBounds = threshColumn.removeFromTop(valueHeight);
 
+    triggerFreqKnob.setBounds(freqColumn.removeFromTop(triggerKnobSize).withSizeKeepingCentre(triggerKnobSize, triggerKnobSize));
+    freqLabelBounds = freqColumn.removeFromTop(labelHeight);
+    freqValueBounds = freqColumn.removeFromTop(valueHeight);
+
+    triggerHystKnob.setBounds(hystColumn.removeFromTop(triggerKnobSize).withSizeKeepingCentre(triggerKnobSize, triggerKnobSize));
+    hystLabelBounds = hystColumn.removeFromTop(labelHeight);
+    hystValueBounds = hystColumn.removeFromTop(valueHeight);
+
     auto optionsInner = optionsSection.reduced(ui::kSectionPadding);
     optionsInner.removeFromTop(24);
 
+    // Two columns of up to four.
     const int optionGap = 4;
     const int optionHeight = juce::jmax(18, (optionsInner.getHeight() - optionGap * 3) / 4);
 
-    syncRedrawButton.setBounds(optionsInner.removeFromTop(optionHeight));
-    optionsInner.removeFromTop(optionGap);
-    freezeButton.setBounds(optionsInner.removeFromTop(optionHeight));
-    optionsInner.removeFromTop(optionGap);
-    dcKillButton.setBounds(optionsInner.removeFromTop(optionHeight));
-    optionsInner.removeFromTop(optionGap);
-    rightChannelButton.setBounds(optionsInner.removeFromTop(optionHeight));
+    auto optionsLeft = optionsInner.removeFromLeft((optionsInner.getWidth() - displayGap) / 2);
+    optionsInner.removeFromLeft(displayGap);
+    auto optionsRight = optionsInner;
+
+    syncRedrawButton.setBounds(optionsLeft.removeFromTop(optionHeight));
+    optionsLeft.removeFromTop(optionGap);
+    freezeButton.setBounds(optionsLeft.removeFromTop(optionHeight));
+    optionsLeft.removeFromTop(optionGap);
+    dcKillButton.setBounds(optionsLeft.removeFromTop(optionHeight));
+    optionsLeft.removeFromTop(optionGap);
+    viewsBox.setBounds(optionsLeft.removeFromTop(optionHeight));
+
+    channelBox.setBounds(optionsRight.removeFromTop(optionHeight));
+    optionsRight.removeFromTop(optionGap);
+    truePeakBox.setBounds(optionsRight.removeFromTop(optionHeight));
+    optionsRight.removeFromTop(optionGap);
+    exportButton.setBounds(optionsRight.removeFromTop(optionHeight));
+    optionsRight.removeFromTop(optionGap);
+    traceButton.setBounds(optionsRight.removeFromTop(optionHeight));
 }
 
 void MexoscopeAudioProcessorEditor::timerCallback()
 {
+    const tracing::ScopedSpan span(audioProcessor.getTracer(), tracing::EventType::TimerTick);
+
+    if (segmentsPanel.isVisible()) {
+        segmentsPanel.update();
+        waveDisplay.setFrameOverride(segmentsPanel.getSelectedFrame(), segmentsPanel.getEnvelope());
+    }
+
+    if (maskPanel.isVisible()) {
+        maskPanel.update();
+        waveDisplay.setFrameOverride(maskPanel.getSelectedFrame(), nullptr);
+        waveDisplay.setMask(audioProcessor.mexoscope.getMaskTest().getMask());
+    }
+
     waveDisplay.repaint();
+    for (auto& view : detailViews) {
+        if (view->isVisible()) {
+            view->repaint();
+        }
+    }
+    if (loudnessLanes.isVisible()) {
+        loudnessLanes.update();
+    }
+    if (triggerStatsPanel.isVisible()) {
+        triggerStatsPanel.update();
+    }
+    healthPanel.update();
     updateParameters();
+
+#if MEXOSCOPE_INSTRUMENTATION
+    if (diagnosticsPanel.isVisible()) {
+        diagnosticsPanel.update();
+    }
+#endif
 }
 
-void MexoscopeAudioProcessorEditor::updateParameters()
+void MexoscopeAudioProcessorEditor::updateTracing()
 {
-    effect.setParameter(Mexoscope::kTimeWindow, float(timeKnob.getValue()));
-    effect.setParameter(Mexoscope::kAmpWindow, float(ampKnob.getValue()));
-    effect.setParameter(Mexoscope::kTriggerSpeed, float(intTrigSpeedKnob.getValue()));
-    effect.setParameter(Mexoscope::kTriggerLimit, float(retrigThreshKnob.getValue()));
-    effect.setParameter(Mexoscope::kTriggerLevel, float(retrigLevelSlider.getValue()));
+    auto& tracer = audioProcessor.getTracer();
+
+    if (!traceButton.getToggleState()) {
+        tracer.stop();
+        traceButton.setTooltip("Last trace: " + tracer.getFile().getFullPathName());
+        return;
+    }
 
-    const int selectedMode = juce::jmax(0, triggerModeBox.getSelectedItemIndex());
-    effect.setParameter(Mexoscope::kTriggerType,
-                        float(selectedMode) / float(Mexoscope::kNumTriggerTypes));
+    const auto file = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                          .getNonexistentChildFile("mexoscope-trace", ".json");
+    if (tracer.start(file)) {
+        traceButton.setTooltip("Recording to " + file.getFullPathName());
+    } else {
+        traceButton.setToggleState(false, juce::dontSendNotification);
+    }
+}
 
-    effect.setParameter(Mexoscope::kSyncDraw, syncRedrawButton.getToggleState() ? 1.0f : 0.0f);
-    effect.setParameter(Mexoscope::kFreeze, freezeButton.getToggleState() ? 1.0f : 0.0f);
-    effect.setParameter(Mexoscope::kDCKill, dcKillButton.getToggleState() ? 1.0f : 0.0f);
-    effect.setParameter(Mexoscope::kChannel, rightChannelButton.getToggleState() ? 1.0f : 0.0f);
+void MexoscopeAudioProcessorEditor::updateAveraging()
+{
+    const int id = averageBox.getSelectedId();
+    auto& averager = audioProcessor.getAverager();
 
+    if (id > 20) {
+        averager.setMode(SignalAverager::Mode::Exponential, 1 << (2 * (id - 20)));
+    } else if (id > 10) {
+        averager.setMode(SignalAverager::Mode::Linear, 1 << (2 * (id - 10)));
+    } else {
+        averager.setMode(SignalAverager::Mode::Off, 1);
+    }
+}
+
+void MexoscopeAudioProcessorEditor::updateChannel()
+{
+    const int id = channelBox.getSelectedId();
+    const int math = juce::jmax(int(Mexoscope::kMathOff), id - 2);
+
+    auto setParameter = [this](int index, float normalisedValue) {
+        auto& parameter = audioProcessor.getScopeParameter(index);
+        parameter.beginChangeGesture();
+        parameter.setValueNotifyingHost(normalisedValue);
+        parameter.endChangeGesture();
+    };
+
+    // Left and right stay as they were when a math channel is picked.
+    if (math == Mexoscope::kMathOff) {
+        setParameter(Mexoscope::kChannel, id == 2 ? 1.0f : 0.0f);
+    }
+    setParameter(Mexoscope::kMathChannel,
+                 audioProcessor.getScopeParameter(Mexoscope::kMathChannel).convertTo0to1(float(math)));
+}
+
+void MexoscopeAudioProcessorEditor::updateChannelBox()
+{
+    const int math = int(effect.getParameter(Mexoscope::kMathChannel) * float(Mexoscope::kNumMathChannels) + 0.0001f);
+    const int id = (math != Mexoscope::kMathOff) ? 2 + math
+                                                 : (effect.getParameter(Mexoscope::kChannel) > 0.5f ? 2 : 1);
+    channelBox.setSelectedId(id, juce::dontSendNotification);
+}
+
+void MexoscopeAudioProcessorEditor::updateParameters()
+{
+    // The controls are attached to the parameters, so only the value
+    // readouts need updating here.
     timeValueText = formatMetricValue(float(std::pow(10.0, 1.5 - timeKnob.getValue() * 5.0)));
     ampValueText = formatMetricValue(float(std::pow(10.0, ampKnob.getValue() * 6.0 - 3.0)));
+    trimValueText = juce::String(trimKnob.getValue() * 48.0 - 24.0, 1) + " dB";
+    offsetValueText = juce::String(offsetKnob.getValue() * 2.0 - 1.0, 2);
+    updateChannelBox();
 
-    const double triggerSpeed = std::pow(10.0, intTrigSpeedKnob.getValue() * 2.5 - 5.0);
-    speedValueText = formatMetricValue(float(triggerSpeed * effect.getSampleRate()));
+    if (triggerModeBox.getSelectedId() - 1 == Mexoscope::kTriggerTempo) {
+        speedValueText = Mexoscope::getTempoDivisionName(Mexoscope::getTempoDivisionIndex(float(intTrigSpeedKnob.getValue())));
+    } else {
+        const double triggerSpeed = std::pow(10.0, intTrigSpeedKnob.getValue() * 2.5 - 5.0);
+        speedValueText = formatMetricValue(float(triggerSpeed * effect.getSampleRate()));
+    }
     threshValueText = formatMetricValue(float(std::pow(10.0, retrigThreshKnob.getValue() * 4.0)));
+    freqValueText = formatMetricValue(float(20.0 * std::pow(1000.0, triggerFreqKnob.getValue())));
+    hystValueText = formatMetricValue(float(triggerHystKnob.getValue() * 0.5));
 
     const auto cursorMetrics = waveDisplay.getCursorMetrics();
     if (cursorMetrics.has_value()) {
         analysisYText = formatAnalysisValue(cursorMetrics->yLinear, 5);
         analysisYDbText = formatAnalysisValue(cursorMetrics->yDb, 4);
-        analysisSamplesText = formatAnalysisValue(cursorMetrics->xSamples, 2);
+        analysisSamplesText = cursorMetrics->exact ? juce::String(juce::roundToInt(cursorMetrics->xSamples))
+                                                   : formatAnalysisValue(cursorMetrics->xSamples, 2);
         analysisSecondsText = formatAnalysisValue(cursorMetrics->xSeconds, 5);
         analysisMsText = formatAnalysisValue(cursorMetrics->xMs, 3);
         analysisHzText = cursorMetrics->infiniteHz ? "infinite" : formatAnalysisValue(cursorMetrics->xHz, 3);
@@ -1,8 +1,15 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include "DetailView.h"
+#include "DiagnosticsPanel.h"
+#include "LoudnessLanes.h"
+#include "MaskPanel.h"
 #include "ModernLookAndFeel.h"
 #include "PluginProcessor.h"
+#include "SegmentsPanel.h"
+#include "StreamHealthPanel.h"
+#include "TriggerStatsPanel.h"
 #include "WaveDisplay.h"
 
 class MexoscopeAudioProcessorEditor : public juce::AudioProcessorEditor,
@@ -18,6 +25,12 @@ public:
 private:
     void timerCallback() override;
     void updateParameters();
+    void updateTracing();
+    void updateAveraging();
+
+    // The Channel box stands for two parameters, kChannel and kMathChannel.
+    void updateChannel();
+    void updateChannelBox();
 
     void configureKnob(juce::Slider& knob, double defaultValue, const juce::String& tooltip);
     void configureToggle(juce::ToggleButton& button, const juce::String& text, const juce::String& tooltip);
@@ -30,25 +43,78 @@ private:
     MexoscopeAudioProcessor& audioProcessor;
     Mexoscope& effect;
 
+    // Capturing only runs while the editor is open (or something else
+    // uses the frames).
+    Mexoscope::ScopedConsumer consumer;
+
     ModernLookAndFeel lookAndFeel;
     juce::TooltipWindow tooltipWindow;
     juce::ComponentBoundsConstrainer constrainer;
 
     juce::Slider timeKnob;
     juce::Slider ampKnob;
+    juce::Slider trimKnob;
+    juce::Slider offsetKnob;
     juce::Slider intTrigSpeedKnob;
     juce::Slider retrigThreshKnob;
     juce::Slider retrigLevelSlider;
+    juce::Slider triggerFreqKnob;
+    juce::Slider triggerHystKnob;
 
     juce::ComboBox triggerModeBox;
+    juce::ComboBox triggerFilterBox;
+    juce::ComboBox averageBox;
+    juce::ComboBox channelBox;
+    juce::ComboBox truePeakBox;
+    juce::ComboBox viewsBox;
 
     juce::ToggleButton syncRedrawButton;
     juce::ToggleButton freezeButton;
     juce::ToggleButton dcKillButton;
-    juce::ToggleButton rightChannelButton;
+    juce::ToggleButton exportButton;
+    juce::ToggleButton traceButton;
+
+    // Connect the controls to the host-visible parameters. These must be
+    // destroyed before the controls, so they're declared after them.
+    std::vector<std::unique_ptr<juce::SliderParameterAttachment>> sliderAttachments;
+    std::vector<std::unique_ptr<juce::ButtonParameterAttachment>> buttonAttachments;
+    std::unique_ptr<juce::ComboBoxParameterAttachment> triggerModeAttachment;
+    std::unique_ptr<juce::ComboBoxParameterAttachment> triggerFilterAttachment;
+    std::unique_ptr<juce::ComboBoxParameterAttachment> truePeakAttachment;
 
     WaveDisplay waveDisplay;
 
+    // Under the wave display, as many as `viewsBox` asks for.
+    static constexpr int kMaxDetailViews = 2;
+    std::vector<std::unique_ptr<DetailView>> detailViews;
+
+    // Right under the wave display while the meter is on.
+    LoudnessLanes loudnessLanes;
+    juce::ToggleButton loudnessButton;
+
+    // Shown on top of the wave display, which shows its segments.
+    SegmentsPanel segmentsPanel;
+    juce::ToggleButton segmentsButton;
+
+    // Same place as the segments panel, so only one of them is shown.
+    MaskPanel maskPanel;
+    juce::ToggleButton maskButton;
+
+    // Over the top-left corner of the wave display.
+    TriggerStatsPanel triggerStatsPanel;
+    juce::ToggleButton triggerStatsButton;
+
+    // Over the top of the wave display, in the middle.
+    StreamHealthPanel healthPanel;
+    juce::ToggleButton healthButton;
+
+#if MEXOSCOPE_INSTRUMENTATION
+    // Reads the probes of the processor and the wave display, so it's
+    // declared after them.
+    DiagnosticsPanel diagnosticsPanel;
+    juce::ToggleButton diagnosticsButton;
+#endif
+
     juce::Rectangle<int> displaySection;
     juce::Rectangle<int> triggerSection;
     juce::Rectangle<int> optionsSection;
@@ -56,20 +122,33 @@ private:
 
     juce::Rectangle<int> timeLabelBounds;
     juce::Rectangle<int> ampLabelBounds;
+    juce::Rectangle<int> trimLabelBounds;
+    juce::Rectangle<int> offsetLabelBounds;
     juce::Rectangle<int> speedLabelBounds;
     juce::Rectangle<int> threshLabelBounds;
+    juce::Rectangle<int> freqLabelBounds;
+    juce::Rectangle<int> hystLabelBounds;
     juce::Rectangle<int> triggerModeLabelBounds;
+    juce::Rectangle<int> triggerFilterLabelBounds;
     juce::Rectangle<int> triggerLevelLabelBounds;
 
     juce::Rectangle<int> timeValueBounds;
     juce::Rectangle<int> ampValueBounds;
+    juce::Rectangle<int> trimValueBounds;
+    juce::Rectangle<int> offsetValueBounds;
     juce::Rectangle<int> speedValueBounds;
     juce::Rectangle<int> threshValueBounds;
+    juce::Rectangle<int> freqValueBounds;
+    juce::Rectangle<int> hystValueBounds;
 
     juce::String timeValueText;
     juce::String ampValueText;
+    juce::String trimValueText;
+    juce::String offsetValueText;
     juce::String speedValueText;
     juce::String threshValueText;
+    juce::String freqValueText;
+    juce::String hystValueText;
 
     juce::String analysisYText { "--" };
     juce::String analysisYDbText { "--" };
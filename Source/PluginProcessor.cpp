@@ -1,14 +1,169 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "RealtimeCheck.h"
+
+namespace {
+juce::String formatMetric(const double value)
+{
+    return (value < 1000.0) ? juce::String(value, 3) : juce::String(int(value));
+}
+
+juce::AudioParameterFloatAttributes withText(std::function<juce::String(float)> toText)
+{
+    return juce::AudioParameterFloatAttributes().withStringFromValueFunction(
+        [toText = std::move(toText)](float value, int) { return toText(value); });
+}
+
+// The saved state is a header and a list of sections, all little-endian:
+// "MXSC", the format version and the size of the whole state in bytes,
+// then for every section a tag, the size of its contents and the contents.
+// Readers skip the sections they don't know, so later versions can add
+// some. Version 1 was the bare array of parameter values, without a header.
+const int kStateMagic = int(juce::ByteOrder::littleEndianInt("MXSC"));
+constexpr int kStateVersion = 2;
+constexpr int kStateHeaderSize = 12;
+constexpr int kSectionHeaderSize = 8;
+
+// The number of parameters and their values. Selection parameters are
+// saved as the choice rather than as Mexoscope keeps them, the choice over
+// the number of choices, which changes when one is added.
+const int kParametersTag = int(juce::ByteOrder::littleEndianInt("PRMS"));
+
+// The frame that was on screen, if it wasn't empty: the width and height
+// it was made for, two readings per column and the overs of every column.
+const int kFrameTag = int(juce::ByteOrder::littleEndianInt("FRAM"));
+constexpr int kFrameSectionSize = 8 + OSC_WIDTH * 2 * int(sizeof(int16_t)) + OSC_WIDTH;
+
+// The parameters of the original plug-in, which had four trigger modes.
+constexpr int kOriginalNumParams = 10;
+constexpr int kOriginalNumTriggerTypes = 4;
+
+// A choice from the value Mexoscope keeps for a selection parameter with
+// `numChoices` choices, and back.
+int toChoice(float scopeValue, int numChoices)
+{
+    return juce::jlimit(0, numChoices - 1, int(scopeValue * float(numChoices) + 0.0001f));
+}
+
+float fromChoice(float choice, int numChoices)
+{
+    if (!std::isfinite(choice)) {
+        return 0.0f;
+    }
+    return std::round(juce::jlimit(0.0f, float(numChoices - 1), choice)) / float(numChoices);
+}
+}
 
 MexoscopeAudioProcessor::MexoscopeAudioProcessor()
     : AudioProcessor(BusesProperties().withInput("Input", juce::AudioChannelSet::stereo(), true)
-                                      .withOutput("Output", juce::AudioChannelSet::stereo(), true))
+                                      .withOutput("Output", juce::AudioChannelSet::stereo(), true)
+                                      .withInput("Sidechain", juce::AudioChannelSet::stereo(), false))
 {
+    // These must be added in the same order as the Mexoscope::kXXX enum,
+    // so that the host's parameter index is the same as Mexoscope's.
+    // The text formulas are the same as for the knobs in the editor.
+    const juce::NormalisableRange<float> unitRange(0.0f, 1.0f);
+
+    parameters[Mexoscope::kTriggerSpeed] = new juce::AudioParameterFloat(
+        juce::ParameterID("triggerSpeed", 1), "Internal Trigger Speed", unitRange, 0.5f,
+        withText([this](float v) {
+            if (int(mexoscope.getParameter(Mexoscope::kTriggerType) * float(Mexoscope::kNumTriggerTypes) + 0.0001f)
+                == Mexoscope::kTriggerTempo) {
+                return juce::String(Mexoscope::getTempoDivisionName(Mexoscope::getTempoDivisionIndex(v)));
+            }
+            return formatMetric(std::pow(10.0, v * 2.5 - 5.0) * getSampleRate()) + " Hz";
+        }));
+
+    parameters[Mexoscope::kTriggerType] = new juce::AudioParameterChoice(
+        juce::ParameterID("triggerType", 1), "Trigger Mode",
+        juce::StringArray { "Free", "Rising", "Falling", "Internal", "External", "Tempo" }, 0);
+
+    parameters[Mexoscope::kTriggerLevel] = new juce::AudioParameterFloat(
+        juce::ParameterID("triggerLevel", 1), "Trigger Level", unitRange, 0.5f,
+        withText([](float v) { return juce::String(v * 2.0f - 1.0f, 3); }));
+
+    parameters[Mexoscope::kTriggerLimit] = new juce::AudioParameterFloat(
+        juce::ParameterID("triggerLimit", 1), "Retrigger Threshold", unitRange, 0.5f,
+        withText([](float v) { return formatMetric(std::pow(10.0, v * 4.0)) + " smp"; }));
+
+    parameters[Mexoscope::kTimeWindow] = new juce::AudioParameterFloat(
+        juce::ParameterID("timeWindow", 1), "Time", unitRange, 0.75f,
+        withText([](float v) { return formatMetric(std::pow(10.0, 1.5 - v * 5.0)) + " px/smp"; }));
+
+    parameters[Mexoscope::kAmpWindow] = new juce::AudioParameterFloat(
+        juce::ParameterID("ampWindow", 1), "Amp", unitRange, 0.5f,
+        withText([](float v) { return formatMetric(std::pow(10.0, v * 6.0 - 3.0)) + "x"; }));
+
+    parameters[Mexoscope::kSyncDraw] = new juce::AudioParameterBool(juce::ParameterID("syncDraw", 1), "Sync Redraw", false);
+    parameters[Mexoscope::kChannel] = new juce::AudioParameterBool(juce::ParameterID("channel", 1), "Right Channel", false);
+    parameters[Mexoscope::kFreeze] = new juce::AudioParameterBool(juce::ParameterID("freeze", 1), "Freeze", false);
+    parameters[Mexoscope::kDCKill] = new juce::AudioParameterBool(juce::ParameterID("dcKill", 1), "DC-Kill", false);
+
+    parameters[Mexoscope::kTriggerFilter] = new juce::AudioParameterChoice(
+        juce::ParameterID("triggerFilter", 1), "Trigger Filter",
+        juce::StringArray { "Off", "High-pass", "Low-pass", "Band-pass" }, 0);
+
+    parameters[Mexoscope::kTriggerFreq] = new juce::AudioParameterFloat(
+        juce::ParameterID("triggerFreq", 1), "Trigger Filter Frequency", unitRange, 0.5f,
+        withText([](float v) { return formatMetric(20.0 * std::pow(1000.0, double(v))) + " Hz"; }));
+
+    parameters[Mexoscope::kTriggerHyst] = new juce::AudioParameterFloat(
+        juce::ParameterID("triggerHyst", 1), "Trigger Hysteresis", unitRange, 0.0f,
+        withText([](float v) { return juce::String(v * 0.5f, 3); }));
+
+    parameters[Mexoscope::kMathChannel] = new juce::AudioParameterChoice(
+        juce::ParameterID("mathChannel", 1), "Math Channel",
+        juce::StringArray { "Off", "L+R", "L-R", "Mid", "Side", "L*R" }, 0);
+
+    parameters[Mexoscope::kChannelTrim] = new juce::AudioParameterFloat(
+        juce::ParameterID("channelTrim", 1), "Channel Trim", unitRange, 0.5f,
+        withText([](float v) { return juce::String(v * 48.0f - 24.0f, 1) + " dB"; }));
+
+    parameters[Mexoscope::kChannelOffset] = new juce::AudioParameterFloat(
+        juce::ParameterID("channelOffset", 1), "Channel Offset", unitRange, 0.5f,
+        withText([](float v) { return juce::String(v * 2.0f - 1.0f, 3); }));
+
+    parameters[Mexoscope::kTruePeak] = new juce::AudioParameterChoice(
+        juce::ParameterID("truePeak", 1), "True Peak",
+        juce::StringArray { "Off", "4x", "8x" }, 0);
+
+    for (auto* parameter : parameters) {
+        addParameter(parameter);
+        parameter->addListener(this);
+    }
 }
 
 MexoscopeAudioProcessor::~MexoscopeAudioProcessor()
 {
+    for (auto* parameter : parameters) {
+        parameter->removeListener(this);
+    }
+}
+
+float MexoscopeAudioProcessor::toScopeValue(int index, float normalisedValue) const
+{
+    if (const int numChoices = Mexoscope::getNumChoices(index); numChoices > 0) {
+        const float choice = std::round(parameters[size_t(index)]->convertFrom0to1(normalisedValue));
+        return choice / float(numChoices);
+    }
+    return normalisedValue;
+}
+
+float MexoscopeAudioProcessor::toNormalisedValue(int index, float scopeValue) const
+{
+    if (const int numChoices = Mexoscope::getNumChoices(index); numChoices > 0) {
+        return parameters[size_t(index)]->convertTo0to1(float(toChoice(scopeValue, numChoices)));
+    }
+    return scopeValue;
+}
+
+void MexoscopeAudioProcessor::parameterValueChanged(int parameterIndex, float newValue)
+{
+    // This can be called on the audio thread, the message thread, or some
+    // other host thread. Mexoscope queues the change for the audio thread.
+    if (juce::isPositiveAndBelow(parameterIndex, int(Mexoscope::kNumParams))) {
+        mexoscope.setParameter(parameterIndex, toScopeValue(parameterIndex, newValue));
+    }
 }
 
 const juce::String MexoscopeAudioProcessor::getName() const
@@ -62,6 +217,14 @@ void MexoscopeAudioProcessor::changeProgramName(int, const juce::String&)
 void MexoscopeAudioProcessor::prepareToPlay(double sampleRate, int)
 {
     mexoscope.prepareToPlay(sampleRate);
+    loudnessMeter.prepare(sampleRate);
+    streamMonitor.prepare(sampleRate);
+    exporter.setSampleRate(sampleRate);
+    lastExportedFrame = mexoscope.getTriggerCount();
+
+#if MEXOSCOPE_INSTRUMENTATION
+    instrumentation::calibrate();
+#endif
 }
 
 void MexoscopeAudioProcessor::releaseResources()
@@ -77,20 +240,161 @@ bool MexoscopeAudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts)
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet()) {
         return false;
     }
+
+    // The sidechain is optional, and can be mono or stereo.
+    if (layouts.inputBuses.size() > 1) {
+        const auto sidechain = layouts.getChannelSet(true, 1);
+        if (!sidechain.isDisabled()
+        &&  sidechain != juce::AudioChannelSet::mono()
+        &&  sidechain != juce::AudioChannelSet::stereo()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MexoscopeAudioProcessor::supportsDoublePrecisionProcessing() const
+{
     return true;
 }
 
 void MexoscopeAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
+{
+    processSamples(buffer);
+}
+
+void MexoscopeAudioProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer&)
+{
+    processSamples(buffer);
+}
+
+template <typename SampleType>
+void MexoscopeAudioProcessor::processSamples(juce::AudioBuffer<SampleType>& buffer)
 {
     juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
+    MEXOSCOPE_AUDIO_CALLBACK;
+    MEXOSCOPE_PROBE_BLOCK(blockProbe, buffer.getNumSamples(), getSampleRate());
+    const tracing::ScopedSpan span(tracer, tracing::EventType::BlockProcessed, buffer.getNumSamples());
+
+    auto mainNumInputChannels   = getMainBusNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
-    for (int i = totalNumInputChannels; i < totalNumOutputChannels; ++i) {
+    for (int i = mainNumInputChannels; i < totalNumOutputChannels; ++i) {
         buffer.clear(i, 0, buffer.getNumSamples());
     }
 
-    mexoscope.process(buffer);
+    // Timestamps for the segmented memory. Only a playing transport moves.
+    // The Tempo trigger needs the musical position and the tempo as well;
+    // without them it doesn't fire.
+    Mexoscope::HostTempo tempo;
+    juce::int64 hostTime = -1;
+    if (auto* playHead = getPlayHead()) {
+        if (const auto position = playHead->getPosition(); position.hasValue() && position->getIsPlaying()) {
+            if (const auto time = position->getTimeInSamples(); time.hasValue()) {
+                mexoscope.setHostPosition(*time);
+                hostTime = *time;
+            }
+
+            const auto ppq = position->getPpqPosition();
+            const auto bpm = position->getBpm();
+            if (ppq.hasValue() && bpm.hasValue() && *bpm > 0.0) {
+                tempo.playing = true;
+                tempo.position = *ppq;
+                tempo.perSample = *bpm / (60.0 * getSampleRate());
+                tempo.barStart = position->getPpqPositionOfLastBarStart().orFallback(0.0);
+                if (const auto signature = position->getTimeSignature(); signature.hasValue() && signature->denominator > 0) {
+                    tempo.quarterNotesPerBar = double(signature->numerator) * 4.0 / double(signature->denominator);
+                }
+            }
+        }
+    }
+    mexoscope.setHostTempo(tempo);
+
+    // Both of these point into the host's buffer, nothing is copied.
+    auto mainInput = getBusBuffer(buffer, true, 0);
+    const auto triggersBefore = mexoscope.getTriggerCount();
+
+    if (getBusCount(true) > 1 && getChannelCountOfBus(true, 1) > 0) {
+        auto sidechain = getBusBuffer(buffer, true, 1);
+        mexoscope.process(mainInput, &sidechain);
+    } else {
+        mexoscope.process(mainInput);
+    }
+    loudnessMeter.process(mainInput);
+    streamMonitor.process(mainInput, hostTime);
+
+    // Export the raw input first, so the frame's sample position includes
+    // the block that completed it.
+    exporter.writeSamples(mainInput);
+    if (mexoscope.getTriggerCount() != lastExportedFrame) {
+        lastExportedFrame = mexoscope.getTriggerCount();
+        exporter.writeFrame(mexoscope.getCopy());
+        if (exporter.isOpen()) {
+            tracer.recordInstant(tracing::EventType::FramePublished, juce::int64(lastExportedFrame));
+        }
+    }
+    exporter.writeMaskResults(mexoscope.getMaskTest().getResults());
+    exporter.writeTriggerStats(mexoscope.getTriggerLog().getNumAccepted(), mexoscope.getTriggerLog().getNumRejected(),
+                               triggerStatistics.getPeriodMean(), triggerStatistics.getPeriodStdDev());
+
+    if (mexoscope.getTriggerCount() != triggersBefore) {
+        tracer.recordInstant(tracing::EventType::TriggerFired, juce::int64(mexoscope.getTriggerCount() - triggersBefore));
+    }
+}
+
+bool MexoscopeAudioProcessor::setExportEnabled(bool shouldBeEnabled)
+{
+    if (!shouldBeEnabled) {
+        exporter.close();
+        exportConsumer.reset();
+        return true;
+    }
+
+    if (exporter.isOpen()) {
+        return true;
+    }
+
+    if (!exporter.open(juce::jmax(1, getMainBusNumInputChannels()), getSampleRate())) {
+        return false;
+    }
+
+    // The export needs frames even when the editor is closed.
+    exportConsumer.emplace(mexoscope);
+    return true;
+}
+
+bool MexoscopeAudioProcessor::startSegments(int numSegments, int segmentLength)
+{
+    if (!mexoscope.getSegments().start(numSegments, segmentLength)) {
+        segmentConsumer.reset();
+        return false;
+    }
+
+    segmentConsumer.emplace(mexoscope);
+    return true;
+}
+
+void MexoscopeAudioProcessor::stopSegments()
+{
+    mexoscope.getSegments().stop();
+    segmentConsumer.reset();
+}
+
+bool MexoscopeAudioProcessor::startMaskTest(const MaskTest::Mask& mask)
+{
+    if (!mexoscope.getMaskTest().start(mask)) {
+        maskConsumer.reset();
+        return false;
+    }
+
+    maskConsumer.emplace(mexoscope);
+    return true;
+}
+
+void MexoscopeAudioProcessor::stopMaskTest()
+{
+    mexoscope.getMaskTest().clear();
+    maskConsumer.reset();
 }
 
 bool MexoscopeAudioProcessor::hasEditor() const
@@ -105,13 +409,128 @@ juce::AudioProcessorEditor* MexoscopeAudioProcessor::createEditor()
 
 void MexoscopeAudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    destData.setSize(mexoscope.getSaveBlockSize());
-    destData.copyFrom(mexoscope.getSaveBlock(), 0, mexoscope.getSaveBlockSize());
+    // The frame that's on screen, so the editor can show it right away when
+    // the session is opened again. Like the display, this may catch the
+    // audio thread in the middle of a frame. A flat line isn't worth saving.
+    const bool syncDraw = (mexoscope.getParameter(Mexoscope::kSyncDraw) > 0.5f);
+    const auto& frame = syncDraw ? mexoscope.getCopy() : mexoscope.getPeaks();
+    const auto& frameOvers = syncDraw ? mexoscope.getOversCopy() : mexoscope.getOvers();
+    const bool hasFrame = std::any_of(frame.begin(), frame.end(), [](const auto& point) { return point.y != OSC_CENTER; });
+
+    const int parametersSize = 4 + Mexoscope::kNumParams * int(sizeof(float));
+    const int totalSize = kStateHeaderSize + kSectionHeaderSize + parametersSize
+                          + (hasFrame ? kSectionHeaderSize + kFrameSectionSize : 0);
+
+    juce::MemoryOutputStream stream(destData, false);
+    stream.preallocate(size_t(totalSize));
+    stream.writeInt(kStateMagic);
+    stream.writeInt(kStateVersion);
+    stream.writeInt(totalSize);
+
+    stream.writeInt(kParametersTag);
+    stream.writeInt(parametersSize);
+    stream.writeInt(Mexoscope::kNumParams);
+    for (int i = 0; i < Mexoscope::kNumParams; ++i) {
+        const float value = mexoscope.getParameter(i);
+        const int numChoices = Mexoscope::getNumChoices(i);
+        stream.writeFloat(numChoices > 0 ? float(toChoice(value, numChoices)) : value);
+    }
+
+    if (hasFrame) {
+        stream.writeInt(kFrameTag);
+        stream.writeInt(kFrameSectionSize);
+        stream.writeInt(OSC_WIDTH);
+        stream.writeInt(OSC_HEIGHT);
+        for (const auto& point : frame) {
+            stream.writeShort(short(point.y));
+        }
+        stream.write(frameOvers.data(), frameOvers.size());
+    }
+
+    jassert(stream.getDataSize() == size_t(totalSize));
 }
 
-void MexoscopeAudioProcessor::setStateInformation(const void* data, int)
+void MexoscopeAudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    std::memcpy(mexoscope.getSaveBlock(), data, mexoscope.getSaveBlockSize());
+    if (data == nullptr || sizeInBytes <= 0) {
+        return;
+    }
+
+    float values[Mexoscope::kNumParams];
+    int numValues = 0;
+    Mexoscope::PeaksArray frame;
+    Mexoscope::OversArray frameOvers {};
+    bool hasFrame = false;
+
+    juce::MemoryInputStream stream(data, size_t(sizeInBytes), false);
+    if (sizeInBytes < kStateHeaderSize || stream.readInt() != kStateMagic) {
+        // Version 1. Older versions saved fewer parameters, those keep
+        // their defaults.
+        numValues = juce::jmin(int(Mexoscope::kNumParams), sizeInBytes / int(sizeof(float)));
+        std::memcpy(values, data, size_t(numValues) * sizeof(float));
+
+        // The trigger mode was saved over the number of modes at the time.
+        // The original plug-in had four; the first version with External,
+        // which saved as many parameters, had five, and no mode but Free
+        // is then a multiple of a quarter. Later versions had five or six,
+        // and five read the same as six.
+        if (numValues > Mexoscope::kTriggerType && numValues <= kOriginalNumParams) {
+            const float choice = values[Mexoscope::kTriggerType] * float(kOriginalNumTriggerTypes);
+            if (std::abs(choice - std::round(choice)) < 0.001f) {
+                values[Mexoscope::kTriggerType] = fromChoice(choice, Mexoscope::kNumTriggerTypes);
+            }
+        }
+    } else {
+        // A state that was cut short is left alone rather than half
+        // restored.
+        const int version = stream.readInt();
+        const int totalSize = stream.readInt();
+        if (version < 2 || totalSize != sizeInBytes) {
+            return;
+        }
+
+        while (stream.getNumBytesRemaining() >= kSectionHeaderSize) {
+            const int tag = stream.readInt();
+            const int size = stream.readInt();
+            if (size < 0 || size > stream.getNumBytesRemaining()) {
+                return;
+            }
+            const auto next = stream.getPosition() + size;
+
+            if (tag == kParametersTag && size >= 4) {
+                // Newer versions may have more parameters, older ones fewer.
+                const int count = stream.readInt();
+                numValues = juce::jlimit(0, int(Mexoscope::kNumParams), juce::jmin(count, (size - 4) / int(sizeof(float))));
+                for (int i = 0; i < numValues; ++i) {
+                    values[i] = stream.readFloat();
+                    if (const int numChoices = Mexoscope::getNumChoices(i); numChoices > 0) {
+                        values[i] = fromChoice(values[i], numChoices);
+                    }
+                }
+            } else if (tag == kFrameTag && size == kFrameSectionSize && stream.readInt() == OSC_WIDTH
+                       && stream.readInt() == OSC_HEIGHT) {
+                for (auto& point : frame) {
+                    point.y = juce::jlimit(0, OSC_HEIGHT - 1, int(stream.readShort()));
+                }
+                stream.read(frameOvers.data(), int(frameOvers.size()));
+                hasFrame = true;
+            }
+
+            stream.setPosition(next);
+        }
+    }
+
+    // The frame only goes in while nothing captures, as when a session is
+    // opened. With the editor open, it shows the live frames anyway.
+    if (hasFrame) {
+        mexoscope.restoreFrame(frame, frameOvers);
+    }
+
+    // Go through the host parameters so the host and the editor see the
+    // restored values too. The listener passes them on to Mexoscope.
+    for (int i = 0; i < numValues; ++i) {
+        parameters[size_t(i)]->setValueNotifyingHost(toNormalisedValue(i, values[i]));
+    }
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
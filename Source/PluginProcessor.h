@@ -1,9 +1,17 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <optional>
+#include "LoudnessMeter.h"
 #include "Mexoscope.h"
+#include "SharedMemoryExporter.h"
+#include "SignalAverager.h"
+#include "StreamMonitor.h"
+#include "Tracing.h"
+#include "TriggerStatistics.h"
 
-class MexoscopeAudioProcessor : public juce::AudioProcessor
+class MexoscopeAudioProcessor : public juce::AudioProcessor,
+                                private juce::AudioProcessorParameter::Listener
 {
 public:
     MexoscopeAudioProcessor();
@@ -14,6 +22,8 @@ public:
     bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
 
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -34,8 +44,83 @@ public:
     void getStateInformation(juce::MemoryBlock& destData) override;
     void setStateInformation(const void* data, int sizeInBytes) override;
 
+    // The host-visible parameter for one of the Mexoscope::kXXX indices.
+    juce::RangedAudioParameter& getScopeParameter(int index) const { return *parameters[size_t(index)]; }
+
+    // Turns the shared-memory export on or off. Message thread only.
+    bool setExportEnabled(bool shouldBeEnabled);
+    bool isExportEnabled() const { return exporter.isOpen(); }
+    const juce::String& getExportName() const { return exporter.getName(); }
+
+    // Segmented memory, see SegmentPool.h. Recording keeps the capture
+    // running while the editor is closed. Message thread only.
+    bool startSegments(int numSegments, int segmentLength);
+    void stopSegments();
+
+    // Mask testing, see MaskTest.h. Like the segments, testing carries on
+    // while the editor is closed. Message thread only.
+    bool startMaskTest(const MaskTest::Mask& mask);
+    void stopMaskTest();
+
+    // Triggered signal averaging, see SignalAverager.h. Kept here so the
+    // average survives closing the editor.
+    SignalAverager& getAverager() { return averager; }
+
+    // Trigger rate, period and jitter, see TriggerStatistics.h.
+    TriggerStatistics& getTriggerStatistics() { return triggerStatistics; }
+
+    // Loudness and true-peak metering of the main input, see
+    // LoudnessMeter.h. It runs while it's enabled, editor or not.
+    LoudnessMeter& getLoudnessMeter() { return loudnessMeter; }
+
+    // NaN, denormals, clicks, dropouts and the like in the main input, see
+    // StreamMonitor.h. Always on.
+    StreamMonitor& getStreamMonitor() { return streamMonitor; }
+
+    // Timeline tracing, see Tracing.h. Start and stop it from the message thread.
+    tracing::Tracer& getTracer() { return tracer; }
+
+#if MEXOSCOPE_INSTRUMENTATION
+    // Time spent in the whole audio callback, including the export.
+    instrumentation::PerfProbe& getBlockProbe() { return blockProbe; }
+#endif
+
     Mexoscope mexoscope;
 
 private:
+    // Shared by the float and double versions of processBlock.
+    template <typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer);
+
+    void parameterValueChanged(int parameterIndex, float newValue) override;
+    void parameterGestureChanged(int, bool) override {}
+
+    // Mexoscope stores every parameter as a 0-1 float. This is the same as
+    // the normalised host value, except for the trigger type, which is a
+    // choice parameter for the host.
+    float toScopeValue(int index, float normalisedValue) const;
+    float toNormalisedValue(int index, float scopeValue) const;
+
+    // Indexed by Mexoscope::kXXX. Owned by the AudioProcessor.
+    std::array<juce::RangedAudioParameter*, Mexoscope::kNumParams> parameters {};
+
+    SharedMemoryExporter exporter;
+    std::optional<Mexoscope::ScopedConsumer> exportConsumer;
+    uint64_t lastExportedFrame = 0;
+
+    SignalAverager averager { mexoscope };
+    std::optional<Mexoscope::ScopedConsumer> segmentConsumer;
+    std::optional<Mexoscope::ScopedConsumer> maskConsumer;
+
+    TriggerStatistics triggerStatistics { mexoscope };
+    LoudnessMeter loudnessMeter;
+    StreamMonitor streamMonitor;
+
+    tracing::Tracer tracer;
+
+#if MEXOSCOPE_INSTRUMENTATION
+    instrumentation::PerfProbe blockProbe;
+#endif
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MexoscopeAudioProcessor)
 };
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/*
+  Debug checks for the real-time contract. The audio callback marks the
+  thread it runs on, and everything that allocates, locks or does file I/O
+  by design asserts that it isn't called from there. A host (or a future
+  change) that calls one of those from inside the callback then stops in
+  the debugger instead of crackling now and then.
+
+  On by default in debug builds. Nothing is compiled in release builds.
+*/
+#ifndef MEXOSCOPE_REALTIME_CHECKS
+ #define MEXOSCOPE_REALTIME_CHECKS JUCE_DEBUG
+#endif
+
+#if MEXOSCOPE_REALTIME_CHECKS
+
+namespace realtime {
+
+// How many audio callbacks the calling thread is inside of. More than one
+// if a host nests plug-in instances.
+inline int& audioCallbackDepth() noexcept
+{
+    static thread_local int depth = 0;
+    return depth;
+}
+
+inline bool isInAudioCallback() noexcept
+{
+    return audioCallbackDepth() > 0;
+}
+
+class ScopedAudioCallback
+{
+public:
+    ScopedAudioCallback() noexcept { ++audioCallbackDepth(); }
+    ~ScopedAudioCallback() { --audioCallbackDepth(); }
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedAudioCallback)
+};
+
+}  // namespace realtime
+
+ #define MEXOSCOPE_AUDIO_CALLBACK \
+    const realtime::ScopedAudioCallback JUCE_JOIN_MACRO(audioCallback_, __LINE__)
+ #define MEXOSCOPE_ASSERT_NOT_REALTIME jassert(!realtime::isInAudioCallback())
+
+#else
+
+ #define MEXOSCOPE_AUDIO_CALLBACK
+ #define MEXOSCOPE_ASSERT_NOT_REALTIME
+
+#endif
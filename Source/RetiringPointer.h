@@ -0,0 +1,77 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <thread>
+
+/*
+  A pointer that the message thread publishes and takes back again, while
+  other threads, the audio thread among them, use what it points to
+  through a Reader. `retire` clears the pointer and waits until no Reader
+  that loaded it before then is left, so the caller can free it right
+  after.
+
+  A Reader counts itself in before it loads the pointer, and `retire`
+  clears the pointer before it looks at the count. Both are sequentially
+  consistent, so either the Reader sees nullptr or `retire` sees it and
+  waits. Readers only hold on for a block or a call, so the wait is short,
+  but `retire` mustn't be called from the audio thread.
+*/
+template <typename T>
+class RetiringPointer
+{
+public:
+    class Reader
+    {
+    public:
+        explicit Reader(const RetiringPointer& p) : owner(p)
+        {
+            owner.numReaders.fetch_add(1);
+            pointer = owner.pointer.load();
+        }
+
+        ~Reader() { owner.numReaders.fetch_sub(1, std::memory_order_release); }
+
+        // nullptr if nothing was published.
+        T* get() const noexcept { return pointer; }
+
+    private:
+        const RetiringPointer& owner;
+        T* pointer;
+
+        JUCE_DECLARE_NON_COPYABLE(Reader)
+    };
+
+    RetiringPointer() = default;
+
+    // Only safe to dereference on the thread that publishes and retires.
+    // Elsewhere, only whether it's nullptr can be relied on.
+    T* get(std::memory_order order = std::memory_order_seq_cst) const noexcept { return pointer.load(order); }
+
+    // Makes `object` available to Readers. The one before must have been
+    // retired.
+    void publish(T* object) noexcept
+    {
+        jassert(pointer.load() == nullptr);
+        pointer.store(object);
+    }
+
+    // Clears the pointer and returns what it pointed to once no Reader has
+    // it any more, or nullptr if nothing was published.
+    T* retire() noexcept
+    {
+        auto* old = pointer.exchange(nullptr);
+        if (old != nullptr) {
+            while (numReaders.load() > 0) {
+                std::this_thread::yield();
+            }
+        }
+        return old;
+    }
+
+private:
+    std::atomic<T*> pointer { nullptr };
+    mutable std::atomic<int> numReaders { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(RetiringPointer)
+};
@@ -0,0 +1,233 @@
+#include "SampleHistory.h"
+#include "RealtimeCheck.h"
+#include <algorithm>
+#include <limits>
+#include <new>
+
+namespace {
+constexpr juce::int64 kBlockSize = 1 << SampleHistory::kBlockLog2;
+
+// The writer only publishes its position after every write, so the samples
+// just past it may already be overwritten. Stay this far away from those.
+constexpr juce::int64 kMargin = 4096;
+
+constexpr int blockLog2(int level)
+{
+    return SampleHistory::kBlockLog2 * (level + 1);
+}
+}
+
+struct SampleHistory::Storage
+{
+    std::vector<float> samples;
+
+    // The smallest and largest sample of every block, per level.
+    std::array<std::vector<float>, kNumLevels> minimum;
+    std::array<std::vector<float>, kNumLevels> maximum;
+
+    // Position of the first sample written into this ring, or -1 before
+    // anything was written.
+    std::atomic<juce::int64> firstPosition { -1 };
+};
+
+SampleHistory::~SampleHistory()
+{
+    clear();
+}
+
+bool SampleHistory::start()
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    clear();
+
+    auto newStorage = std::make_unique<Storage>();
+    try {
+        newStorage->samples.resize(size_t(kCapacity));
+        for (int level = 0; level < kNumLevels; ++level) {
+            newStorage->minimum[size_t(level)].resize(size_t(kCapacity >> blockLog2(level)));
+            newStorage->maximum[size_t(level)].resize(size_t(kCapacity >> blockLog2(level)));
+        }
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+
+    storage.publish(newStorage.release());
+    return true;
+}
+
+void SampleHistory::clear()
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    delete storage.retire();
+}
+
+bool SampleHistory::isAvailable(const Storage& current, juce::int64 begin, juce::int64 end) const
+{
+    const auto first = current.firstPosition.load(std::memory_order_acquire);
+    const auto written = position.load(std::memory_order_acquire);
+    return first >= 0 && begin >= first && begin < end && end <= written
+        && begin >= written - (kCapacity - kMargin);
+}
+
+bool SampleHistory::getSample(juce::int64 samplePosition, float& value) const
+{
+    const RetiringPointer<Storage>::Reader reader(storage);
+    const auto* current = reader.get();
+    if (current == nullptr || !isAvailable(*current, samplePosition, samplePosition + 1)) {
+        return false;
+    }
+
+    value = current->samples[size_t(samplePosition & (kCapacity - 1))];
+
+    // Check again, in case the writer went past it while we were reading.
+    return isAvailable(*current, samplePosition, samplePosition + 1);
+}
+
+bool SampleHistory::read(juce::int64 begin, int numSamples, float* destination) const
+{
+    const RetiringPointer<Storage>::Reader reader(storage);
+    const auto* current = reader.get();
+    if (current == nullptr || !isAvailable(*current, begin, begin + numSamples)) {
+        return false;
+    }
+
+    // At most two pieces, when it wraps around the end of the ring.
+    const int offset = int(begin & (kCapacity - 1));
+    const int first = juce::jmin(numSamples, kCapacity - offset);
+    std::copy_n(current->samples.data() + offset, first, destination);
+    std::copy_n(current->samples.data(), numSamples - first, destination + first);
+
+    // Check again, in case the writer went past it while we were reading.
+    return isAvailable(*current, begin, begin + numSamples);
+}
+
+bool SampleHistory::findExtremes(juce::int64 begin, juce::int64 end, Extremes& extremes) const
+{
+    const RetiringPointer<Storage>::Reader reader(storage);
+    const auto* current = reader.get();
+    if (current == nullptr || !isAvailable(*current, begin, end)) {
+        return false;
+    }
+
+    // Walk from `begin` to `end` in the largest whole blocks that fit,
+    // remembering which block held the extremes. Level -1 is a sample.
+    struct Found
+    {
+        float value;
+        int level;
+        juce::int64 start;
+    };
+    Found lowest { std::numeric_limits<float>::max(), -1, begin };
+    Found highest { std::numeric_limits<float>::lowest(), -1, begin };
+
+    for (auto at = begin; at < end;) {
+        int level = kNumLevels - 1;
+        while (level >= 0 && ((at & ((juce::int64(1) << blockLog2(level)) - 1)) != 0
+                              || at + (juce::int64(1) << blockLog2(level)) > end)) {
+            --level;
+        }
+
+        float lo, hi;
+        if (level < 0) {
+            lo = hi = current->samples[size_t(at & (kCapacity - 1))];
+        } else {
+            const auto entry = size_t((at >> blockLog2(level)) & ((kCapacity >> blockLog2(level)) - 1));
+            lo = current->minimum[size_t(level)][entry];
+            hi = current->maximum[size_t(level)][entry];
+        }
+
+        if (lo < lowest.value) {
+            lowest = { lo, level, at };
+        }
+        if (hi > highest.value) {
+            highest = { hi, level, at };
+        }
+        at += (level < 0) ? 1 : (juce::int64(1) << blockLog2(level));
+    }
+
+    // Go down from the block to the sample that holds the value.
+    const auto locate = [current](Found found, bool isMinimum) {
+        auto at = found.start;
+        for (int level = found.level - 1; level >= -1; --level) {
+            const auto step = (level < 0) ? juce::int64(1) : (juce::int64(1) << blockLog2(level));
+            for (int child = 0; child < int(kBlockSize) - 1; ++child, at += step) {
+                float value;
+                if (level < 0) {
+                    value = current->samples[size_t(at & (kCapacity - 1))];
+                } else {
+                    const auto entry = size_t((at >> blockLog2(level)) & ((kCapacity >> blockLog2(level)) - 1));
+                    value = isMinimum ? current->minimum[size_t(level)][entry] : current->maximum[size_t(level)][entry];
+                }
+                if (value == found.value) {
+                    break;
+                }
+            }
+        }
+        return at;
+    };
+
+    extremes.minimum = lowest.value;
+    extremes.maximum = highest.value;
+    extremes.minimumPosition = locate(lowest, true);
+    extremes.maximumPosition = locate(highest, false);
+
+    // Check again, in case the writer went past it while we were reading.
+    return isAvailable(*current, begin, end);
+}
+
+SampleHistory::Writer::Writer(SampleHistory& h) : history(h), reader(h.storage), storage(reader.get())
+{
+}
+
+void SampleHistory::Writer::write(const float* samples, int numSamples) noexcept
+{
+    const auto start = history.position.load(std::memory_order_relaxed);
+
+    if (storage != nullptr) {
+        if (storage->firstPosition.load(std::memory_order_relaxed) < 0) {
+            storage->firstPosition.store(start, std::memory_order_release);
+        }
+
+        auto& firstMinimum = storage->minimum[0];
+        auto& firstMaximum = storage->maximum[0];
+
+        for (int i = 0; i < numSamples; ++i) {
+            const auto at = start + i;
+            const float x = samples[i];
+            storage->samples[size_t(at & (kCapacity - 1))] = x;
+
+            // The first level follows every sample. The levels above only
+            // take in a block when it's complete, so the levels only ever
+            // hold partial blocks at the end, which the reader never uses.
+            const auto entry = size_t((at >> kBlockLog2) & ((kCapacity >> kBlockLog2) - 1));
+            if ((at & (kBlockSize - 1)) == 0) {
+                firstMinimum[entry] = firstMaximum[entry] = x;
+            } else {
+                firstMinimum[entry] = juce::jmin(firstMinimum[entry], x);
+                firstMaximum[entry] = juce::jmax(firstMaximum[entry], x);
+            }
+
+            for (int level = 1; level < kNumLevels; ++level) {
+                const auto childMask = (juce::int64(1) << blockLog2(level - 1)) - 1;
+                if ((at & childMask) != childMask) {
+                    break;
+                }
+
+                const auto child = size_t((at >> blockLog2(level - 1)) & ((kCapacity >> blockLog2(level - 1)) - 1));
+                const auto parent = size_t((at >> blockLog2(level)) & ((kCapacity >> blockLog2(level)) - 1));
+                const float lo = storage->minimum[size_t(level - 1)][child];
+                const float hi = storage->maximum[size_t(level - 1)][child];
+
+                if (((at >> blockLog2(level - 1)) & (kBlockSize - 1)) == 0) {
+                    storage->minimum[size_t(level)][parent] = lo;
+                    storage->maximum[size_t(level)][parent] = hi;
+                } else {
+                    storage->minimum[size_t(level)][parent] = juce::jmin(storage->minimum[size_t(level)][parent], lo);
+                    storage->maximum[size_t(level)][parent] = juce::jmax(storage->maximum[size_t(level)][parent], hi);
+                }
+            }
+        }
+    }
+
+    history.position.store(start + numSamples, std::memory_order_release);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "RetiringPointer.h"
+
+/*
+  The raw samples behind the frames on screen, so the cursor can read out
+  exact sample values instead of working them back from pixels. The audio
+  thread writes every captured sample of the displayed channel into a ring,
+  before the Amp gain like the sweeps and segments. Samples are addressed by
+  their position in the stream of captured samples, which only ever counts
+  up, so a position stays valid until the ring wraps around and overwrites
+  it. The ring holds a full screen at the slowest Time setting.
+
+  Next to the ring there's a min/max pyramid: every level holds the smallest
+  and largest sample of blocks that are 16 times longer than the level
+  below. Finding the extremes of any stretch of samples only takes a few
+  steps per level, so the cursor can look at a whole column even when it
+  spans thousands of samples.
+
+  Like SegmentPool, the storage is allocated by `start` on the message thread
+  and the audio thread only writes into it through a Writer.
+*/
+class SampleHistory
+{
+private:
+    struct Storage;
+
+public:
+    static constexpr int kCapacityLog2 = 21;
+    static constexpr int kCapacity = 1 << kCapacityLog2;
+    static constexpr int kBlockLog2 = 4;
+    static constexpr int kNumLevels = 4;
+
+    struct Extremes
+    {
+        float minimum = 0.0f;
+        float maximum = 0.0f;
+        juce::int64 minimumPosition = 0;
+        juce::int64 maximumPosition = 0;
+    };
+
+    SampleHistory() = default;
+    ~SampleHistory();
+
+    // Message thread. Allocates the ring, which then fills up from the next
+    // block on. Returns false if there isn't enough memory.
+    bool start();
+
+    // Message thread. Frees the ring.
+    void clear();
+
+    // Message thread.
+    bool isActive() const { return storage.get() != nullptr; }
+
+    // Any thread but the audio thread. Read the samples at the given
+    // positions. These return false if the samples weren't written yet, or
+    // were overwritten since.
+    bool getSample(juce::int64 position, float& value) const;
+    bool read(juce::int64 begin, int numSamples, float* destination) const;
+    bool findExtremes(juce::int64 begin, juce::int64 end, Extremes& extremes) const;
+
+    // Audio thread. Holds on to the ring while writing into it. Without a
+    // ring, the position still counts up.
+    class Writer
+    {
+    public:
+        explicit Writer(SampleHistory& history);
+
+        // Position of the next sample that's written.
+        juce::int64 getPosition() const noexcept { return history.position.load(std::memory_order_relaxed); }
+
+        void write(const float* samples, int numSamples) noexcept;
+
+    private:
+        SampleHistory& history;
+        RetiringPointer<Storage>::Reader reader;
+        Storage* storage;
+
+        JUCE_DECLARE_NON_COPYABLE(Writer)
+    };
+
+private:
+    // Whether all samples in [begin, end) are in the ring right now.
+    bool isAvailable(const Storage& current, juce::int64 begin, juce::int64 end) const;
+
+    RetiringPointer<Storage> storage;
+
+    // Number of samples written so far. Only the audio thread writes it.
+    std::atomic<juce::int64> position { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleHistory)
+};
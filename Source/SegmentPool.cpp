@@ -0,0 +1,179 @@
+#include "SegmentPool.h"
+#include "RealtimeCheck.h"
+#include <cstring>
+#include <new>
+
+struct SegmentPool::Storage
+{
+    int numSegments = 0;
+    int segmentLength = 0;
+    std::vector<float> samples;
+    std::vector<juce::int64> timestamps;
+
+    // Segments below this index are complete and never change again.
+    std::atomic<int> numRecorded { 0 };
+    std::atomic<bool> recording { true };
+
+    // Audio thread only.
+    int remaining = 0;
+};
+
+SegmentPool::~SegmentPool()
+{
+    clear();
+}
+
+bool SegmentPool::start(int numSegments, int segmentLength)
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    clear();
+
+    auto newStorage = std::make_unique<Storage>();
+    newStorage->numSegments = juce::jmax(1, numSegments);
+    newStorage->segmentLength = juce::jmax(1, segmentLength);
+
+    try {
+        newStorage->samples.resize(size_t(newStorage->numSegments) * size_t(newStorage->segmentLength));
+        newStorage->timestamps.resize(size_t(newStorage->numSegments));
+    } catch (const std::bad_alloc&) {
+        return false;
+    }
+
+    storage.publish(newStorage.release());
+    return true;
+}
+
+void SegmentPool::stop()
+{
+    if (auto* current = storage.get()) {
+        current->recording.store(false);
+    }
+}
+
+void SegmentPool::clear()
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    delete storage.retire();
+}
+
+bool SegmentPool::isRecording() const
+{
+    const auto* current = storage.get();
+    return current != nullptr && current->recording.load()
+        && current->numRecorded.load() < current->numSegments;
+}
+
+int SegmentPool::getNumRecorded() const
+{
+    const auto* current = storage.get();
+    return current != nullptr ? current->numRecorded.load(std::memory_order_acquire) : 0;
+}
+
+int SegmentPool::getCapacity() const
+{
+    const auto* current = storage.get();
+    return current != nullptr ? current->numSegments : 0;
+}
+
+int SegmentPool::getSegmentLength() const
+{
+    const auto* current = storage.get();
+    return current != nullptr ? current->segmentLength : 0;
+}
+
+const float* SegmentPool::getSegment(int index) const
+{
+    const auto* current = storage.get();
+    jassert(current != nullptr && juce::isPositiveAndBelow(index, current->numRecorded.load()));
+    return current->samples.data() + size_t(index) * size_t(current->segmentLength);
+}
+
+juce::int64 SegmentPool::getTimestamp(int index) const
+{
+    const auto* current = storage.get();
+    jassert(current != nullptr && juce::isPositiveAndBelow(index, current->numRecorded.load()));
+    return current->timestamps[size_t(index)];
+}
+
+bool SegmentPool::exportTo(const juce::File& file, double sampleRate) const
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    const int numRecorded = getNumRecorded();
+    if (numRecorded == 0) {
+        return false;
+    }
+
+    file.deleteFile();
+    auto stream = std::make_unique<juce::FileOutputStream>(file);
+    if (!stream->openedOk()) {
+        return false;
+    }
+
+    juce::WavAudioFormat format;
+    std::unique_ptr<juce::AudioFormatWriter> writer(format.createWriterFor(stream.get(), sampleRate, 1, 32, {}, 0));
+    if (writer == nullptr) {
+        return false;
+    }
+    stream.release();  // the writer owns it now
+
+    const int length = getSegmentLength();
+    juce::String timestamps("segment,timestamp,offset\n");
+
+    for (int i = 0; i < numRecorded; ++i) {
+        const float* channels[] = { getSegment(i) };
+        if (!writer->writeFromFloatArrays(channels, 1, length)) {
+            return false;
+        }
+        timestamps << i << "," << getTimestamp(i) << "," << juce::int64(i) * length << "\n";
+    }
+
+    writer.reset();
+    return file.withFileExtension("csv").replaceWithText(timestamps);
+}
+
+SegmentPool::Writer::Writer(SegmentPool& p) : pool(p), reader(p.storage), storage(reader.get())
+{
+}
+
+bool SegmentPool::Writer::isRecording() const noexcept
+{
+    return storage != nullptr && storage->recording.load(std::memory_order_relaxed)
+        && storage->numRecorded.load(std::memory_order_relaxed) < storage->numSegments;
+}
+
+int SegmentPool::Writer::getRemaining() const noexcept
+{
+    return storage != nullptr ? storage->remaining : 0;
+}
+
+bool SegmentPool::Writer::begin(juce::int64 timestamp) noexcept
+{
+    const int index = storage->numRecorded.load(std::memory_order_relaxed);
+    if (index >= storage->numSegments) {
+        return false;
+    }
+
+    storage->timestamps[size_t(index)] = timestamp;
+    storage->remaining = storage->segmentLength;
+    return true;
+}
+
+void SegmentPool::Writer::write(const float* samples, int numSamples) noexcept
+{
+    const int index = storage->numRecorded.load(std::memory_order_relaxed);
+    const int position = storage->segmentLength - storage->remaining;
+    std::memcpy(storage->samples.data() + size_t(index) * size_t(storage->segmentLength) + size_t(position),
+                samples, size_t(numSamples) * sizeof(float));
+
+    storage->remaining -= numSamples;
+    if (storage->remaining == 0) {
+        storage->numRecorded.store(index + 1, std::memory_order_release);
+    }
+}
+
+void SegmentPool::Writer::cancel() noexcept
+{
+    if (storage != nullptr) {
+        storage->remaining = 0;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "RetiringPointer.h"
+
+/*
+  Segmented memory, as on hardware scopes: every trigger stores a short,
+  fixed-length segment of raw samples with the host's sample position, so a
+  rare glitch isn't overwritten by the next sweep. Recording stops when the
+  pool is full.
+
+  The pool is allocated by `start` on the message thread, at the size the
+  user asks for. The audio thread fills it through a Writer, which only
+  copies into memory that's already there. Finished segments never change
+  again, so the message thread can browse and export them while the audio
+  thread is still recording.
+*/
+class SegmentPool
+{
+private:
+    struct Storage;
+
+public:
+    SegmentPool() = default;
+    ~SegmentPool();
+
+    // Message thread. Throws away the old segments and starts recording into
+    // a new pool. Returns false if there isn't enough memory.
+    bool start(int numSegments, int segmentLength);
+
+    // Message thread. Stops recording but keeps the segments.
+    void stop();
+
+    // Message thread. Frees the pool.
+    void clear();
+
+    // Message thread.
+    bool isRecording() const;
+    int getNumRecorded() const;
+    int getCapacity() const;
+    int getSegmentLength() const;
+    const float* getSegment(int index) const;
+    juce::int64 getTimestamp(int index) const;
+
+    // Writes the recorded segments back to back into a mono 32-bit float WAV
+    // file, and their timestamps into a CSV file with the same name.
+    bool exportTo(const juce::File& file, double sampleRate) const;
+
+    // Audio thread. Holds on to the pool while recording into it, so it
+    // can't be freed halfway through.
+    class Writer
+    {
+    public:
+        explicit Writer(SegmentPool& pool);
+
+        bool isRecording() const noexcept;
+
+        // Samples left in the segment that's being written, if any.
+        int getRemaining() const noexcept;
+
+        // Starts a segment at the given host sample position. Returns false
+        // if the pool is full.
+        bool begin(juce::int64 timestamp) noexcept;
+
+        void write(const float* samples, int numSamples) noexcept;
+
+        // Forgets the segment that's being written, if any.
+        void cancel() noexcept;
+
+    private:
+        SegmentPool& pool;
+        RetiringPointer<Storage>::Reader reader;
+        Storage* storage;
+
+        JUCE_DECLARE_NON_COPYABLE(Writer)
+    };
+
+private:
+    RetiringPointer<Storage> storage;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SegmentPool)
+};
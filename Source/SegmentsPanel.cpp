@@ -0,0 +1,220 @@
+#include "SegmentsPanel.h"
+#include "UiTheme.h"
+
+namespace {
+constexpr int kPadding = 8;
+constexpr int kRowHeight = 24;
+
+// Making frames is cheap, but not for thousands of long segments at once.
+// The envelope catches up over a few timer ticks instead.
+constexpr int kSegmentsPerUpdate = 256;
+
+const int segmentCounts[] = { 100, 1000, 10000 };
+const int segmentLengths[] = { 256, 1024, 4096 };
+
+juce::String formatTimestamp(juce::int64 samples, double sampleRate)
+{
+    return juce::String(double(samples) / sampleRate, 3) + " s";
+}
+}
+
+SegmentsPanel::SegmentsPanel(MexoscopeAudioProcessor& p)
+    : processor(p), pool(p.mexoscope.getSegments())
+{
+    for (int i = 0; i < int(std::size(segmentCounts)); ++i) {
+        countBox.addItem(juce::String(segmentCounts[i]) + " segments", i + 1);
+    }
+    for (int i = 0; i < int(std::size(segmentLengths)); ++i) {
+        lengthBox.addItem(juce::String(segmentLengths[i]) + " samples", i + 1);
+    }
+    countBox.setSelectedId(2, juce::dontSendNotification);
+    lengthBox.setSelectedId(2, juce::dontSendNotification);
+    countBox.setTooltip("Number of segments to record");
+    lengthBox.setTooltip("Length of each segment, starting at the trigger");
+
+    recordButton.setTooltip("Record a segment at every trigger until the pool is full");
+    recordButton.onClick = [this] { toggleRecording(); };
+
+    exportButton.setTooltip("Write the segments to a WAV file with their timestamps in a CSV file");
+    exportButton.onClick = [this] { exportSegments(); };
+
+    overlayButton.setButtonText("Overlay");
+    overlayButton.setTooltip("Show the envelope of all recorded segments");
+    overlayButton.setClickingTogglesState(true);
+    overlayButton.onClick = [this] { update(); };
+
+    browser.setSliderStyle(juce::Slider::LinearHorizontal);
+    browser.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
+    browser.setRange(0.0, 1.0, 1.0);
+    browser.setTooltip("Browse the recorded segments");
+    browser.onValueChange = [this] { update(); };
+
+    addAndMakeVisible(countBox);
+    addAndMakeVisible(lengthBox);
+    addAndMakeVisible(recordButton);
+    addAndMakeVisible(exportButton);
+    addAndMakeVisible(overlayButton);
+    addAndMakeVisible(browser);
+}
+
+void SegmentsPanel::toggleRecording()
+{
+    if (pool.isRecording()) {
+        processor.stopSegments();
+    } else {
+        const int count = segmentCounts[juce::jmax(0, countBox.getSelectedItemIndex())];
+        const int length = segmentLengths[juce::jmax(0, lengthBox.getSelectedItemIndex())];
+        if (!processor.startSegments(count, length)) {
+            recordButton.setTooltip("Not enough memory for " + juce::String(count) + " segments");
+        }
+        selectedIndex = -1;
+        envelopeCount = 0;
+    }
+    update();
+}
+
+void SegmentsPanel::exportSegments()
+{
+    const auto file = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                          .getNonexistentChildFile("mexoscope-segments", ".wav");
+    if (pool.exportTo(file, processor.mexoscope.getSampleRate())) {
+        exportButton.setTooltip("Exported to " + file.getFullPathName());
+    } else {
+        exportButton.setTooltip("Export failed");
+    }
+}
+
+void SegmentsPanel::update()
+{
+    // The pool stops by itself when it's full.
+    if (!pool.isRecording() && pool.getCapacity() > 0) {
+        processor.stopSegments();
+    }
+
+    recordButton.setButtonText(pool.isRecording() ? "Stop" : "Record");
+    countBox.setEnabled(!pool.isRecording());
+    lengthBox.setEnabled(!pool.isRecording());
+
+    const int numRecorded = pool.getNumRecorded();
+    exportButton.setEnabled(numRecorded > 0 && !pool.isRecording());
+    browser.setEnabled(numRecorded > 0);
+    if (numRecorded > 0) {
+        // Follow the newest segment while recording, unless the user went
+        // back to an earlier one.
+        const bool following = (selectedIndex < 0 || selectedIndex >= lastNumRecorded - 1);
+        browser.setRange(0.0, double(juce::jmax(1, numRecorded - 1)), 1.0);
+        if (following) {
+            browser.setValue(double(numRecorded - 1), juce::dontSendNotification);
+        }
+    }
+
+    lastNumRecorded = numRecorded;
+
+    updateFrames();
+    repaint();
+}
+
+void SegmentsPanel::updateFrames()
+{
+    const int numRecorded = pool.getNumRecorded();
+    const float amp = processor.mexoscope.getParameter(Mexoscope::kAmpWindow);
+    const float time = processor.mexoscope.getParameter(Mexoscope::kTimeWindow);
+    const float gain = std::pow(10.0f, amp * 6.0f - 3.0f);
+    const double counterSpeed = std::pow(10.0, 1.5 - time * 5.0);
+
+    // Start over when the frames would look different, or when a new
+    // recording was started.
+    const bool redo = (amp != frameAmp || time != frameTime || numRecorded < envelopeCount
+                       || pool.getCapacity() != envelopeCapacity);
+    if (redo) {
+        frameAmp = amp;
+        frameTime = time;
+        envelopeCapacity = pool.getCapacity();
+        envelopeCount = 0;
+    }
+
+    const int index = (numRecorded > 0) ? juce::jlimit(0, numRecorded - 1, int(browser.getValue())) : -1;
+    if (index != selectedIndex || redo) {
+        selectedIndex = index;
+        if (index >= 0) {
+            Mexoscope::makeFrame(pool.getSegment(index), pool.getSegmentLength(), gain, counterSpeed, selectedFrame);
+        }
+    }
+
+    if (!overlayButton.getToggleState()) {
+        return;
+    }
+
+    if (envelopeCount == 0) {
+        for (size_t j = 0; j < envelope.size(); j += 2) {
+            envelope[j] = { int(j / 2), OSC_HEIGHT };
+            envelope[j + 1] = { int(j / 2), -1 };
+        }
+    }
+
+    Mexoscope::PeaksArray frame;
+    const int end = juce::jmin(numRecorded, envelopeCount + kSegmentsPerUpdate);
+    for (; envelopeCount < end; ++envelopeCount) {
+        Mexoscope::makeFrame(pool.getSegment(envelopeCount), pool.getSegmentLength(), gain, counterSpeed, frame);
+        for (size_t j = 0; j < frame.size(); j += 2) {
+            envelope[j].y = juce::jmin(envelope[j].y, frame[j].y, frame[j + 1].y);
+            envelope[j + 1].y = juce::jmax(envelope[j + 1].y, frame[j].y, frame[j + 1].y);
+        }
+    }
+}
+
+const Mexoscope::PeaksArray* SegmentsPanel::getSelectedFrame() const
+{
+    return (selectedIndex >= 0) ? &selectedFrame : nullptr;
+}
+
+const Mexoscope::PeaksArray* SegmentsPanel::getEnvelope() const
+{
+    return (overlayButton.getToggleState() && envelopeCount > 0) ? &envelope : nullptr;
+}
+
+void SegmentsPanel::paint(juce::Graphics& g)
+{
+    const auto bounds = getLocalBounds().toFloat();
+    g.setColour(ui::kPanelColour.withAlpha(0.9f));
+    g.fillRoundedRectangle(bounds, 6.0f);
+    g.setColour(ui::kPanelEdgeColour);
+    g.drawRoundedRectangle(bounds.reduced(0.5f), 6.0f, 1.0f);
+
+    juce::String status;
+    const int numRecorded = pool.getNumRecorded();
+    if (pool.getCapacity() == 0) {
+        status = "No segments";
+    } else if (selectedIndex < 0) {
+        status = juce::String(numRecorded) + "/" + juce::String(pool.getCapacity());
+    } else {
+        status = juce::String(selectedIndex + 1) + "/" + juce::String(numRecorded)
+                 + (pool.isRecording() ? " of " + juce::String(pool.getCapacity()) : juce::String())
+                 + "  at " + formatTimestamp(pool.getTimestamp(selectedIndex), processor.mexoscope.getSampleRate());
+    }
+
+    g.setColour(pool.isRecording() ? ui::kAccentColour : ui::kTextColour);
+    g.setFont(ui::monoFont());
+    g.drawText(status, statusBounds, juce::Justification::centredLeft, false);
+}
+
+void SegmentsPanel::resized()
+{
+    auto area = getLocalBounds().reduced(kPadding);
+
+    auto top = area.removeFromTop(kRowHeight);
+    countBox.setBounds(top.removeFromLeft(130));
+    top.removeFromLeft(4);
+    lengthBox.setBounds(top.removeFromLeft(130));
+    top.removeFromLeft(4);
+    recordButton.setBounds(top.removeFromLeft(64));
+    top.removeFromLeft(4);
+    exportButton.setBounds(top.removeFromLeft(64));
+    top.removeFromLeft(8);
+    statusBounds = top;
+
+    area.removeFromTop(kPadding);
+    auto bottom = area.removeFromTop(kRowHeight);
+    overlayButton.setBounds(bottom.removeFromRight(80));
+    browser.setBounds(bottom);
+}
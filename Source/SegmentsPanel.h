@@ -0,0 +1,62 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+/*
+  Controls for the segmented memory: how many segments of what length to
+  record, starting and stopping, browsing the recorded segments, and
+  exporting them. With Overlay on, the display also shows the envelope of
+  every recorded segment, so a segment that's different from the rest
+  stands out.
+*/
+class SegmentsPanel : public juce::Component
+{
+public:
+    explicit SegmentsPanel(MexoscopeAudioProcessor& processor);
+
+    // Follows the recording. Call this from the editor's timer.
+    void update();
+
+    // The segment that's selected, or nullptr if there isn't one.
+    const Mexoscope::PeaksArray* getSelectedFrame() const;
+
+    // Top and bottom of all recorded segments per column, or nullptr if
+    // Overlay is off.
+    const Mexoscope::PeaksArray* getEnvelope() const;
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+    static constexpr int kPreferredHeight = 72;
+
+private:
+    void toggleRecording();
+    void exportSegments();
+
+    // Redoes the selected frame and the envelope when the segments or the
+    // Time and Amp settings change.
+    void updateFrames();
+
+    MexoscopeAudioProcessor& processor;
+    SegmentPool& pool;
+
+    juce::ComboBox countBox;
+    juce::ComboBox lengthBox;
+    juce::TextButton recordButton { "Record" };
+    juce::TextButton exportButton { "Export" };
+    juce::ToggleButton overlayButton;
+    juce::Slider browser;
+    juce::Rectangle<int> statusBounds;
+
+    Mexoscope::PeaksArray selectedFrame;
+    Mexoscope::PeaksArray envelope;
+    int selectedIndex = -1;
+    int lastNumRecorded = 0;
+    int envelopeCount = 0;
+    int envelopeCapacity = 0;
+    float frameAmp = -1.0f;
+    float frameTime = -1.0f;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SegmentsPanel)
+};
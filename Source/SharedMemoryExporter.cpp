@@ -0,0 +1,217 @@
+#include "SharedMemoryExporter.h"
+#include "RealtimeCheck.h"
+#include <cstring>
+
+#if JUCE_LINUX || JUCE_MAC || JUCE_BSD
+ #define MEXOSCOPE_HAS_SHM 1
+ #include <fcntl.h>
+ #include <sys/mman.h>
+ #include <unistd.h>
+#else
+ #define MEXOSCOPE_HAS_SHM 0
+#endif
+
+namespace {
+// Gives every plug-in instance in this process its own object name.
+std::atomic<int> instanceCounter { 0 };
+
+float* rawRing(mexport::ExportHeader* header, uint32_t channel)
+{
+    auto* base = reinterpret_cast<char*>(header) + header->rawOffset;
+    return reinterpret_cast<float*>(base) + size_t(channel) * header->rawCapacity;
+}
+
+void copySamples(float* destination, const float* source, int numSamples)
+{
+    std::memcpy(destination, source, size_t(numSamples) * sizeof(float));
+}
+
+void copySamples(float* destination, const double* source, int numSamples)
+{
+    for (int i = 0; i < numSamples; ++i) {
+        destination[i] = float(source[i]);
+    }
+}
+
+mexport::FrameRecord* frameSlot(mexport::ExportHeader* header, uint64_t frameIndex)
+{
+    auto* base = reinterpret_cast<char*>(header) + header->frameOffset;
+    const auto slot = frameIndex & (header->frameCapacity - 1);
+    return reinterpret_cast<mexport::FrameRecord*>(base + slot * header->frameStride);
+}
+}
+
+SharedMemoryExporter::SharedMemoryExporter()
+{
+#if MEXOSCOPE_HAS_SHM
+    name = "/mexoscope-" + juce::String(int(getpid())) + "-" + juce::String(instanceCounter++);
+#endif
+}
+
+SharedMemoryExporter::~SharedMemoryExporter()
+{
+    close();
+}
+
+bool SharedMemoryExporter::open(int numChannels, double sampleRate)
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    close();
+
+#if MEXOSCOPE_HAS_SHM
+    const auto channels = uint32_t(juce::jlimit(1, int(mexport::kMaxChannels), numChannels));
+    const auto size = size_t(mexport::totalSize(channels));
+
+    const int fd = shm_open(name.toRawUTF8(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    if (ftruncate(fd, off_t(size)) != 0) {
+        ::close(fd);
+        shm_unlink(name.toRawUTF8());
+        return false;
+    }
+
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (memory == MAP_FAILED) {
+        shm_unlink(name.toRawUTF8());
+        return false;
+    }
+
+    // Fill in the header before publishing the magic, so a reader that sees
+    // a valid magic also sees a valid layout.
+    std::memset(memory, 0, size);
+    auto* header = new (memory) mexport::ExportHeader();
+    header->version = mexport::kVersion;
+    header->headerSize = sizeof(mexport::ExportHeader);
+    header->numChannels = channels;
+    header->rawCapacity = mexport::kRawCapacity;
+    header->rawOffset = mexport::rawOffset();
+    header->frameCapacity = mexport::kFrameCapacity;
+    header->frameColumns = OSC_WIDTH;
+    header->frameOffset = mexport::frameOffset(channels);
+    header->frameStride = sizeof(mexport::FrameRecord);
+    header->sampleRate.store(sampleRate);
+    header->maskLastFailure.store(-1);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, mexport::kMagic, sizeof(header->magic));
+
+    mappedSize = size;
+    mapping.publish(header);
+    return true;
+#else
+    juce::ignoreUnused(numChannels, sampleRate);
+    return false;
+#endif
+}
+
+void SharedMemoryExporter::close()
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+#if MEXOSCOPE_HAS_SHM
+    auto* header = mapping.retire();
+    if (header == nullptr) {
+        return;
+    }
+
+    munmap(header, mappedSize);
+    shm_unlink(name.toRawUTF8());
+    mappedSize = 0;
+#endif
+}
+
+void SharedMemoryExporter::setSampleRate(double sampleRate)
+{
+    const RetiringPointer<mexport::ExportHeader>::Reader reader(mapping);
+    if (auto* header = reader.get()) {
+        header->sampleRate.store(sampleRate, std::memory_order_relaxed);
+    }
+}
+
+template <typename SampleType>
+void SharedMemoryExporter::writeSamples(const juce::AudioBuffer<SampleType>& buffer)
+{
+    const RetiringPointer<mexport::ExportHeader>::Reader reader(mapping);
+    auto* header = reader.get();
+    if (header == nullptr) {
+        return;
+    }
+
+    const auto writeIndex = header->rawWriteIndex.load(std::memory_order_relaxed);
+    const auto mask = header->rawCapacity - 1;
+    const auto numChannels = juce::jmin(uint32_t(buffer.getNumChannels()), header->numChannels);
+
+    // Readers can only use the most recent half of the ring, so a block
+    // that's larger than that only needs its most recent part.
+    const int usable = int(mexport::usableRawCapacity(header->rawCapacity));
+    int numSamples = buffer.getNumSamples();
+    int sourceOffset = 0;
+    if (numSamples > usable) {
+        sourceOffset = numSamples - usable;
+        numSamples = usable;
+    }
+
+    const auto start = uint32_t((writeIndex + uint64_t(sourceOffset)) & mask);
+    const auto firstPart = juce::jmin(numSamples, int(header->rawCapacity - start));
+
+    for (uint32_t ch = 0; ch < numChannels; ++ch) {
+        const SampleType* source = buffer.getReadPointer(int(ch), sourceOffset);
+        float* ring = rawRing(header, ch);
+        copySamples(ring + start, source, firstPart);
+        copySamples(ring, source + firstPart, numSamples - firstPart);
+    }
+
+    header->rawWriteIndex.store(writeIndex + uint64_t(buffer.getNumSamples()), std::memory_order_release);
+}
+
+template void SharedMemoryExporter::writeSamples(const juce::AudioBuffer<float>&);
+template void SharedMemoryExporter::writeSamples(const juce::AudioBuffer<double>&);
+
+void SharedMemoryExporter::writeFrame(const Mexoscope::PeaksArray& frame)
+{
+    const RetiringPointer<mexport::ExportHeader>::Reader reader(mapping);
+    auto* header = reader.get();
+    if (header == nullptr) {
+        return;
+    }
+
+    const auto frameIndex = header->frameWriteIndex.load(std::memory_order_relaxed);
+    auto* record = frameSlot(header, frameIndex);
+
+    record->samplePosition = header->rawWriteIndex.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < frame.size(); ++i) {
+        record->y[i] = int16_t(frame[i].y);
+    }
+
+    header->frameWriteIndex.store(frameIndex + 1, std::memory_order_release);
+}
+
+void SharedMemoryExporter::writeMaskResults(const MaskTest::Results& results)
+{
+    const RetiringPointer<mexport::ExportHeader>::Reader reader(mapping);
+    auto* header = reader.get();
+    if (header == nullptr) {
+        return;
+    }
+
+    header->maskTestedFrames.store(results.numTested, std::memory_order_relaxed);
+    header->maskFailedFrames.store(results.numFailed, std::memory_order_relaxed);
+    header->maskLastFailure.store(results.lastFailure, std::memory_order_relaxed);
+}
+
+void SharedMemoryExporter::writeTriggerStats(uint64_t accepted, uint64_t rejected, double periodMean, double periodStdDev)
+{
+    const RetiringPointer<mexport::ExportHeader>::Reader reader(mapping);
+    auto* header = reader.get();
+    if (header == nullptr) {
+        return;
+    }
+
+    header->triggersAccepted.store(accepted, std::memory_order_relaxed);
+    header->triggersRejected.store(rejected, std::memory_order_relaxed);
+    header->triggerPeriodMean.store(periodMean, std::memory_order_relaxed);
+    header->triggerPeriodStdDev.store(periodStdDev, std::memory_order_relaxed);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "ExportLayout.h"
+#include "Mexoscope.h"
+#include "RetiringPointer.h"
+
+/*
+  Optional exporter that writes the capture stream into a POSIX shared-memory
+  ring, so external monitoring or logging tools can follow along without
+  running a second analyser. See ExportLayout.h for the memory layout.
+
+  `open` and `close` create and destroy the shared-memory object and must be
+  called from the message thread. The write functions are called from the
+  audio thread. They only copy into the ring and never wait on a reader.
+  On platforms without POSIX shared memory the exporter never opens.
+*/
+class SharedMemoryExporter
+{
+public:
+    SharedMemoryExporter();
+    ~SharedMemoryExporter();
+
+    bool open(int numChannels, double sampleRate);
+    void close();
+
+    bool isOpen() const { return mapping.get() != nullptr; }
+
+    // Name of the shared-memory object, e.g. "/mexoscope-1234-0".
+    const juce::String& getName() const { return name; }
+
+    void setSampleRate(double sampleRate);
+
+    // The ring always holds floats. Double precision blocks are converted
+    // while copying.
+    template <typename SampleType>
+    void writeSamples(const juce::AudioBuffer<SampleType>& buffer);
+
+    void writeFrame(const Mexoscope::PeaksArray& frame);
+
+    void writeMaskResults(const MaskTest::Results& results);
+
+    void writeTriggerStats(uint64_t accepted, uint64_t rejected, double periodMean, double periodStdDev);
+
+private:
+    // The write functions read it through a Reader, which keeps `close`
+    // from unmapping the memory while the audio thread is still writing.
+    RetiringPointer<mexport::ExportHeader> mapping;
+
+    juce::String name;
+    size_t mappedSize = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SharedMemoryExporter)
+};
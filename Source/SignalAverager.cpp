@@ -0,0 +1,149 @@
+#include "SignalAverager.h"
+#include "RealtimeCheck.h"
+
+SignalAverager::SignalAverager(Mexoscope& m)
+    : juce::Thread("mexoscope averager"),
+      mexoscope(m),
+      sweepSamples(size_t(SweepFifo::kMaxSweepLength)),
+      sum(size_t(SweepFifo::kMaxSweepLength)),
+      average(size_t(SweepFifo::kMaxSweepLength))
+{
+    for (size_t j = 0; j < frame.size(); ++j) {
+        frame[j].x = int(j / 2);
+        frame[j].y = OSC_CENTER;
+    }
+}
+
+SignalAverager::~SignalAverager()
+{
+    stopThread(1000);
+    mexoscope.getSweeps().setEnabled(false);
+}
+
+void SignalAverager::setMode(Mode newMode, int newNumSweeps)
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+
+    stopThread(1000);
+    mexoscope.getSweeps().setEnabled(false);
+
+    mode = newMode;
+    numSweeps = juce::jmax(1, newNumSweeps);
+    length = 0;
+    count = 0;
+    haveAverage = false;
+    publishedAmp = -1.0f;
+
+    {
+        const juce::SpinLock::ScopedLockType lock(frameLock);
+        frameSweeps = 0;
+    }
+
+    if (mode != Mode::Off) {
+        // Sweeps left over from an earlier average would start this one
+        // with the wrong settings.
+        mexoscope.getSweeps().discard();
+        mexoscope.getSweeps().setEnabled(true);
+        startThread();
+    }
+}
+
+int SignalAverager::getFrame(Mexoscope::PeaksArray& destination) const
+{
+    const juce::SpinLock::ScopedLockType lock(frameLock);
+    if (frameSweeps > 0) {
+        destination = frame;
+    }
+    return frameSweeps;
+}
+
+void SignalAverager::run()
+{
+    while (!threadShouldExit()) {
+        bool changed = false;
+
+        SweepFifo::Sweep sweep;
+        while (mexoscope.getSweeps().read(sweep, sweepSamples.data())) {
+            accumulate(sweep);
+            changed = true;
+        }
+
+        // The gain is applied to the average, so a new gain needs a new
+        // frame even when no sweeps come in, e.g. while frozen.
+        if (length > 0 && (changed || mexoscope.getParameter(Mexoscope::kAmpWindow) != publishedAmp)) {
+            publish();
+        }
+
+        wait(5);
+    }
+}
+
+void SignalAverager::restart(const SweepFifo::Sweep& sweep)
+{
+    length = int(sweep.length);
+    generation = sweep.generation;
+    count = 0;
+    haveAverage = false;
+
+    std::fill(sum.begin(), sum.begin() + length, 0.0);
+    std::fill(average.begin(), average.begin() + length, 0.0);
+}
+
+void SignalAverager::accumulate(const SweepFifo::Sweep& sweep)
+{
+    if (sweep.generation != generation || int(sweep.length) != length) {
+        restart(sweep);
+    }
+
+    const float* x = sweepSamples.data();
+    double* s = sum.data();
+    double* a = average.data();
+
+    // Plain loops over contiguous arrays, which the compiler vectorises.
+    if (mode == Mode::Linear) {
+        for (int i = 0; i < length; ++i) {
+            s[i] += double(x[i]);
+        }
+
+        if (++count == numSweeps) {
+            const double scale = 1.0 / double(count);
+            for (int i = 0; i < length; ++i) {
+                a[i] = s[i] * scale;
+                s[i] = 0.0;
+            }
+            count = 0;
+            haveAverage = true;
+        }
+    } else {
+        count = juce::jmin(count + 1, numSweeps);
+        const double weight = 1.0 / double(count);
+        for (int i = 0; i < length; ++i) {
+            a[i] += (double(x[i]) - a[i]) * weight;
+        }
+        haveAverage = true;
+    }
+}
+
+void SignalAverager::publish()
+{
+    publishedAmp = mexoscope.getParameter(Mexoscope::kAmpWindow);
+    const float gain = std::pow(10.0f, publishedAmp * 6.0f - 3.0f);
+    const double counterSpeed = std::pow(10.0, 1.5 - mexoscope.getParameter(Mexoscope::kTimeWindow) * 5.0);
+
+    // Until the first linear average is complete, show the one in progress.
+    const bool partial = !haveAverage;
+    const double* values = partial ? sum.data() : average.data();
+    const double scale = partial ? 1.0 / double(juce::jmax(1, count)) : 1.0;
+    const int sweepsShown = partial ? count : (mode == Mode::Linear ? numSweeps : count);
+
+    for (int i = 0; i < length; ++i) {
+        sweepSamples[size_t(i)] = float(values[i] * scale);
+    }
+
+    Mexoscope::PeaksArray peaks;
+    Mexoscope::makeFrame(sweepSamples.data(), length, gain, counterSpeed, peaks);
+
+    const juce::SpinLock::ScopedLockType lock(frameLock);
+    frame = peaks;
+    frameSweeps = sweepsShown;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Mexoscope.h"
+
+/*
+  Averages triggered sweeps to pull periodic detail out of the noise. The
+  audio thread only copies raw sweeps into Mexoscope's sweep FIFO, all the
+  arithmetic happens on a background thread that drains it every few
+  milliseconds. Adding a sweep costs the same whatever the number of sweeps
+  being averaged, so thousands are no problem.
+
+  Linear averaging takes the plain mean of N sweeps, then starts over on the
+  next N and shows the finished average while it collects them. Exponential
+  averaging weighs every new sweep by 1 / N (by 1 / count until there are N),
+  so it keeps following slow changes.
+
+  The average is kept in samples, not pixels, so it's exact however far the
+  display zooms in. It's turned into a frame with the current gain just like
+  Mexoscope turns the input into one. Changing anything that moves the
+  trigger point or the time window starts a new average.
+*/
+class SignalAverager : private juce::Thread
+{
+public:
+    enum class Mode
+    {
+        Off,
+        Linear,
+        Exponential
+    };
+
+    explicit SignalAverager(Mexoscope& mexoscope);
+    ~SignalAverager() override;
+
+    // Message thread. Starts a new average.
+    void setMode(Mode newMode, int numSweeps);
+
+    Mode getMode() const { return mode; }
+    int getNumSweeps() const { return numSweeps; }
+
+    // Copies the latest averaged frame. Returns the number of sweeps in it,
+    // or 0 if no sweep has come in yet.
+    int getFrame(Mexoscope::PeaksArray& frame) const;
+
+private:
+    void run() override;
+
+    // Adds a sweep to the average. Starts over if it doesn't fit with the
+    // sweeps that came before.
+    void accumulate(const SweepFifo::Sweep& sweep);
+    void restart(const SweepFifo::Sweep& sweep);
+
+    // Turns the average into a frame for the display.
+    void publish();
+
+    Mexoscope& mexoscope;
+
+    // Only changed by `setMode`, while the thread isn't running.
+    Mode mode = Mode::Off;
+    int numSweeps = 1;
+
+    // Only used by the background thread. Accumulating in double keeps the
+    // mean of thousands of sweeps accurate well below the noise floor.
+    std::vector<float> sweepSamples;
+    std::vector<double> sum;
+    std::vector<double> average;
+    int length = 0;
+    uint32_t generation = 0;
+    int count = 0;
+    bool haveAverage = false;
+    float publishedAmp = -1.0f;
+
+    mutable juce::SpinLock frameLock;
+    Mexoscope::PeaksArray frame;
+    int frameSweeps = 0;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SignalAverager)
+};
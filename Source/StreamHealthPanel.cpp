@@ -0,0 +1,107 @@
+#include "StreamHealthPanel.h"
+#include "UiTheme.h"
+
+namespace {
+constexpr int kPadding = 8;
+constexpr int kRowHeight = 24;
+constexpr int kLineHeight = 15;
+
+juce::String formatTimestamp(juce::int64 samples, double sampleRate)
+{
+    return juce::String(double(samples) / sampleRate, 3) + " s";
+}
+}
+
+StreamHealthPanel::StreamHealthPanel(StreamMonitor& m)
+    : monitor(m)
+{
+    clearButton.setTooltip("Forget the events and start counting again");
+    clearButton.onClick = [this] {
+        monitor.reset();
+        repaint();
+    };
+
+    exportButton.setTooltip("Write the events to a CSV file");
+    exportButton.onClick = [this] { exportLog(); };
+
+    addAndMakeVisible(clearButton);
+    addAndMakeVisible(exportButton);
+}
+
+void StreamHealthPanel::exportLog()
+{
+    const auto file = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                          .getNonexistentChildFile("mexoscope-health", ".csv");
+    if (monitor.exportTo(file)) {
+        exportButton.setTooltip("Exported to " + file.getFullPathName());
+    } else {
+        exportButton.setTooltip("Export failed");
+    }
+}
+
+void StreamHealthPanel::update()
+{
+    monitor.collect();
+    exportButton.setEnabled(!monitor.getHistory().empty());
+    if (isVisible()) {
+        repaint();
+    }
+}
+
+void StreamHealthPanel::paint(juce::Graphics& g)
+{
+    const auto bounds = getLocalBounds().toFloat();
+    g.setColour(ui::kPanelColour.withAlpha(0.9f));
+    g.fillRoundedRectangle(bounds, 6.0f);
+    g.setColour(ui::kPanelEdgeColour);
+    g.drawRoundedRectangle(bounds.reduced(0.5f), 6.0f, 1.0f);
+
+    const auto& history = monitor.getHistory();
+    g.setFont(ui::monoFont());
+
+    juce::String status = history.empty() ? "All clear" : juce::String(int(history.size())) + " events";
+    if (monitor.getNumDropped() > 0) {
+        status << ", " << juce::int64(monitor.getNumDropped()) << " dropped";
+    }
+    g.setColour(history.empty() ? ui::kTextColour : ui::kAccentColour);
+    g.drawText(status, statusBounds, juce::Justification::centredLeft, false);
+
+    auto area = getLocalBounds().reduced(kPadding);
+    area.removeFromTop(kRowHeight + 4);
+
+    // The totals, three to a line.
+    const int columnWidth = area.getWidth() / 3;
+    for (int kind = 0; kind < StreamMonitor::kNumKinds; kind += 3) {
+        auto line = area.removeFromTop(kLineHeight);
+        for (int k = kind; k < kind + 3 && k < StreamMonitor::kNumKinds; ++k) {
+            const auto total = monitor.getTotal(StreamMonitor::Kind(k));
+            g.setColour(total > 0 ? ui::kAccentColour : ui::kMutedTextColour);
+            g.drawText(juce::String(StreamMonitor::getKindName(StreamMonitor::Kind(k))) + " " + juce::String(juce::int64(total)),
+                       line.removeFromLeft(columnWidth), juce::Justification::centredLeft, false);
+        }
+    }
+
+    // The latest events, as many as fit.
+    area.removeFromTop(4);
+    g.setColour(ui::kTextColour);
+    const double sampleRate = monitor.getSampleRate();
+    for (auto it = history.rbegin(); it != history.rend() && area.getHeight() >= kLineHeight; ++it) {
+        juce::String text = formatTimestamp(it->position, sampleRate).paddedLeft(' ', 11);
+        text << (it->channel == 0 ? "  L  " : "  R  ") << juce::String(StreamMonitor::getKindName(it->kind)).paddedRight(' ', 10)
+             << juce::String(it->value, 4, it->kind == StreamMonitor::kDenormal);
+        if (it->count > 1) {
+            text << "  x" << juce::int64(it->count);
+        }
+        g.drawText(text, area.removeFromTop(kLineHeight), juce::Justification::centredLeft, false);
+    }
+}
+
+void StreamHealthPanel::resized()
+{
+    auto top = getLocalBounds().reduced(kPadding).removeFromTop(kRowHeight);
+    exportButton.setBounds(top.removeFromRight(64));
+    top.removeFromRight(4);
+    clearButton.setBounds(top.removeFromRight(64));
+    top.removeFromRight(8);
+    statusBounds = top;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "StreamMonitor.h"
+
+/*
+  The stream health log: how often each problem was seen since the last
+  clear, and the latest events, newest first. Clear starts over, Export
+  writes the log to a CSV file.
+*/
+class StreamHealthPanel : public juce::Component
+{
+public:
+    explicit StreamHealthPanel(StreamMonitor& monitor);
+
+    // Takes the new events. Call this from the editor's timer, also while
+    // the panel is hidden, so the queue doesn't fill up.
+    void update();
+
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+    static constexpr int kPreferredWidth = 340;
+    static constexpr int kPreferredHeight = 196;
+
+private:
+    void exportLog();
+
+    StreamMonitor& monitor;
+
+    juce::TextButton clearButton { "Clear" };
+    juce::TextButton exportButton { "Export" };
+    juce::Rectangle<int> statusBounds;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StreamHealthPanel)
+};
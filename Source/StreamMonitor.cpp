@@ -0,0 +1,349 @@
+#include "StreamMonitor.h"
+#include "RealtimeCheck.h"
+
+namespace {
+// The bits of a sample, so the tests don't depend on the FPU's denormal
+// mode.
+template <typename SampleType>
+struct SampleBits;
+
+template <>
+struct SampleBits<float>
+{
+    using Type = uint32_t;
+    static constexpr Type kExponent = 0x7f800000u;
+    static constexpr Type kMantissa = 0x007fffffu;
+};
+
+template <>
+struct SampleBits<double>
+{
+    using Type = uint64_t;
+    static constexpr Type kExponent = 0x7ff0000000000000u;
+    static constexpr Type kMantissa = 0x000fffffffffffffu;
+};
+}
+
+StreamMonitor::StreamMonitor()
+{
+    prepare(44100.0);
+}
+
+const char* StreamMonitor::getKindName(Kind kind)
+{
+    switch (kind) {
+        case kNonFinite: return "NaN/Inf";
+        case kDenormal: return "denormal";
+        case kClick: return "click";
+        case kDropout: return "dropout";
+        case kStuck: return "stuck";
+        case kDCOffset: return "DC offset";
+        default: return "";
+    }
+}
+
+void StreamMonitor::prepare(double newSampleRate)
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+
+    sampleRate = newSampleRate;
+    minDropout = juce::jmax(1, juce::roundToInt(sampleRate * 0.001));
+    minStuck = juce::jmax(1, juce::roundToInt(sampleRate * 0.05));
+    dcWindow = juce::jmax(kChunkSize, juce::roundToInt(sampleRate * 0.5));
+    holdOff = juce::jmax(juce::int64(1), juce::int64(sampleRate * 0.1));
+    restart();
+}
+
+void StreamMonitor::restart()
+{
+    for (auto& state : channels) {
+        state = ChannelState();
+        state.lastLogged.fill(std::numeric_limits<juce::int64>::min() / 2);
+    }
+    streamPosition = 0;
+}
+
+template <typename SampleType>
+void StreamMonitor::process(const juce::AudioBuffer<SampleType>& buffer, juce::int64 hostTime)
+{
+    if (resetRequested.exchange(false)) {
+        for (auto& total : totals) {
+            total.store(0, std::memory_order_relaxed);
+        }
+        dropped.store(0, std::memory_order_relaxed);
+    }
+
+    const int numChannels = juce::jmin(kMaxChannels, buffer.getNumChannels());
+    const int numSamples = buffer.getNumSamples();
+    blockPosition = streamPosition;
+    blockHostTime = hostTime;
+
+    for (int offset = 0; offset < numSamples; offset += kChunkSize) {
+        const int length = juce::jmin(kChunkSize, numSamples - offset);
+        for (int channel = 0; channel < numChannels; ++channel) {
+            scanChunk(channel, buffer.getReadPointer(channel, offset), length);
+        }
+        streamPosition += length;
+    }
+}
+
+template <typename SampleType>
+void StreamMonitor::scanChunk(int channel, const SampleType* input, int numSamples)
+{
+    using Bits = typename SampleBits<SampleType>::Type;
+    using Values = juce::dsp::SIMDRegister<SampleType>;
+    using Masks = juce::dsp::SIMDRegister<Bits>;
+    static_assert(Values::size() == Masks::size(), "a mask lane for every sample lane");
+    constexpr int kLanes = int(Values::size());
+
+    auto& state = channels[size_t(channel)];
+
+    // Every sample next to the one before it, so the vectors line up, and
+    // the bits of both.
+    alignas(32) SampleType values[kChunkSize];
+    alignas(32) SampleType previous[kChunkSize];
+    alignas(32) Bits bits[kChunkSize];
+    alignas(32) Bits previousBits[kChunkSize];
+
+    previous[0] = SampleType(state.previous);
+    std::copy(input, input + numSamples, values);
+    std::copy(input, input + numSamples - 1, previous + 1);
+    std::memcpy(bits, values, sizeof(SampleType) * size_t(numSamples));
+    std::memcpy(previousBits, previous, sizeof(SampleType) * size_t(numSamples));
+
+    const auto exponentMask = Masks::expand(SampleBits<SampleType>::kExponent);
+    const auto mantissaMask = Masks::expand(SampleBits<SampleType>::kMantissa);
+    const auto magnitudeMask = Masks::expand(SampleBits<SampleType>::kExponent | SampleBits<SampleType>::kMantissa);
+    const auto noBits = Masks::expand(0);
+    const auto one = Masks::expand(1);
+    const auto zero = Values::expand(0);
+
+    auto nonFiniteCount = noBits;
+    auto denormalCount = noBits;
+    auto zeroCount = noBits;
+    auto repeatCount = noBits;
+    auto largestJump = zero;
+    auto sum = zero;
+
+    const int numVectorSamples = numSamples - numSamples % kLanes;
+    for (int i = 0; i < numVectorSamples; i += kLanes) {
+        const auto b = Masks::fromRawArray(bits + i);
+        const auto exponent = b & exponentMask;
+        const auto isZero = Masks::equal(b & magnitudeMask, noBits);
+        const auto notZero = Masks::notEqual(b & magnitudeMask, noBits);
+
+        nonFiniteCount += Masks::equal(exponent, exponentMask) & one;
+        denormalCount += Masks::equal(exponent, noBits) & Masks::notEqual(b & mantissaMask, noBits) & one;
+        zeroCount += isZero & one;
+        repeatCount += Masks::equal(b, Masks::fromRawArray(previousBits + i)) & notZero & one;
+
+        const auto x = Values::fromRawArray(values + i);
+        const auto jump = x - Values::fromRawArray(previous + i);
+        largestJump = Values::max(largestJump, Values::max(jump, zero - jump));
+        sum += x;
+    }
+
+    Bits numNonFinite = nonFiniteCount.sum();
+    Bits numDenormal = denormalCount.sum();
+    Bits numZero = zeroCount.sum();
+    Bits numRepeat = repeatCount.sum();
+    SampleType maxJump = 0;
+    for (int lane = 0; lane < kLanes; ++lane) {
+        maxJump = juce::jmax(maxJump, largestJump.get(size_t(lane)));
+    }
+    SampleType total = sum.sum();
+
+    // The samples that didn't fill a vector.
+    for (int i = numVectorSamples; i < numSamples; ++i) {
+        const Bits exponent = bits[i] & SampleBits<SampleType>::kExponent;
+        const bool isZero = (bits[i] & (SampleBits<SampleType>::kExponent | SampleBits<SampleType>::kMantissa)) == 0;
+        numNonFinite += (exponent == SampleBits<SampleType>::kExponent) ? 1 : 0;
+        numDenormal += (exponent == 0 && !isZero) ? 1 : 0;
+        numZero += isZero ? 1 : 0;
+        numRepeat += (bits[i] == previousBits[i] && !isZero) ? 1 : 0;
+        maxJump = juce::jmax(maxJump, std::abs(values[i] - previous[i]));
+        total += values[i];
+    }
+
+    // Bad samples: find where they are. A NaN may hide in the largest jump,
+    // but then the chunk is looked at anyway.
+    if (numNonFinite > 0 || numDenormal > 0 || maxJump > SampleType(kClickThreshold)) {
+        int firstNonFinite = -1, firstDenormal = -1, firstClick = -1;
+        uint32_t numClicks = 0;
+        SampleType largest = 0;
+
+        for (int i = 0; i < numSamples; ++i) {
+            const Bits exponent = bits[i] & SampleBits<SampleType>::kExponent;
+            const Bits previousExponent = previousBits[i] & SampleBits<SampleType>::kExponent;
+            if (exponent == SampleBits<SampleType>::kExponent) {
+                firstNonFinite = (firstNonFinite < 0) ? i : firstNonFinite;
+            } else if (exponent == 0 && (bits[i] & SampleBits<SampleType>::kMantissa) != 0) {
+                firstDenormal = (firstDenormal < 0) ? i : firstDenormal;
+            }
+
+            // A jump from or to a NaN or infinity is already logged as such.
+            if (exponent != SampleBits<SampleType>::kExponent && previousExponent != SampleBits<SampleType>::kExponent) {
+                const SampleType jump = std::abs(values[i] - previous[i]);
+                if (jump > SampleType(kClickThreshold)) {
+                    firstClick = (firstClick < 0) ? i : firstClick;
+                    largest = juce::jmax(largest, jump);
+                    ++numClicks;
+                }
+            }
+        }
+
+        if (firstNonFinite >= 0) {
+            addEvent(kNonFinite, channel, streamPosition + firstNonFinite, uint32_t(numNonFinite), float(values[firstNonFinite]));
+        }
+        if (firstDenormal >= 0) {
+            addEvent(kDenormal, channel, streamPosition + firstDenormal, uint32_t(numDenormal), float(values[firstDenormal]));
+        }
+        if (firstClick >= 0) {
+            addEvent(kClick, channel, streamPosition + firstClick, numClicks, float(largest));
+        }
+    }
+
+    // The runs of zeros and repeats. Most chunks have neither, or are all
+    // one or the other.
+    if (numZero == 0 && numRepeat == 0) {
+        state.zeroRun = 0;
+        state.repeatRun = 0;
+    } else if (numZero == Bits(numSamples)) {
+        addToRuns(channel, streamPosition, numSamples, true, false, 0.0f, float(previous[0]));
+    } else if (numRepeat == Bits(numSamples)) {
+        addToRuns(channel, streamPosition, numSamples, false, true, float(values[0]), float(previous[0]));
+    } else {
+        for (int i = 0; i < numSamples; ++i) {
+            const bool isZero = (bits[i] & (SampleBits<SampleType>::kExponent | SampleBits<SampleType>::kMantissa)) == 0;
+            const bool isRepeat = (bits[i] == previousBits[i] && !isZero);
+            addToRuns(channel, streamPosition + i, 1, isZero, isRepeat, float(values[i]), float(previous[i]));
+        }
+    }
+
+    // DC offset, over whole chunks. A chunk with a NaN or infinity in it
+    // would spoil the mean, so it's left out.
+    if (numNonFinite == 0) {
+        state.dcSum += double(total);
+        state.dcCount += numSamples;
+        if (state.dcCount >= dcWindow) {
+            const double mean = state.dcSum / double(state.dcCount);
+            const bool active = std::abs(mean) > double(kDCThreshold);
+            if (active && !state.dcActive) {
+                addEvent(kDCOffset, channel, state.dcStart, 1, float(mean));
+            }
+            state.dcActive = active;
+            state.dcSum = 0.0;
+            state.dcCount = 0;
+            state.dcStart = streamPosition + numSamples;
+        }
+    }
+
+    state.previous = double(values[numSamples - 1]);
+}
+
+void StreamMonitor::addToRuns(int channel, juce::int64 position, int count, bool zero, bool repeat, float value, float before)
+{
+    auto& state = channels[size_t(channel)];
+
+    // A dropout is logged once it's long enough, at the first zero.
+    if (zero) {
+        if (state.zeroRun == 0) {
+            state.zeroStart = position;
+            state.levelBeforeZeros = std::abs(before);
+        }
+        const auto run = state.zeroRun + count;
+        if (state.zeroRun < minDropout && run >= minDropout && state.levelBeforeZeros >= kDropoutLevel) {
+            addEvent(kDropout, channel, state.zeroStart, 1, state.levelBeforeZeros);
+        }
+        state.zeroRun = run;
+    } else {
+        state.zeroRun = 0;
+    }
+
+    // The same for a value that sticks, which starts at the sample that's
+    // repeated.
+    if (repeat) {
+        if (state.repeatRun == 0) {
+            state.repeatStart = position - 1;
+        }
+        const auto run = state.repeatRun + count;
+        if (state.repeatRun < minStuck && run >= minStuck) {
+            addEvent(kStuck, channel, state.repeatStart, 1, value);
+        }
+        state.repeatRun = run;
+    } else {
+        state.repeatRun = 0;
+    }
+}
+
+void StreamMonitor::addEvent(Kind kind, int channel, juce::int64 position, uint32_t count, float value)
+{
+    auto& total = totals[size_t(kind)];
+    total.store(total.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+
+    auto& lastLogged = channels[size_t(channel)].lastLogged[size_t(kind)];
+    if (position - lastLogged < holdOff) {
+        return;
+    }
+    lastLogged = position;
+
+    const auto index = writeIndex.load(std::memory_order_relaxed);
+    if (index - readIndex.load(std::memory_order_acquire) >= uint32_t(kCapacity)) {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    auto& event = events[index & uint32_t(kCapacity - 1)];
+    event.position = position;
+    event.hostTime = (blockHostTime >= 0) ? blockHostTime + (position - blockPosition) : -1;
+    event.kind = kind;
+    event.channel = channel;
+    event.count = count;
+    event.value = value;
+    writeIndex.store(index + 1, std::memory_order_release);
+}
+
+void StreamMonitor::collect()
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+
+    const auto end = writeIndex.load(std::memory_order_acquire);
+    auto index = readIndex.load(std::memory_order_relaxed);
+    for (; index != end; ++index) {
+        history.push_back(events[index & uint32_t(kCapacity - 1)]);
+        if (history.size() > kHistorySize) {
+            history.pop_front();
+        }
+    }
+    readIndex.store(index, std::memory_order_release);
+}
+
+void StreamMonitor::reset()
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+
+    // Whatever is still queued is from before the reset too.
+    collect();
+    history.clear();
+    resetRequested.store(true);
+}
+
+bool StreamMonitor::exportTo(const juce::File& file) const
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+
+    juce::String text;
+    text << "# sample rate " << juce::String(sampleRate, 0) << ", dropped " << juce::int64(getNumDropped()) << "\n";
+    text << "position,seconds,host_time,channel,event,count,value\n";
+
+    for (const auto& event : history) {
+        text << event.position << "," << juce::String(double(event.position) / sampleRate, 6) << ","
+             << event.hostTime << "," << event.channel << "," << getKindName(event.kind) << ","
+             << juce::int64(event.count) << "," << juce::String(event.value, 9) << "\n";
+    }
+
+    return file.replaceWithText(text);
+}
+
+template void StreamMonitor::process(const juce::AudioBuffer<float>&, juce::int64);
+template void StreamMonitor::process(const juce::AudioBuffer<double>&, juce::int64);
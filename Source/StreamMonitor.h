@@ -0,0 +1,168 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <deque>
+
+/*
+  Watches the main input for audio that's broken rather than just loud or
+  quiet, and logs what it finds:
+
+  - NaN and infinite samples;
+  - denormal samples, which cost a lot of CPU further down the chain;
+  - clicks, where the signal jumps by more than `kClickThreshold` from one
+    sample to the next;
+  - dropouts, where the signal cuts to exact zeros for at least 1 ms
+    from above `kDropoutLevel`, as when a buffer comes too late;
+  - stuck samples, where the same non-zero value repeats for 50 ms;
+  - a DC offset, where the mean of half a second is above `kDCThreshold`.
+
+  The audio thread looks at every channel in chunks of `kChunkSize`
+  samples. One SIMD pass per chunk gathers everything the detectors need:
+  the samples' bits for NaN, infinity, denormals and zeros (bits, so that
+  the flush-to-zero mode of the audio thread doesn't hide the denormals),
+  the largest jump, the sum, and how many samples repeat or are zero. Only
+  a chunk with something wrong in it, or a run of zeros or repeats that
+  starts or ends inside it, is looked at sample by sample. For normal audio
+  that's a handful of vector operations per sample, cheap enough to always
+  be on, editor or not.
+
+  Events go to the message thread through a lock-free queue, at most one
+  per kind and channel every 100 ms. The totals count every sample (or run)
+  whether it was logged or not. While the editor is closed nobody reads
+  the queue, so once it's full the newest events are dropped and counted.
+*/
+class StreamMonitor
+{
+public:
+    enum Kind
+    {
+        kNonFinite = 0,
+        kDenormal,
+        kClick,
+        kDropout,
+        kStuck,
+        kDCOffset,
+
+        kNumKinds
+    };
+
+    static constexpr int kMaxChannels = 2;
+    static constexpr float kClickThreshold = 1.0f;
+    static constexpr float kDCThreshold = 0.1f;
+
+    // A cut to zeros from below this level is a fade or a gate, not a
+    // dropout.
+    static constexpr float kDropoutLevel = 0.01f;
+
+    struct Event
+    {
+        // Where it started, in samples since the monitor was prepared, and
+        // on the host's timeline if the transport was playing, else -1.
+        juce::int64 position = 0;
+        juce::int64 hostTime = -1;
+
+        Kind kind = kNonFinite;
+        int channel = 0;
+
+        // The number of bad samples in the chunk for NaN/Inf, denormals
+        // and clicks, otherwise 1.
+        uint32_t count = 0;
+
+        // The first bad sample for NaN/Inf and denormals, the largest jump
+        // for clicks, the level just before a dropout, the stuck value, or
+        // the mean for a DC offset.
+        float value = 0.0f;
+    };
+
+    StreamMonitor();
+
+    static const char* getKindName(Kind kind);
+
+    // Not while processing. Starts over, including the positions.
+    void prepare(double sampleRate);
+
+    // Audio thread. Only the first two channels are watched. `hostTime` is
+    // the host's position of the first sample, or -1.
+    template <typename SampleType>
+    void process(const juce::AudioBuffer<SampleType>& buffer, juce::int64 hostTime);
+
+    // Any thread. Every occurrence since the last reset, and the events
+    // that didn't fit in the queue.
+    uint64_t getTotal(Kind kind) const { return totals[size_t(kind)].load(std::memory_order_relaxed); }
+    uint64_t getNumDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Message thread. Moves the queued events to the history, which keeps
+    // the latest `kHistorySize`, oldest first.
+    void collect();
+    const std::deque<Event>& getHistory() const { return history; }
+
+    // Message thread. Clears the history, and the totals at the start of
+    // the next block.
+    void reset();
+
+    // Message thread. Writes the history as CSV.
+    bool exportTo(const juce::File& file) const;
+
+    double getSampleRate() const { return sampleRate; }
+
+private:
+    static constexpr int kChunkSize = 256;
+    static constexpr int kCapacity = 1024;
+    static constexpr size_t kHistorySize = 1000;
+
+    // Per channel, carried from one chunk to the next.
+    struct ChannelState
+    {
+        double previous = 0.0;
+
+        juce::int64 zeroRun = 0;
+        juce::int64 zeroStart = 0;
+        float levelBeforeZeros = 0.0f;
+
+        juce::int64 repeatRun = 0;
+        juce::int64 repeatStart = 0;
+
+        double dcSum = 0.0;
+        int dcCount = 0;
+        juce::int64 dcStart = 0;
+        bool dcActive = false;
+
+        std::array<juce::int64, kNumKinds> lastLogged {};
+    };
+
+    void restart();
+
+    template <typename SampleType>
+    void scanChunk(int channel, const SampleType* input, int numSamples);
+
+    // Adds `count` samples at `position` to the runs of zeros and of
+    // repeated values. They're all zero, or all repeat `value`, or neither;
+    // `before` is the sample before them.
+    void addToRuns(int channel, juce::int64 position, int count, bool zero, bool repeat, float value, float before);
+
+    void addEvent(Kind kind, int channel, juce::int64 position, uint32_t count, float value);
+
+    double sampleRate = 44100.0;
+    int minDropout = 44;
+    int minStuck = 2205;
+    int dcWindow = 22050;
+    juce::int64 holdOff = 4410;
+
+    std::array<ChannelState, kMaxChannels> channels;
+    juce::int64 streamPosition = 0;
+    juce::int64 blockPosition = 0;
+    juce::int64 blockHostTime = -1;
+
+    std::array<Event, kCapacity> events {};
+    std::atomic<uint32_t> writeIndex { 0 };
+    std::atomic<uint32_t> readIndex { 0 };
+
+    std::array<std::atomic<uint64_t>, kNumKinds> totals {};
+    std::atomic<uint64_t> dropped { 0 };
+    std::atomic<bool> resetRequested { false };
+
+    // Only used by the message thread.
+    std::deque<Event> history;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(StreamMonitor)
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+  Hands complete triggered sweeps from the audio thread to one reader on
+  another thread. A sweep is a run of raw samples that starts at a trigger,
+  at the audio rate, before any gain, clipping or pixel reduction.
+
+  The audio thread writes a sweep bit by bit as the samples come in, but the
+  reader only ever sees whole sweeps: a sweep is published when its last
+  sample has been written. If there's no room for a whole sweep when the
+  trigger fires, that trigger is skipped and counted. Nothing is allocated
+  after construction and nobody waits on a lock.
+*/
+class SweepFifo
+{
+public:
+    struct Sweep
+    {
+        uint32_t start;
+        uint32_t length;
+
+        // Changes whenever the capture settings change in a way that makes
+        // sweeps incompatible with earlier ones.
+        uint32_t generation;
+    };
+
+    // Longest sweep in samples. The ring holds eight sweeps of this length,
+    // or many more short ones.
+    static constexpr int kMaxSweepLength = 1 << 15;
+    static constexpr uint32_t kCapacity = uint32_t(kMaxSweepLength) * 8;
+    static constexpr uint32_t kMaxSweeps = 1024;
+
+    SweepFifo() : samples(kCapacity) {}
+
+    // Only the reader turns this on and off. The audio thread checks it once
+    // per segment.
+    void setEnabled(bool shouldBeEnabled) { enabled.store(shouldBeEnabled); }
+    bool isEnabled() const noexcept { return enabled.load(std::memory_order_relaxed); }
+
+    // Audio thread. Starts a sweep of `length` samples, or returns false if
+    // it wouldn't fit.
+    bool beginSweep(int length, uint32_t generation) noexcept
+    {
+        const auto sweepsUsed = sweepWrite.load(std::memory_order_relaxed) - sweepRead.load(std::memory_order_acquire);
+        const auto samplesUsed = sampleWrite - sampleRead.load(std::memory_order_acquire);
+
+        if (sweepsUsed >= kMaxSweeps || kCapacity - samplesUsed < uint32_t(length)) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        current = { sampleWrite, uint32_t(length), generation };
+        remaining = length;
+        return true;
+    }
+
+    // Audio thread. Appends up to `getRemaining()` samples to the current
+    // sweep, and publishes it once it's complete.
+    void write(const float* source, int numSamples) noexcept
+    {
+        const auto offset = sampleWrite & (kCapacity - 1);
+        const auto first = std::min(uint32_t(numSamples), kCapacity - offset);
+        std::memcpy(samples.data() + offset, source, first * sizeof(float));
+        std::memcpy(samples.data(), source + first, (uint32_t(numSamples) - first) * sizeof(float));
+
+        sampleWrite += uint32_t(numSamples);
+        remaining -= numSamples;
+
+        if (remaining == 0) {
+            const auto write = sweepWrite.load(std::memory_order_relaxed);
+            sweeps[write & (kMaxSweeps - 1)] = current;
+            sweepWrite.store(write + 1, std::memory_order_release);
+        }
+    }
+
+    // Audio thread. Forgets the sweep that's being written, if any.
+    void cancelSweep() noexcept
+    {
+        if (remaining > 0) {
+            sampleWrite = current.start;
+            remaining = 0;
+        }
+    }
+
+    int getRemaining() const noexcept { return remaining; }
+
+    // Reader. Copies the oldest complete sweep into `destination`, which must
+    // have room for kMaxSweepLength samples.
+    bool read(Sweep& sweep, float* destination) noexcept
+    {
+        const auto read = sweepRead.load(std::memory_order_relaxed);
+        if (read == sweepWrite.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        sweep = sweeps[read & (kMaxSweeps - 1)];
+        const auto offset = sweep.start & (kCapacity - 1);
+        const auto first = std::min(sweep.length, kCapacity - offset);
+        std::memcpy(destination, samples.data() + offset, first * sizeof(float));
+        std::memcpy(destination + first, samples.data(), (sweep.length - first) * sizeof(float));
+
+        sampleRead.store(sweep.start + sweep.length, std::memory_order_release);
+        sweepRead.store(read + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Reader. Throws away every complete sweep.
+    void discard() noexcept
+    {
+        const auto write = sweepWrite.load(std::memory_order_acquire);
+        if (sweepRead.load(std::memory_order_relaxed) == write) {
+            return;
+        }
+
+        const auto& last = sweeps[(write - 1) & (kMaxSweeps - 1)];
+        sampleRead.store(last.start + last.length, std::memory_order_release);
+        sweepRead.store(write, std::memory_order_release);
+    }
+
+    // Number of triggers that were skipped because the reader fell behind.
+    uint32_t getDroppedSweeps() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+    static_assert((kMaxSweeps & (kMaxSweeps - 1)) == 0, "capacity must be a power of two");
+
+    std::vector<float> samples;
+    std::array<Sweep, kMaxSweeps> sweeps {};
+
+    std::atomic<bool> enabled { false };
+    std::atomic<uint32_t> dropped { 0 };
+
+    // Written by the reader.
+    alignas(64) std::atomic<uint32_t> sweepRead { 0 };
+    std::atomic<uint32_t> sampleRead { 0 };
+
+    // Written by the audio thread.
+    alignas(64) std::atomic<uint32_t> sweepWrite { 0 };
+    uint32_t sampleWrite = 0;
+    Sweep current {};
+    int remaining = 0;
+};
@@ -0,0 +1,273 @@
+#include "Tracing.h"
+#include "RealtimeCheck.h"
+
+namespace tracing {
+
+namespace {
+// Threads that can record into one trace. Every thread that records gets
+// a ring of its own for the rest of the session, so a host that keeps
+// starting new audio threads will eventually run out. Their events are
+// then dropped.
+constexpr int kMaxThreads = 16;
+constexpr uint32_t kRingCapacity = 4096;
+
+const char* getEventName(EventType type)
+{
+    switch (type) {
+        case EventType::BlockProcessed: return "processBlock";
+        case EventType::TriggerFired: return "trigger";
+        case EventType::FramePublished: return "framePublished";
+        case EventType::Paint: return "paint";
+        case EventType::TimerTick: return "timer";
+    }
+    return "unknown";
+}
+
+const char* getArgumentName(EventType type)
+{
+    switch (type) {
+        case EventType::BlockProcessed: return "samples";
+        case EventType::TriggerFired: return "triggers";
+        case EventType::FramePublished: return "frame";
+        case EventType::Paint:
+        case EventType::TimerTick: break;
+    }
+    return nullptr;
+}
+
+// The first event a thread records tells us what kind of thread it is.
+const char* getThreadName(EventType type)
+{
+    switch (type) {
+        case EventType::BlockProcessed:
+        case EventType::TriggerFired:
+        case EventType::FramePublished: return "audio";
+        case EventType::Paint:
+        case EventType::TimerTick: break;
+    }
+    return "message";
+}
+}
+
+struct Tracer::Record
+{
+    juce::int64 start;
+    juce::int64 duration;     // -1 for instant events
+    juce::int64 argument;
+    EventType type;
+};
+
+// Single producer (the owning thread), single consumer (the session's
+// background thread).
+struct Tracer::ThreadRing
+{
+    std::atomic<juce::Thread::ThreadID> owner { nullptr };
+    EventType firstType = EventType::BlockProcessed;
+
+    std::atomic<uint32_t> writeIndex { 0 };
+    std::atomic<uint32_t> readIndex { 0 };
+    std::atomic<uint32_t> dropped { 0 };
+
+    std::array<Record, kRingCapacity> records;
+
+    void push(const Record& record) noexcept
+    {
+        const auto write = writeIndex.load(std::memory_order_relaxed);
+        if (write - readIndex.load(std::memory_order_acquire) >= kRingCapacity) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        records[write & (kRingCapacity - 1)] = record;
+        writeIndex.store(write + 1, std::memory_order_release);
+    }
+};
+
+/*
+  Everything that only exists while a trace is being written. The rings are
+  allocated up front; the background thread drains them into the file every
+  50 ms.
+*/
+class Tracer::Session : private juce::Thread
+{
+public:
+    explicit Session(std::unique_ptr<juce::FileOutputStream> output)
+        : juce::Thread("mexoscope trace writer"),
+          stream(std::move(output)),
+          startTicks(Tracer::now()),
+          ticksPerMicrosecond(double(juce::Time::getHighResolutionTicksPerSecond()) * 1.0e-6)
+    {
+        stream->writeText("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", false, false, nullptr);
+        writeEvent("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"mexoscope\"}}");
+        startThread();
+    }
+
+    ~Session() override
+    {
+        stopThread(1000);
+        drain();
+        stream->writeText("\n]}\n", false, false, nullptr);
+        stream->flush();
+    }
+
+    // Finds the calling thread's ring, or gives it a free one.
+    ThreadRing* getRing(EventType type) noexcept
+    {
+        const auto thread = juce::Thread::getCurrentThreadId();
+        for (auto& ring : rings) {
+            if (ring.owner.load(std::memory_order_relaxed) == thread) {
+                return &ring;
+            }
+        }
+
+        for (auto& ring : rings) {
+            juce::Thread::ThreadID expected = nullptr;
+            if (ring.owner.load(std::memory_order_relaxed) == nullptr
+                && ring.owner.compare_exchange_strong(expected, thread)) {
+                // Only read by the background thread after it has seen an
+                // event, i.e. after a release-store of writeIndex.
+                ring.firstType = type;
+                return &ring;
+            }
+        }
+        return nullptr;
+    }
+
+private:
+    void run() override
+    {
+        while (!threadShouldExit()) {
+            drain();
+            wait(50);
+        }
+    }
+
+    void drain()
+    {
+        for (size_t t = 0; t < rings.size(); ++t) {
+            auto& ring = rings[t];
+            const auto write = ring.writeIndex.load(std::memory_order_acquire);
+            auto read = ring.readIndex.load(std::memory_order_relaxed);
+            const auto tid = juce::String(int(t) + 1);
+
+            if (write != 0 && !namedThreads[t]) {
+                namedThreads[t] = true;
+                writeEvent("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid
+                           + ",\"args\":{\"name\":\"" + getThreadName(ring.firstType) + "\"}}");
+            }
+
+            for (; read != write; ++read) {
+                writeRecord(ring.records[read & (kRingCapacity - 1)], tid);
+            }
+            ring.readIndex.store(read, std::memory_order_release);
+
+            const auto dropped = ring.dropped.load(std::memory_order_relaxed);
+            if (dropped != reportedDrops[t]) {
+                reportedDrops[t] = dropped;
+                writeEvent("{\"name\":\"dropped events\",\"ph\":\"C\",\"pid\":1,\"tid\":" + tid
+                           + ",\"ts\":" + juce::String(toMicroseconds(Tracer::now()), 1)
+                           + ",\"args\":{\"dropped\":" + juce::String(dropped) + "}}");
+            }
+        }
+        stream->flush();
+    }
+
+    void writeRecord(const Record& record, const juce::String& tid)
+    {
+        juce::String event;
+        event << "{\"name\":\"" << getEventName(record.type) << "\",\"pid\":1,\"tid\":" << tid
+              << ",\"ts\":" << juce::String(toMicroseconds(record.start), 1);
+
+        if (record.duration < 0) {
+            event << ",\"ph\":\"i\",\"s\":\"t\"";
+        } else {
+            event << ",\"ph\":\"X\",\"dur\":" << juce::String(double(record.duration) / ticksPerMicrosecond, 1);
+        }
+
+        if (const char* argumentName = getArgumentName(record.type)) {
+            event << ",\"args\":{\"" << argumentName << "\":" << juce::String(record.argument) << "}";
+        }
+        writeEvent(event + "}");
+    }
+
+    void writeEvent(const juce::String& event)
+    {
+        if (!firstEvent) {
+            stream->writeText(",\n", false, false, nullptr);
+        }
+        firstEvent = false;
+        stream->writeText(event, false, false, nullptr);
+    }
+
+    double toMicroseconds(juce::int64 ticks) const
+    {
+        return double(juce::jmax(juce::int64(0), ticks - startTicks)) / ticksPerMicrosecond;
+    }
+
+    std::array<ThreadRing, kMaxThreads> rings;
+
+    // Only used by the background thread, and by the destructor once the
+    // background thread has stopped.
+    std::unique_ptr<juce::FileOutputStream> stream;
+    std::array<bool, kMaxThreads> namedThreads {};
+    std::array<uint32_t, kMaxThreads> reportedDrops {};
+    bool firstEvent = true;
+
+    const juce::int64 startTicks;
+    const double ticksPerMicrosecond;
+};
+
+Tracer::Tracer() = default;
+
+Tracer::~Tracer()
+{
+    stop();
+}
+
+bool Tracer::start(const juce::File& newFile)
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    stop();
+
+    newFile.deleteFile();
+    auto output = std::make_unique<juce::FileOutputStream>(newFile);
+    if (!output->openedOk()) {
+        return false;
+    }
+
+    file = newFile;
+    session.publish(new Session(std::move(output)));
+    return true;
+}
+
+void Tracer::stop()
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+    delete session.retire();
+}
+
+void Tracer::recordSpan(EventType type, juce::int64 startTicks, juce::int64 endTicks, juce::int64 argument) noexcept
+{
+    record({ startTicks, juce::jmax(juce::int64(0), endTicks - startTicks), argument, type });
+}
+
+void Tracer::recordInstant(EventType type, juce::int64 argument) noexcept
+{
+    record({ now(), -1, argument, type });
+}
+
+void Tracer::record(const Record& event) noexcept
+{
+    if (session.get(std::memory_order_relaxed) == nullptr) {
+        return;
+    }
+
+    const RetiringPointer<Session>::Reader reader(session);
+    if (auto* current = reader.get()) {
+        if (auto* ring = current->getRing(event.type)) {
+            ring->push(event);
+        }
+    }
+}
+
+}  // namespace tracing
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "RetiringPointer.h"
+
+/*
+  Opt-in timeline tracing, for lining up mexoscope's work with what the host
+  is doing. Events go into per-thread rings and a background thread writes
+  them to a Chrome trace JSON file, which chrome://tracing and the Perfetto
+  UI (ui.perfetto.dev) can open.
+
+  Recording never waits and never allocates: if a ring is full the event is
+  dropped and counted instead, so tracing can stay on during real sessions.
+  When tracing is off, recording an event is a single atomic load.
+*/
+namespace tracing {
+
+enum class EventType : uint8_t
+{
+    BlockProcessed,
+    TriggerFired,
+    FramePublished,
+    Paint,
+    TimerTick,
+};
+
+class Tracer
+{
+public:
+    Tracer();
+    ~Tracer();
+
+    // Starts writing a new trace into `file`, replacing it. Message thread only.
+    bool start(const juce::File& file);
+    void stop();
+
+    bool isRecording() const { return session.get(std::memory_order_relaxed) != nullptr; }
+    const juce::File& getFile() const { return file; }
+
+    // These can be called from any thread. `argument` is shown with the
+    // event; what it means depends on the event type.
+    void recordSpan(EventType type, juce::int64 startTicks, juce::int64 endTicks, juce::int64 argument = 0) noexcept;
+    void recordInstant(EventType type, juce::int64 argument = 0) noexcept;
+
+    static juce::int64 now() noexcept { return juce::Time::getHighResolutionTicks(); }
+
+private:
+    struct Record;
+    struct ThreadRing;
+    class Session;
+
+    void record(const Record& record) noexcept;
+
+    RetiringPointer<Session> session;
+    juce::File file;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(Tracer)
+};
+
+// Records the scope it lives in as one span.
+class ScopedSpan
+{
+public:
+    ScopedSpan(Tracer& t, EventType eventType, juce::int64 eventArgument = 0) noexcept
+        : tracer(t), type(eventType), argument(eventArgument), active(t.isRecording()),
+          start(active ? Tracer::now() : 0)
+    {
+    }
+
+    ~ScopedSpan()
+    {
+        if (active) {
+            tracer.recordSpan(type, start, Tracer::now(), argument);
+        }
+    }
+
+private:
+    Tracer& tracer;
+    EventType type;
+    juce::int64 argument;
+    bool active;
+    juce::int64 start;
+
+    JUCE_DECLARE_NON_COPYABLE(ScopedSpan)
+};
+
+}  // namespace tracing
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+/*
+  Counts what the trigger does and hands the time of every trigger from the
+  audio thread to one reader on another thread, for the trigger statistics.
+
+  The times are in samples, with the fraction of a sample where the signal
+  actually crossed the trigger level, counted along the captured samples
+  (like the sample history) so that they only ever go up. Where capturing
+  stopped and started again, or the reader fell behind and triggers were
+  lost, the log has a gap: the interval across it means nothing.
+
+  Logging a trigger is a store and an index update, and the triggers that
+  the retrigger limit held back are counted per chunk, so this is cheap
+  enough to always be on. Nothing is allocated and nobody waits.
+*/
+class TriggerLog
+{
+public:
+    static constexpr uint32_t kCapacity = 4096;
+
+    // Audio thread. A trigger that was accepted at `time`.
+    void addTrigger(double time) noexcept
+    {
+        // A trigger that doesn't fit leaves a gap.
+        if (gapPending) {
+            gapPending = !push(kGap);
+        }
+        if (!gapPending) {
+            gapPending = !push(time);
+        }
+        accepted.store(accepted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Audio thread. Edges that came too soon after a trigger.
+    void addRejected(uint32_t count) noexcept
+    {
+        if (count > 0) {
+            rejected.store(rejected.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+        }
+    }
+
+    // Audio thread. The next trigger doesn't follow on from the last one.
+    void addGap() noexcept { gapPending = true; }
+
+    // Any thread. Totals since the plug-in was loaded.
+    uint64_t getNumAccepted() const noexcept { return accepted.load(std::memory_order_relaxed); }
+    uint64_t getNumRejected() const noexcept { return rejected.load(std::memory_order_relaxed); }
+
+    // Reader. Takes the oldest trigger time, or a gap, which `isGap` tells
+    // apart. Returns false if there's nothing to read.
+    bool read(double& time) noexcept
+    {
+        const auto position = readIndex.load(std::memory_order_relaxed);
+        if (position == writeIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        time = times[position & (kCapacity - 1)];
+        readIndex.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    static bool isGap(double time) noexcept { return std::isnan(time); }
+
+private:
+    static_assert((kCapacity & (kCapacity - 1)) == 0, "capacity must be a power of two");
+
+    static constexpr double kGap = std::numeric_limits<double>::quiet_NaN();
+
+    bool push(double time) noexcept
+    {
+        const auto position = writeIndex.load(std::memory_order_relaxed);
+        if (position - readIndex.load(std::memory_order_acquire) >= kCapacity) {
+            return false;
+        }
+
+        times[position & (kCapacity - 1)] = time;
+        writeIndex.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    std::array<double, kCapacity> times {};
+    std::atomic<uint32_t> writeIndex { 0 };
+    std::atomic<uint32_t> readIndex { 0 };
+
+    std::atomic<uint64_t> accepted { 0 };
+    std::atomic<uint64_t> rejected { 0 };
+
+    // Only used by the audio thread.
+    bool gapPending = true;
+};
@@ -0,0 +1,99 @@
+#include "TriggerStatistics.h"
+
+TriggerStatistics::TriggerStatistics(Mexoscope& m)
+    : juce::Thread("mexoscope trigger statistics"), mexoscope(m), log(m.getTriggerLog())
+{
+    startThread();
+}
+
+TriggerStatistics::~TriggerStatistics()
+{
+    stopThread(1000);
+}
+
+TriggerStatistics::Stats TriggerStatistics::getStats() const
+{
+    const juce::SpinLock::ScopedLockType lock(statsLock);
+    return stats;
+}
+
+void TriggerStatistics::run()
+{
+    while (!threadShouldExit()) {
+        if (resetRequested.exchange(false)) {
+            numPeriods = 0;
+            nextPeriod = 0;
+            haveLastTime = false;
+            acceptedAtReset = log.getNumAccepted();
+            rejectedAtReset = log.getNumRejected();
+        }
+
+        double time;
+        while (log.read(time)) {
+            if (TriggerLog::isGap(time)) {
+                haveLastTime = false;
+            } else {
+                addTrigger(time);
+            }
+        }
+
+        publish();
+        wait(20);
+    }
+}
+
+void TriggerStatistics::addTrigger(double time)
+{
+    if (haveLastTime) {
+        periods[size_t(nextPeriod)] = time - lastTime;
+        nextPeriod = (nextPeriod + 1) % kWindow;
+        numPeriods = juce::jmin(numPeriods + 1, kWindow);
+    }
+    lastTime = time;
+    haveLastTime = true;
+}
+
+void TriggerStatistics::publish()
+{
+    Stats result;
+    result.numAccepted = log.getNumAccepted() - acceptedAtReset;
+    result.numRejected = log.getNumRejected() - rejectedAtReset;
+
+    const double sampleRate = mexoscope.getSampleRate();
+    if (numPeriods > 0 && sampleRate > 0.0) {
+        double sum = 0.0, shortest = periods[0], longest = periods[0];
+        for (int i = 0; i < numPeriods; ++i) {
+            sum += periods[size_t(i)];
+            shortest = juce::jmin(shortest, periods[size_t(i)]);
+            longest = juce::jmax(longest, periods[size_t(i)]);
+        }
+        const double mean = sum / double(numPeriods);
+
+        double squares = 0.0;
+        for (int i = 0; i < numPeriods; ++i) {
+            squares += (periods[size_t(i)] - mean) * (periods[size_t(i)] - mean);
+        }
+        const double stdDev = std::sqrt(squares / double(numPeriods));
+
+        // Eight standard deviations across, but no finer than a hundredth
+        // of a sample, so a steady clock lands in the middle bin.
+        const double binWidth = juce::jmax(8.0 * stdDev / double(kNumBins), 0.01);
+        for (int i = 0; i < numPeriods; ++i) {
+            const int bin = kNumBins / 2 + int(std::floor((periods[size_t(i)] - mean) / binWidth + 0.5));
+            result.histogram[size_t(juce::jlimit(0, kNumBins - 1, bin))]++;
+        }
+
+        result.numPeriods = numPeriods;
+        result.periodMean = mean / sampleRate;
+        result.rate = (mean > 0.0) ? sampleRate / mean : 0.0;
+        result.periodStdDev = stdDev / sampleRate;
+        result.jitterPeakToPeak = (longest - shortest) / sampleRate;
+        result.binWidth = binWidth / sampleRate;
+    }
+
+    periodMean.store(result.periodMean, std::memory_order_relaxed);
+    periodStdDev.store(result.periodStdDev, std::memory_order_relaxed);
+
+    const juce::SpinLock::ScopedLockType lock(statsLock);
+    stats = result;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Mexoscope.h"
+
+/*
+  Turns the trigger log into statistics: how often the trigger fires, the
+  mean and spread of the period between triggers, and a histogram of how
+  far each period is off the mean, the jitter. With the sub-sample trigger
+  times, a steady clock shows a jitter well under a sample.
+
+  The audio thread only logs the trigger times, see TriggerLog.h. A
+  background thread reads them every few milliseconds and works out the
+  statistics over the last `kWindow` periods, so they follow a clock that
+  drifts. The counts of triggers that fired and that the retrigger limit
+  held back go back to the last reset.
+*/
+class TriggerStatistics : private juce::Thread
+{
+public:
+    static constexpr int kWindow = 1024;
+    static constexpr int kNumBins = 33;
+
+    struct Stats
+    {
+        uint64_t numAccepted = 0;
+        uint64_t numRejected = 0;
+
+        // Over the last `numPeriods` periods, in seconds and per second. All
+        // zero until there are two triggers in a row.
+        int numPeriods = 0;
+        double rate = 0.0;
+        double periodMean = 0.0;
+        double periodStdDev = 0.0;
+        double jitterPeakToPeak = 0.0;
+
+        // Periods per bin. The middle bin is centred on the mean, every bin
+        // is `binWidth` seconds wide, and the outer bins also count
+        // everything beyond them.
+        std::array<uint32_t, kNumBins> histogram {};
+        double binWidth = 0.0;
+    };
+
+    explicit TriggerStatistics(Mexoscope& mexoscope);
+    ~TriggerStatistics() override;
+
+    // Any thread.
+    Stats getStats() const;
+
+    // Audio thread too, for the export. The mean and standard deviation of
+    // the period, in seconds.
+    double getPeriodMean() const { return periodMean.load(std::memory_order_relaxed); }
+    double getPeriodStdDev() const { return periodStdDev.load(std::memory_order_relaxed); }
+
+    // Any thread. Starts the statistics over.
+    void reset() { resetRequested.store(true); }
+
+private:
+    void run() override;
+
+    // Adds the trigger at `time`, in samples.
+    void addTrigger(double time);
+
+    void publish();
+
+    Mexoscope& mexoscope;
+    TriggerLog& log;
+
+    // Only used by the background thread.
+    std::array<double, kWindow> periods {};
+    int numPeriods = 0;
+    int nextPeriod = 0;
+    double lastTime = 0.0;
+    bool haveLastTime = false;
+    uint64_t acceptedAtReset = 0;
+    uint64_t rejectedAtReset = 0;
+
+    std::atomic<bool> resetRequested { false };
+    std::atomic<double> periodMean { 0.0 };
+    std::atomic<double> periodStdDev { 0.0 };
+
+    mutable juce::SpinLock statsLock;
+    Stats stats;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TriggerStatistics)
+};
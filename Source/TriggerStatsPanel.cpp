@@ -0,0 +1,83 @@
+#include "TriggerStatsPanel.h"
+#include "UiTheme.h"
+
+namespace {
+constexpr int kLineHeight = 15;
+constexpr int kPadding = 8;
+
+juce::String formatSeconds(double seconds)
+{
+    if (seconds >= 1.0) {
+        return juce::String(seconds, 3) + " s";
+    }
+    if (seconds >= 1.0e-3) {
+        return juce::String(seconds * 1.0e3, 3) + " ms";
+    }
+    return juce::String(seconds * 1.0e6, seconds >= 1.0e-5 ? 1 : 3) + " us";
+}
+}
+
+TriggerStatsPanel::TriggerStatsPanel(TriggerStatistics& s)
+    : statistics(s)
+{
+}
+
+void TriggerStatsPanel::update()
+{
+    stats = statistics.getStats();
+    repaint();
+}
+
+void TriggerStatsPanel::paint(juce::Graphics& g)
+{
+    const auto bounds = getLocalBounds().toFloat();
+    g.setColour(ui::kPanelColour.withAlpha(0.9f));
+    g.fillRoundedRectangle(bounds, 6.0f);
+    g.setColour(ui::kPanelEdgeColour);
+    g.drawRoundedRectangle(bounds.reduced(0.5f), 6.0f, 1.0f);
+
+    auto area = getLocalBounds().reduced(kPadding);
+    g.setFont(ui::monoFont());
+
+    g.setColour(stats.numRejected > 0 ? ui::kAccentColour : ui::kTextColour);
+    g.drawText(juce::String(juce::int64(stats.numAccepted)) + " fired, " + juce::String(juce::int64(stats.numRejected))
+                   + " held back",
+               area.removeFromTop(kLineHeight), juce::Justification::centredLeft, false);
+
+    if (stats.numPeriods == 0) {
+        g.setColour(ui::kMutedTextColour);
+        g.drawText("no period yet", area.removeFromTop(kLineHeight), juce::Justification::centredLeft, false);
+        return;
+    }
+
+    g.setColour(ui::kTextColour);
+    g.drawText("rate   " + juce::String(stats.rate, 3) + " Hz", area.removeFromTop(kLineHeight),
+               juce::Justification::centredLeft, false);
+    g.drawText("period " + formatSeconds(stats.periodMean), area.removeFromTop(kLineHeight),
+               juce::Justification::centredLeft, false);
+    g.drawText("jitter " + formatSeconds(stats.periodStdDev) + " rms, " + formatSeconds(stats.jitterPeakToPeak) + " p-p",
+               area.removeFromTop(kLineHeight), juce::Justification::centredLeft, false);
+
+    // The histogram, with the mean in the middle. The bars are scaled to
+    // the fullest bin.
+    area.removeFromTop(4);
+    const auto plot = area.toFloat();
+    const uint32_t fullest = *std::max_element(stats.histogram.begin(), stats.histogram.end());
+    const float barWidth = plot.getWidth() / float(TriggerStatistics::kNumBins);
+
+    g.setColour(ui::kScopeBackgroundColour);
+    g.fillRect(plot);
+    g.setColour(ui::kWaveInterpolatedColour);
+    for (int bin = 0; bin < TriggerStatistics::kNumBins; ++bin) {
+        const float height = (fullest > 0) ? plot.getHeight() * float(stats.histogram[size_t(bin)]) / float(fullest) : 0.0f;
+        g.fillRect(plot.getX() + float(bin) * barWidth + 0.5f, plot.getBottom() - height, barWidth - 1.0f, height);
+    }
+
+    g.setColour(ui::kMutedTextColour);
+    g.drawText(formatSeconds(stats.binWidth) + "/bin", area.reduced(2, 0), juce::Justification::topRight, false);
+}
+
+void TriggerStatsPanel::mouseDown(const juce::MouseEvent&)
+{
+    statistics.reset();
+}
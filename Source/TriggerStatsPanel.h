@@ -0,0 +1,31 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "TriggerStatistics.h"
+
+/*
+  Small overlay with the trigger statistics: how many triggers fired and
+  how many edges the retrigger limit held back, the trigger rate, the mean
+  and standard deviation of the period, and the jitter histogram. Clicking
+  the panel starts the statistics over.
+*/
+class TriggerStatsPanel : public juce::Component
+{
+public:
+    explicit TriggerStatsPanel(TriggerStatistics& statistics);
+
+    // Reads the statistics again. Call this from the editor's timer.
+    void update();
+
+    void paint(juce::Graphics& g) override;
+    void mouseDown(const juce::MouseEvent& event) override;
+
+    static constexpr int kPreferredWidth = 240;
+    static constexpr int kPreferredHeight = 128;
+
+private:
+    TriggerStatistics& statistics;
+    TriggerStatistics::Stats stats;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(TriggerStatsPanel)
+};
@@ -15,6 +15,8 @@ inline const juce::Colour kWaveDenseColour { 0xFF8A939C };
 inline const juce::Colour kScopeBackgroundColour { 0xFF151A20 };
 inline const juce::Colour kScopeGridColour { 0xFF242C35 };
 inline const juce::Colour kTriggerLineColour { 0xFF5A646E };
+inline const juce::Colour kMaskColour { 0xFFE0584F };
+inline const juce::Colour kOverColour { 0xFFFF3B30 };
 
 inline constexpr int kOuterPadding = 16;
 inline constexpr int kSectionPadding = 12;
@@ -8,8 +8,8 @@ float mapVirtualYToScope(const juce::Rectangle<float>& scopeArea, const float vi
 }
 }
 
-WaveDisplay::WaveDisplay(Mexoscope& mexoscope)
-    : effect(mexoscope)
+WaveDisplay::WaveDisplay(Mexoscope& mexoscope, const SignalAverager& averagerToUse, tracing::Tracer& tracerToUse)
+    : effect(mexoscope), averager(averagerToUse), tracer(tracerToUse), reconstructor(mexoscope)
 {
 }
 
@@ -53,6 +53,112 @@ float WaveDisplay::scopeYToLinear(const float yInScope) const
     return (-2.0f * (virtualY + 1.0f) / float(OSC_HEIGHT) + 1.0f) / gain;
 }
 
+bool WaveDisplay::readExactMetrics(bool fromCopy, double samplesPerPixel, CursorMetrics& metrics,
+                                   juce::Point<float>& snapped) const
+{
+    const auto scope = getScopeArea();
+    if (scope.getWidth() <= 1.0f) {
+        return false;
+    }
+
+    // Zoomed in, every column is one sample and the columns are spread out
+    // over the screen.
+    const float virtualX = (float(where.x) - scope.getX()) / scope.getWidth() * float(OSC_WIDTH);
+    const int column = (samplesPerPixel < 1.0) ? int(std::lround(double(virtualX) * samplesPerPixel)) : int(virtualX);
+
+    juce::int64 begin = 0, end = 0, frameStart = 0;
+    SampleHistory::Extremes extremes;
+    if (!effect.getColumnSamples(fromCopy, column, begin, end, frameStart)
+        || !effect.getHistory().findExtremes(begin, end, extremes)) {
+        return false;
+    }
+
+    const bool useMax = std::abs(extremes.maximum - metrics.yLinear) <= std::abs(extremes.minimum - metrics.yLinear);
+    const float value = useMax ? extremes.maximum : extremes.minimum;
+    const auto position = useMax ? extremes.maximumPosition : extremes.minimumPosition;
+
+    metrics.exact = true;
+    metrics.columnMin = extremes.minimum;
+    metrics.columnMax = extremes.maximum;
+    metrics.yLinear = value;
+    metrics.yDb = linToDb(value);
+    metrics.xSamples = float(position - frameStart);
+    metrics.xSeconds = metrics.xSamples / float(effect.getSampleRate());
+    metrics.xMs = metrics.xSeconds * 1000.0f;
+    metrics.infiniteHz = (metrics.xSamples <= 0.0f);
+    metrics.xHz = metrics.infiniteHz ? 0.0f : float(effect.getSampleRate()) / metrics.xSamples;
+
+    // Where that sample is drawn, the same way `captureChunk` scales it.
+    const float gain = std::pow(10.0f, effect.getParameter(Mexoscope::kAmpWindow) * 6.0f - 3.0f);
+    const float columnX = (samplesPerPixel < 1.0) ? float(double(column) / samplesPerPixel) : float(column) + 0.5f;
+    const float virtualY = float(OSC_CENTER) - clip(value * gain, 1.0f) * float(OSC_CENTER);
+    snapped = { scope.getX() + columnX / float(OSC_WIDTH) * scope.getWidth(), mapVirtualYToScope(scope, virtualY) };
+    return true;
+}
+
+void WaveDisplay::renderWaveform(const Mexoscope::PeaksArray& points, const Mexoscope::OversArray* overs,
+                                 double samplesPerPixel, float lineWidth, float fromX, float toX)
+{
+    const float pixelsPerX = float(waveformImage.getWidth()) / float(OSC_WIDTH);
+    const int left = juce::jmax(0, int(std::floor(fromX * pixelsPerX)) - 1);
+    const int right = juce::jmin(waveformImage.getWidth(), int(std::ceil(toX * pixelsPerX)) + 1);
+    if (right <= left) {
+        return;
+    }
+
+    const juce::Rectangle<int> area(left, 0, right - left, waveformImage.getHeight());
+    waveformImage.clear(area);
+
+    juce::Graphics g(waveformImage);
+    g.reduceClipRegion(area);
+    g.addTransform(juce::AffineTransform::scale(pixelsPerX, float(waveformImage.getHeight()) / float(OSC_HEIGHT)));
+
+    // Everything that reaches into the area, with some room for the lines'
+    // width and antialiasing.
+    const int first = juce::jmax(0, int(float(left) / pixelsPerX) - 2);
+    const int last = juce::jmin(OSC_WIDTH, int(float(right) / pixelsPerX) + 3);
+
+    if (samplesPerPixel < 1.0) {
+        g.setColour(ui::kWaveInterpolatedColour);
+
+        const auto interpolate = [&points, samplesPerPixel](int x) {
+            const double phase = double(x) * samplesPerPixel;
+            const size_t index = size_t(phase);
+            const double alpha = phase - double(index);
+            return (1.0 - alpha) * points[index * 2].y + alpha * points[(index + 1) * 2].y;
+        };
+
+        double prevY = interpolate(juce::jmax(0, first - 1));
+        for (int x = juce::jmax(1, first); x < last; ++x) {
+            const double y = interpolate(x);
+            g.drawLine(float(x - 1), float(prevY), float(x), float(y), lineWidth);
+            prevY = y;
+        }
+    } else {
+        g.setColour(ui::kWaveDenseColour);
+
+        for (size_t i = size_t(first) * 2; i < size_t(last) * 2 && i < points.size() - 1; ++i) {
+            const auto p1 = points[i];
+            const auto p2 = points[i + 1];
+            g.drawLine(float(p1.x), float(p1.y), float(p1.x), float(p2.y), lineWidth);
+        }
+
+        // Columns where the true peaks went over full scale are drawn again
+        // in red, with a mark at the top of the scope.
+        if (overs != nullptr) {
+            g.setColour(ui::kOverColour);
+            for (int column = first; column < last; ++column) {
+                if ((*overs)[size_t(column)] != 0) {
+                    const auto p1 = points[size_t(column * 2)];
+                    const auto p2 = points[size_t(column * 2 + 1)];
+                    g.drawLine(float(column), float(p1.y), float(column), float(p2.y), lineWidth);
+                    g.fillRect(float(column), 0.0f, 1.0f, 4.0f);
+                }
+            }
+        }
+    }
+}
+
 void WaveDisplay::mouseDown(const juce::MouseEvent& event)
 {
     if (event.mods.isLeftButtonDown() && event.originalComponent == this) {
@@ -80,8 +186,26 @@ std::optional<WaveDisplay::CursorMetrics> WaveDisplay::getCursorMetrics() const
     return cursorMetrics;
 }
 
+void WaveDisplay::setFrameOverride(const Mexoscope::PeaksArray* frame, const Mexoscope::PeaksArray* envelope)
+{
+    frameOverride = frame;
+    envelopeOverride = envelope;
+}
+
+void WaveDisplay::setMask(const MaskTest::Mask* newMask)
+{
+    if (newMask != nullptr) {
+        mask = *newMask;
+    } else {
+        mask.reset();
+    }
+}
+
 void WaveDisplay::paint(juce::Graphics& g)
 {
+    MEXOSCOPE_PROBE(paintProbe);
+    const tracing::ScopedSpan span(tracer, tracing::EventType::Paint);
+
     const auto bounds = getLocalBounds().toFloat();
     const auto scopeArea = getScopeArea();
 
@@ -117,54 +241,126 @@ void WaveDisplay::paint(juce::Graphics& g)
     g.setColour(ui::kZeroLineColour);
     g.drawHorizontalLine(int(mapVirtualYToScope(scopeArea, float(OSC_CENTER))), scopeArea.getX(), scopeArea.getRight());
 
-    const auto& points = (effect.getParameter(Mexoscope::kSyncDraw) > 0.5f) ? effect.getCopy() : effect.getPeaks();
-    const double samplesPerPixel = std::pow(10.0, effect.getParameter(Mexoscope::kTimeWindow) * 5.0 - 1.5);
+    const bool syncDraw = (effect.getParameter(Mexoscope::kSyncDraw) > 0.5f);
+    const auto* frame = syncDraw ? &effect.getCopy() : &effect.getPeaks();
+    const auto* liveFrame = frame;
+    const auto* overs = syncDraw ? &effect.getOversCopy() : &effect.getOvers();
+
+    // A stored frame replaces the live one. While averaging, show the
+    // average once there is one. Neither of them has overs.
+    if (frameOverride != nullptr) {
+        frame = frameOverride;
+        overs = nullptr;
+    } else if (averager.getMode() != SignalAverager::Mode::Off) {
+        const int numAveraged = averager.getFrame(averagedFrame);
+        if (numAveraged > 0) {
+            frame = &averagedFrame;
+            overs = nullptr;
+        }
 
-    juce::Graphics::ScopedSaveState waveformState(g);
-    g.reduceClipRegion(scopeArea.getSmallestIntegerContainer());
+        const auto prefix = (averager.getMode() == SignalAverager::Mode::Linear) ? "Average " : "Exp. average ";
+        g.setColour(ui::kMutedTextColour);
+        g.setFont(ui::monoFont());
+        g.drawText(prefix + juce::String(numAveraged) + "/" + juce::String(averager.getNumSweeps()),
+                   scopeArea.reduced(8.0f, 4.0f).removeFromTop(16.0f), juce::Justification::topLeft, false);
+    }
+
+    const auto& points = *frame;
+    const double samplesPerPixel = std::pow(10.0, effect.getParameter(Mexoscope::kTimeWindow) * 5.0 - 1.5);
 
     const float xScale = scopeArea.getWidth() / float(OSC_WIDTH);
     const float yScale = scopeArea.getHeight() / float(OSC_HEIGHT);
-    auto transform = juce::AffineTransform::translation(scopeArea.getX(), scopeArea.getY())
-        .scaled(xScale, yScale);
-    g.addTransform(transform);
-
-    if (samplesPerPixel < 1.0) {
-        g.setColour(ui::kWaveInterpolatedColour);
-
-        double phase = samplesPerPixel;
-        const double dPhase = samplesPerPixel;
+    const float lineWidth = 1.0f / juce::jmax(1.0f, xScale);
+    const float gain = std::pow(10.0f, effect.getParameter(Mexoscope::kAmpWindow) * 6.0f - 3.0f);
 
-        double prevX = points[0].x;
-        double prevY = points[0].y;
+    // The envelope and the mask are drawn under the waveform, in the virtual
+    // coordinates of the peaks.
+    if (envelopeOverride != nullptr || mask.has_value()) {
+        juce::Graphics::ScopedSaveState virtualState(g);
+        g.addTransform(juce::AffineTransform::scale(xScale, yScale).translated(scopeArea.getX(), scopeArea.getY()));
+
+        if (envelopeOverride != nullptr) {
+            g.setColour(ui::kWaveDenseColour.withAlpha(0.35f));
+            for (size_t i = 0; i < envelopeOverride->size(); i += 2) {
+                const auto top = (*envelopeOverride)[i];
+                const auto bottom = (*envelopeOverride)[i + 1];
+                g.fillRect(float(top.x), float(top.y), 1.0f, float(bottom.y - top.y + 1));
+            }
+        }
 
-        for (int i = 1; i < OSC_WIDTH; ++i) {
-            const size_t index = size_t(phase);
-            const double alpha = phase - double(index);
-            const double x = i;
-            const double y = (1.0 - alpha) * points[index * 2].y + alpha * points[(index + 1) * 2].y;
+        if (mask.has_value()) {
+            juce::Path top, bottom;
+            top.startNewSubPath(0.0f, float(mask->top[0]));
+            bottom.startNewSubPath(0.0f, float(mask->bottom[0]));
+            for (int column = 1; column < OSC_WIDTH; ++column) {
+                top.lineTo(float(column), float(mask->top[size_t(column * 2)]));
+                bottom.lineTo(float(column), float(mask->bottom[size_t(column * 2)]));
+            }
+
+            g.setColour(ui::kMaskColour.withAlpha(0.8f));
+            g.strokePath(top, juce::PathStrokeType(lineWidth));
+            g.strokePath(bottom, juce::PathStrokeType(lineWidth));
+        }
+    }
 
-            g.drawLine(float(prevX), float(prevY), float(x), float(y), 1.0f / juce::jmax(1.0f, xScale));
-            prevX = x;
-            prevY = y;
+    // Bring the waveform image up to date. The changes are taken on every
+    // paint, so they don't pile up while another frame is shown.
+    const auto changes = effect.takeChanges();
+    const float pixelScale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    const int imageWidth = juce::roundToInt(scopeArea.getWidth() * pixelScale);
+    const int imageHeight = juce::roundToInt(scopeArea.getHeight() * pixelScale);
+
+    if (imageWidth > 0 && imageHeight > 0) {
+        bool redrawAll = (frame != liveFrame || frame != imageFrame || samplesPerPixel != imageSamplesPerPixel);
+        if (!waveformImage.isValid() || waveformImage.getWidth() != imageWidth || waveformImage.getHeight() != imageHeight) {
+            waveformImage = juce::Image(juce::Image::ARGB, imageWidth, imageHeight, true);
+            redrawAll = true;
+        }
 
-            phase += dPhase;
+        if (redrawAll) {
+            waveformImage.clear(waveformImage.getBounds());
+            renderWaveform(points, overs, samplesPerPixel, lineWidth, 0.0f, float(OSC_WIDTH));
+        } else if (samplesPerPixel < 1.0) {
+            // Zoomed in, the reconstruction below takes care of the changes.
+        } else if (syncDraw && changes.copy) {
+            waveformImage.clear(waveformImage.getBounds());
+            renderWaveform(points, overs, samplesPerPixel, lineWidth, 0.0f, float(OSC_WIDTH));
+        } else if (!syncDraw && changes.end > changes.begin) {
+            // A column is drawn up to the top of the next one, so the one
+            // before the changes changed too.
+            renderWaveform(points, overs, samplesPerPixel, lineWidth, float(changes.begin - 1), float(changes.end));
         }
-    } else {
-        g.setColour(ui::kWaveDenseColour);
 
-        for (size_t i = 0; i < points.size() - 1; ++i) {
-            const auto p1 = points[i];
-            const auto p2 = points[i + 1];
-            g.drawLine(float(p1.x), float(p1.y), float(p1.x), float(p2.y), 1.0f / juce::jmax(1.0f, xScale));
+        // Zoomed in on the live frame, the signal between the samples is
+        // rebuilt in the background. Until it's done, the straight lines
+        // from above stay on screen.
+        if (samplesPerPixel < 1.0 && frame == liveFrame) {
+            const bool frameChanged = syncDraw ? changes.copy : (changes.end > changes.begin);
+            const WaveformReconstructor::Request wanted { syncDraw, samplesPerPixel, gain, imageWidth };
+            if (redrawAll || frameChanged || !(wanted == reconstructionRequest)) {
+                reconstructor.request(wanted);
+                reconstructionRequest = wanted;
+            }
+
+            WaveformReconstructor::Request done;
+            if (reconstructor.getPath(reconstructionSerial, reconstructedPath, done) && done == wanted) {
+                waveformImage.clear(waveformImage.getBounds());
+                juce::Graphics imageGraphics(waveformImage);
+                imageGraphics.addTransform(juce::AffineTransform::scale(float(imageWidth) / float(OSC_WIDTH),
+                                                                        float(imageHeight) / float(OSC_HEIGHT)));
+                imageGraphics.setColour(ui::kWaveInterpolatedColour);
+                imageGraphics.strokePath(reconstructedPath, juce::PathStrokeType(lineWidth));
+            }
         }
+
+        imageFrame = frame;
+        imageSamplesPerPixel = samplesPerPixel;
+
+        g.setOpacity(1.0f);
+        g.drawImage(waveformImage, scopeArea);
     }
 
     if (where.x >= 0 && where.y >= 0) {
-        g.setColour(ui::kTextColour.withAlpha(0.85f));
-        g.drawHorizontalLine(int(where.y), scopeArea.getX(), scopeArea.getRight());
-        g.drawVerticalLine(int(where.x), scopeArea.getY(), scopeArea.getBottom());
-
         CursorMetrics metrics;
         metrics.xSamples = scopeXToSamples(float(where.x), samplesPerPixel);
         metrics.xSeconds = metrics.xSamples / float(effect.getSampleRate());
@@ -173,7 +369,25 @@ void WaveDisplay::paint(juce::Graphics& g)
         metrics.xHz = metrics.infiniteHz ? 0.0f : float(effect.getSampleRate()) / metrics.xSamples;
         metrics.yLinear = scopeYToLinear(float(where.y));
         metrics.yDb = linToDb(metrics.yLinear);
+
+        // The live frame and its copy have the raw samples behind them.
+        auto snapped = where.toFloat();
+        if (frame == liveFrame) {
+            readExactMetrics(syncDraw, samplesPerPixel, metrics, snapped);
+        }
         cursorMetrics = metrics;
+
+        g.setColour(ui::kTextColour.withAlpha(0.85f));
+        g.drawHorizontalLine(int(snapped.y), scopeArea.getX(), scopeArea.getRight());
+        g.drawVerticalLine(int(where.x), scopeArea.getY(), scopeArea.getBottom());
+
+        if (metrics.exact) {
+            g.fillEllipse(juce::Rectangle<float>(7.0f, 7.0f).withCentre(snapped));
+            g.setColour(ui::kMutedTextColour);
+            g.setFont(ui::monoFont());
+            g.drawText("min " + juce::String(metrics.columnMin, 5) + "  max " + juce::String(metrics.columnMax, 5),
+                       scopeArea.reduced(8.0f, 4.0f).removeFromBottom(16.0f), juce::Justification::bottomRight, false);
+        }
     } else {
         cursorMetrics.reset();
     }
@@ -4,6 +4,9 @@
 #include <optional>
 #include "Defines.h"
 #include "Mexoscope.h"
+#include "SignalAverager.h"
+#include "Tracing.h"
+#include "WaveformReconstructor.h"
 
 class WaveDisplay : public juce::Component
 {
@@ -17,9 +20,16 @@ public:
         float xMs = 0.0f;
         float xHz = 0.0f;
         bool infiniteHz = false;
+
+        // Set when the values come from the sample history rather than the
+        // pixel position. The cursor then sits on the sample nearest to it
+        // of the column's smallest and largest samples, which are below.
+        bool exact = false;
+        float columnMin = 0.0f;
+        float columnMax = 0.0f;
     };
 
-    explicit WaveDisplay(Mexoscope& effect);
+    WaveDisplay(Mexoscope& effect, const SignalAverager& averager, tracing::Tracer& tracer);
 
     void paint(juce::Graphics& g) override;
 
@@ -29,6 +39,19 @@ public:
 
     std::optional<CursorMetrics> getCursorMetrics() const;
 
+    // Shows a stored frame instead of the live one, e.g. a recorded segment,
+    // and optionally an envelope behind it. Both must stay valid until they
+    // are replaced. Pass nullptr to go back to the live frame.
+    void setFrameOverride(const Mexoscope::PeaksArray* frame, const Mexoscope::PeaksArray* envelope);
+
+    // Draws the outline of a mask, or nothing if it's nullptr. The mask is
+    // copied, since the mask test may throw it away at any time.
+    void setMask(const MaskTest::Mask* mask);
+
+#if MEXOSCOPE_INSTRUMENTATION
+    instrumentation::PerfProbe& getPaintProbe() { return paintProbe; }
+#endif
+
 private:
     static float linToDb(float linear);
 
@@ -37,10 +60,46 @@ private:
     float scopeXToSamples(float xInScope, double samplesPerPixel) const;
     float scopeYToLinear(float yInScope) const;
 
+    // Replaces the metrics with the exact values from the sample history,
+    // if it still has the samples of the column under the cursor.
+    bool readExactMetrics(bool fromCopy, double samplesPerPixel, CursorMetrics& metrics, juce::Point<float>& snapped) const;
+
+    // Draws the waveform between two x positions, in the virtual
+    // coordinates of the peaks, into `waveformImage` over what was there.
+    void renderWaveform(const Mexoscope::PeaksArray& points, const Mexoscope::OversArray* overs, double samplesPerPixel,
+                        float lineWidth, float fromX, float toX);
+
     Mexoscope& effect;
+    const SignalAverager& averager;
+    tracing::Tracer& tracer;
+
+    // Redraws the zoomed-in live frame from the raw samples.
+    WaveformReconstructor reconstructor;
+    WaveformReconstructor::Request reconstructionRequest;
+    uint32_t reconstructionSerial = 0;
+    juce::Path reconstructedPath;
+
+    // The averaged frame, copied from the averager for painting.
+    Mexoscope::PeaksArray averagedFrame;
+
+    const Mexoscope::PeaksArray* frameOverride = nullptr;
+    const Mexoscope::PeaksArray* envelopeOverride = nullptr;
+    std::optional<MaskTest::Mask> mask;
+
+    // The waveform is kept in an image between paints, and for the live
+    // frame only the columns the engine changed are drawn again (zoomed in,
+    // the reconstruction once it's ready). The whole image is drawn again
+    // after a trigger, or when the frame shown, the time or the size changes.
+    juce::Image waveformImage;
+    const Mexoscope::PeaksArray* imageFrame = nullptr;
+    double imageSamplesPerPixel = 0.0;
 
     juce::Point<int> where { -1, -1 };
     std::optional<CursorMetrics> cursorMetrics;
 
+#if MEXOSCOPE_INSTRUMENTATION
+    instrumentation::PerfProbe paintProbe;
+#endif
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveDisplay)
 };
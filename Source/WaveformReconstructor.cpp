@@ -0,0 +1,129 @@
+#include "WaveformReconstructor.h"
+#include "RealtimeCheck.h"
+#include <algorithm>
+
+namespace {
+using Lanes = juce::dsp::SIMDRegister<float>;
+
+constexpr int kTaps = Mexoscope::kTruePeakTaps;
+static_assert(kTaps % Lanes::size() == 0, "the taps must fill whole SIMD registers");
+}
+
+WaveformReconstructor::WaveformReconstructor(const Mexoscope& m)
+    : juce::Thread("mexoscope reconstruction"), mexoscope(m)
+{
+    Mexoscope::makeTruePeakFilter(kNumPhases, coefficients.data());
+    startThread();
+}
+
+WaveformReconstructor::~WaveformReconstructor()
+{
+    stopThread(1000);
+}
+
+void WaveformReconstructor::request(const Request& newRequest)
+{
+    MEXOSCOPE_ASSERT_NOT_REALTIME;
+
+    {
+        const juce::SpinLock::ScopedLockType scopedLock(lock);
+        pending = newRequest;
+        hasPending = true;
+    }
+    notify();
+}
+
+bool WaveformReconstructor::getPath(uint32_t& serial, juce::Path& destination, Request& done) const
+{
+    const juce::SpinLock::ScopedLockType scopedLock(lock);
+    if (pathSerial == serial) {
+        return false;
+    }
+
+    destination = path;
+    done = pathRequest;
+    serial = pathSerial;
+    return true;
+}
+
+void WaveformReconstructor::run()
+{
+    while (!threadShouldExit()) {
+        Request job;
+        bool haveJob;
+        {
+            const juce::SpinLock::ScopedLockType scopedLock(lock);
+            job = pending;
+            haveJob = hasPending;
+            hasPending = false;
+        }
+
+        if (!haveJob) {
+            wait(-1);
+            continue;
+        }
+
+        rebuild(job);
+
+        const juce::SpinLock::ScopedLockType scopedLock(lock);
+        path.swapWithPath(scratch);
+        pathRequest = job;
+        pathSerial++;
+    }
+}
+
+void WaveformReconstructor::rebuild(const Request& job)
+{
+    const auto& frame = job.fromCopy ? mexoscope.getCopy() : mexoscope.getPeaks();
+
+    // The samples around the current column, newest first. Phase p of the
+    // filter then lands (p + 0.5) / kNumPhases after the column's sample.
+    alignas(32) std::array<float, kTaps> window;
+    std::array<float, kTaps> samples;
+    int windowColumn = -1;
+    bool haveWindow = false;
+
+    const auto readWindow = [this, &job, &window, &samples](int column) {
+        juce::int64 begin, end, frameStart;
+        if (!mexoscope.getColumnSamples(job.fromCopy, column, begin, end, frameStart) || end - begin != 1
+            || !mexoscope.getHistory().read(begin - (kTaps / 2 - 1), kTaps, samples.data())) {
+            return false;
+        }
+        std::reverse_copy(samples.begin(), samples.end(), window.begin());
+        return true;
+    };
+
+    scratch.clear();
+    scratch.preallocateSpace(3 * job.numPoints);
+
+    for (int point = 0; point < job.numPoints; ++point) {
+        const float x = (job.numPoints > 1) ? float(point) * float(OSC_WIDTH - 1) / float(job.numPoints - 1) : 0.0f;
+        const double phase = double(x) * job.samplesPerPixel;
+        const int column = juce::jmin(int(phase), OSC_WIDTH - 2);
+        const double alpha = phase - double(column);
+
+        if (column != windowColumn) {
+            windowColumn = column;
+            haveWindow = readWindow(column);
+        }
+
+        float y;
+        if (haveWindow) {
+            const float* taps = coefficients.data() + juce::jlimit(0, kNumPhases - 1, int(alpha * kNumPhases)) * kTaps;
+            auto sum = Lanes::expand(0.0f);
+            for (int tap = 0; tap < kTaps; tap += int(Lanes::size())) {
+                sum += Lanes::fromRawArray(taps + tap) * Lanes::fromRawArray(window.data() + tap);
+            }
+            y = float(OSC_CENTER) - clip(sum.sum() * job.gain, 1.0f) * float(OSC_CENTER);
+        } else {
+            // The same straight line as between the peaks.
+            y = float((1.0 - alpha) * frame[size_t(column * 2)].y + alpha * frame[size_t((column + 1) * 2)].y);
+        }
+
+        if (point == 0) {
+            scratch.startNewSubPath(x, y);
+        } else {
+            scratch.lineTo(x, y);
+        }
+    }
+}
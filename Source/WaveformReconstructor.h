@@ -0,0 +1,74 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "Mexoscope.h"
+
+/*
+  Zoomed in, every column of a frame is a single sample and the display
+  spreads them out over the screen. Joining the quantised peaks with straight
+  lines isn't what the signal looks like between the samples, so this
+  rebuilds it from the raw samples in the sample history instead, with the
+  same windowed-sinc interpolator as the true-peak mode at a much finer step.
+
+  All of that happens on a background thread. The display asks for a frame
+  whenever it changed and gets back a path in the virtual coordinates of the
+  peaks, ready to be stroked. Only the latest request is worked on. Columns
+  whose samples aren't in the history, like the newest few while the filter
+  waits for the samples after them, are joined with straight lines.
+*/
+class WaveformReconstructor : private juce::Thread
+{
+public:
+    // The interpolator puts out this many points between two samples, and
+    // picks the nearest one.
+    static constexpr int kNumPhases = 64;
+
+    struct Request
+    {
+        bool fromCopy = false;
+        double samplesPerPixel = 1.0;
+        float gain = 1.0f;
+        int numPoints = 0;
+
+        bool operator==(const Request& other) const
+        {
+            return fromCopy == other.fromCopy && samplesPerPixel == other.samplesPerPixel && gain == other.gain
+                && numPoints == other.numPoints;
+        }
+    };
+
+    explicit WaveformReconstructor(const Mexoscope& mexoscope);
+    ~WaveformReconstructor() override;
+
+    // Message thread. Rebuilds the live frame (or its copy) with these
+    // settings.
+    void request(const Request& newRequest);
+
+    // Message thread. Copies the path of the latest finished request, if it
+    // was finished after `serial`, and updates `serial`.
+    bool getPath(uint32_t& serial, juce::Path& path, Request& done) const;
+
+private:
+    void run() override;
+
+    void rebuild(const Request& job);
+
+    const Mexoscope& mexoscope;
+
+    // `coefficients[phase * kTruePeakTaps + tap]`, tap 0 for the newest
+    // sample, like Mexoscope's true-peak filter.
+    alignas(32) std::array<float, kNumPhases * Mexoscope::kTruePeakTaps> coefficients;
+
+    mutable juce::SpinLock lock;
+    Request pending;
+    bool hasPending = false;
+
+    juce::Path path;
+    Request pathRequest;
+    uint32_t pathSerial = 0;
+
+    // Only used by the background thread.
+    juce::Path scratch;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(WaveformReconstructor)
+};
@@ -0,0 +1,538 @@
+/*
+  Drives MexoscopeAudioProcessor the way a careless host would, and checks
+  that the audio callback never allocates or locks.
+
+  Usage: mexoscope_hostile_host [number of blocks]
+
+  One thread plays the host's audio thread. It uses random block sizes,
+  including 1, sizes that aren't powers of two and now and then blocks
+  larger than announced. Between blocks it changes the sample rate, the
+  precision and the channel layout through releaseResources and
+  prepareToPlay, jumps the transport around and automates random
+  parameters. The input has NaNs, denormals and silence in it.
+
+  The main thread is the message thread. It paints a WaveDisplay as fast as
+  it can, and like an editor it comes and goes as a consumer, switches the
+  averager and the loudness meter, and changes parameters. Tracing is on.
+
+  While the audio thread is inside processBlock, malloc and friends and
+  pthread_mutex_lock count their calls. Any call fails the run, and the
+  first one is shown with a backtrace. A block that took longer to process
+  than it lasts is a deadline miss. Misses are reported but don't fail the
+  run: the machine running this isn't a real-time system.
+
+  Build it with -DMEXOSCOPE_SANITIZE=address or =thread to run it under
+  ASan or TSan. The sanitizers replace malloc themselves, so then operator
+  new is hooked instead. TSan also replaces the mutex functions, so under
+  TSan locks aren't counted; it reports the races that locks would hide.
+*/
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <optional>
+#include <random>
+#include <thread>
+
+#include <cerrno>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "PluginProcessor.h"
+#include "WaveDisplay.h"
+
+#ifndef __has_feature
+ #define __has_feature(x) 0
+#endif
+
+#if defined(__SANITIZE_THREAD__) || __has_feature(thread_sanitizer)
+ #define HOSTILE_HOST_TSAN 1
+#else
+ #define HOSTILE_HOST_TSAN 0
+#endif
+
+#if defined(__SANITIZE_ADDRESS__) || __has_feature(address_sanitizer) || HOSTILE_HOST_TSAN
+ #define HOSTILE_HOST_HOOK_MALLOC 0
+#else
+ #define HOSTILE_HOST_HOOK_MALLOC 1
+#endif
+
+#define HOSTILE_HOST_HOOK_LOCKS (!HOSTILE_HOST_TSAN)
+
+namespace {
+// Set by the audio thread around processBlock. Plain thread_local data in
+// the executable, so reading it from the hooks doesn't allocate.
+thread_local bool inAudioCallback = false;
+thread_local bool inHook = false;
+
+std::atomic<uint64_t> numAllocations { 0 };
+std::atomic<uint64_t> numLocks { 0 };
+
+// The first violation, for the report.
+std::atomic<bool> haveBacktrace { false };
+const char* backtraceKind = "";
+void* backtraceFrames[48];
+int backtraceSize = 0;
+
+void noteViolation(std::atomic<uint64_t>& counter, const char* kind) noexcept
+{
+    if (!inAudioCallback || inHook) {
+        return;
+    }
+
+    inHook = true;
+    counter.fetch_add(1, std::memory_order_relaxed);
+    if (!haveBacktrace.exchange(true)) {
+        backtraceKind = kind;
+        backtraceSize = backtrace(backtraceFrames, 48);
+    }
+    inHook = false;
+}
+
+void noteAllocation() noexcept
+{
+    noteViolation(numAllocations, "allocation");
+}
+}
+
+#if HOSTILE_HOST_HOOK_MALLOC
+// glibc's own entry points, which the replacements below hand on to.
+// Operator new calls malloc, so this catches it too.
+extern "C" {
+void* __libc_malloc(size_t size) noexcept;
+void* __libc_calloc(size_t count, size_t size) noexcept;
+void* __libc_realloc(void* pointer, size_t size) noexcept;
+void* __libc_memalign(size_t alignment, size_t size) noexcept;
+
+void* malloc(size_t size) noexcept
+{
+    noteAllocation();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    noteAllocation();
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) noexcept
+{
+    noteAllocation();
+    return __libc_realloc(pointer, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    noteAllocation();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept
+{
+    noteAllocation();
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    *pointer = __libc_memalign(alignment, size);
+    return (*pointer != nullptr) ? 0 : ENOMEM;
+}
+}
+#else
+// Under a sanitizer, which owns malloc. All of these go to its malloc and
+// free, so nothing is allocated by one and freed by the other. GCC can't
+// see that the two are paired once these are inlined.
+#if defined(__GNUC__) && !defined(__clang__)
+ #pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+    noteAllocation();
+    if (auto* pointer = std::malloc(size > 0 ? size : 1)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    noteAllocation();
+    const auto a = static_cast<std::size_t>(alignment);
+    if (auto* pointer = std::aligned_alloc(a, (std::max(size, std::size_t(1)) + a - 1) / a * a)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return operator new(size, alignment); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    noteAllocation();
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, std::size_t, std::align_val_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+#endif
+
+#if HOSTILE_HOST_HOOK_LOCKS
+// std::mutex and juce::CriticalSection both end up here. The real function
+// is looked up once; dlsym doesn't lock through this symbol.
+extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+{
+    using Function = int (*)(pthread_mutex_t*);
+    static const auto real = reinterpret_cast<Function>(dlsym(RTLD_NEXT, "pthread_mutex_lock"));
+
+    noteViolation(numLocks, "mutex lock");
+    return real(mutex);
+}
+#endif
+
+namespace {
+// A transport that plays, stops, jumps and changes tempo and time
+// signature. Only used on the audio thread.
+class HostilePlayHead : public juce::AudioPlayHead
+{
+public:
+    juce::Optional<PositionInfo> getPosition() const override { return position; }
+
+    void advance(std::mt19937& random, int numSamples, double sampleRate)
+    {
+        std::uniform_int_distribution<int> percent(0, 99);
+
+        if (percent(random) == 0) {
+            playing = !playing;
+        }
+        if (percent(random) == 0) {
+            bpm = std::uniform_real_distribution<double>(20.0, 400.0)(random);
+        }
+        if (percent(random) == 0) {
+            numerator = std::uniform_int_distribution<int>(1, 13)(random);
+            denominator = 1 << std::uniform_int_distribution<int>(0, 4)(random);
+        }
+        if (percent(random) == 0) {
+            // A loop jumping back, or the user clicking somewhere else.
+            samples = std::uniform_int_distribution<juce::int64>(0, juce::int64(sampleRate) * 600)(random);
+        }
+
+        const double quarterNotes = double(samples) / sampleRate * bpm / 60.0;
+        const double barLength = double(numerator) * 4.0 / double(denominator);
+
+        position = PositionInfo();
+        position.setIsPlaying(playing);
+        position.setBpm(bpm);
+        position.setTimeSignature(TimeSignature { numerator, denominator });
+        position.setTimeInSamples(samples);
+        position.setPpqPosition(quarterNotes);
+        position.setPpqPositionOfLastBarStart(std::floor(quarterNotes / barLength) * barLength);
+
+        if (playing) {
+            samples += numSamples;
+        }
+    }
+
+private:
+    PositionInfo position;
+    bool playing = true;
+    double bpm = 120.0;
+    int numerator = 4;
+    int denominator = 4;
+    juce::int64 samples = 0;
+};
+
+struct DeadlineStats
+{
+    uint64_t numBlocks = 0;
+    uint64_t numMisses = 0;
+    double worstRatio = 0.0;
+};
+
+template <typename SampleType>
+void fillInput(juce::AudioBuffer<SampleType>& buffer, int numSamples, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> percent(0, 99);
+
+    const int kind = percent(random);
+    for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
+        auto* samples = buffer.getWritePointer(channel);
+        for (int i = 0; i < numSamples; ++i) {
+            if (kind < 3) {
+                samples[i] = SampleType(0);
+            } else if (kind < 5) {
+                samples[i] = std::numeric_limits<SampleType>::denorm_min() * SampleType(i + 1);
+            } else {
+                samples[i] = SampleType(std::sin(double(i) * 0.05) * 0.7 + noise(random) * 0.2);
+            }
+        }
+        if (kind == 5 && numSamples > 0) {
+            samples[numSamples / 2] = std::numeric_limits<SampleType>::quiet_NaN();
+        }
+        if (kind == 6 && numSamples > 0) {
+            samples[numSamples / 2] = std::numeric_limits<SampleType>::infinity();
+        }
+    }
+}
+
+class HostileHost
+{
+public:
+    explicit HostileHost(MexoscopeAudioProcessor& p) : processor(p)
+    {
+        processor.setPlayHead(&playHead);
+        configure();
+    }
+
+    ~HostileHost()
+    {
+        processor.releaseResources();
+        processor.setPlayHead(nullptr);
+    }
+
+    // Audio thread.
+    void run(int numBlocks)
+    {
+        std::uniform_int_distribution<int> percent(0, 999);
+
+        for (int block = 0; block < numBlocks; ++block) {
+            if (percent(random) < 2) {
+                processor.releaseResources();
+                configure();
+            }
+
+            automate();
+
+            const int numSamples = pickBlockSize();
+            playHead.advance(random, numSamples, sampleRate);
+
+            if (processor.isUsingDoublePrecision()) {
+                processBlock(doubleStorage, numSamples);
+            } else {
+                processBlock(floatStorage, numSamples);
+            }
+        }
+    }
+
+    const DeadlineStats& getDeadlines() const { return deadlines; }
+
+private:
+    // A new sample rate, announced block size, precision and layout, the
+    // way a host reconfigures a plug-in: while it isn't processing.
+    void configure()
+    {
+        static const double rates[] = { 22050.0, 44100.0, 48000.0, 88200.0, 96000.0, 192000.0 };
+        static const int blockSizes[] = { 32, 64, 128, 256, 441, 480, 512, 1024, 2048, 4096 };
+        std::uniform_int_distribution<int> coin(0, 1);
+
+        sampleRate = rates[std::uniform_int_distribution<size_t>(0, std::size(rates) - 1)(random)];
+        maxBlockSize = blockSizes[std::uniform_int_distribution<size_t>(0, std::size(blockSizes) - 1)(random)];
+
+        const auto main = coin(random) ? juce::AudioChannelSet::stereo() : juce::AudioChannelSet::mono();
+        const juce::AudioChannelSet sidechains[] = { juce::AudioChannelSet::disabled(), juce::AudioChannelSet::mono(),
+                                                     juce::AudioChannelSet::stereo() };
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(main);
+        layout.inputBuses.add(sidechains[std::uniform_int_distribution<int>(0, 2)(random)]);
+        layout.outputBuses.add(main);
+        processor.setBusesLayout(layout);
+
+        processor.setProcessingPrecision(coin(random) ? juce::AudioProcessor::doublePrecision
+                                                      : juce::AudioProcessor::singlePrecision);
+        processor.setRateAndBufferSizeDetails(sampleRate, maxBlockSize);
+        processor.prepareToPlay(sampleRate, maxBlockSize);
+
+        // Room for blocks twice as large as announced, which some hosts send.
+        const int numChannels = juce::jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels());
+        floatStorage.setSize(numChannels, maxBlockSize * 2);
+        doubleStorage.setSize(numChannels, maxBlockSize * 2);
+    }
+
+    int pickBlockSize()
+    {
+        const int kind = std::uniform_int_distribution<int>(0, 99)(random);
+        if (kind < 10) {
+            return 1;
+        }
+        if (kind < 12) {
+            return std::uniform_int_distribution<int>(maxBlockSize + 1, maxBlockSize * 2)(random);
+        }
+        if (kind < 40) {
+            return maxBlockSize;
+        }
+        return std::uniform_int_distribution<int>(1, maxBlockSize)(random);
+    }
+
+    // Host automation, delivered the way JUCE's plug-in wrappers do it.
+    // That takes JUCE's listener lock, so it happens between blocks rather
+    // than inside processBlock, where the hooks would count it.
+    void automate()
+    {
+        const int numChanges = std::uniform_int_distribution<int>(0, 99)(random) < 20
+                                   ? std::uniform_int_distribution<int>(1, 8)(random) : 0;
+
+        for (int k = 0; k < numChanges; ++k) {
+            auto& parameter = processor.getScopeParameter(std::uniform_int_distribution<int>(0, Mexoscope::kNumParams - 1)(random));
+            const float value = std::uniform_real_distribution<float>(0.0f, 1.0f)(random);
+
+            // Freezing for long would leave nothing to draw.
+            if (&parameter == &processor.getScopeParameter(Mexoscope::kFreeze) && value > 0.1f) {
+                continue;
+            }
+            parameter.setValue(value);
+            parameter.sendValueChangedMessageToListeners(value);
+        }
+    }
+
+    template <typename SampleType>
+    void processBlock(juce::AudioBuffer<SampleType>& storage, int numSamples)
+    {
+        fillInput(storage, numSamples, random);
+        juce::AudioBuffer<SampleType> buffer(storage.getArrayOfWritePointers(), storage.getNumChannels(), numSamples);
+
+        const auto start = std::chrono::steady_clock::now();
+        inAudioCallback = true;
+        processor.processBlock(buffer, midi);
+        inAudioCallback = false;
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const double ratio = elapsed.count() * sampleRate / double(numSamples);
+        deadlines.numBlocks++;
+        deadlines.numMisses += (ratio > 1.0) ? 1 : 0;
+        deadlines.worstRatio = juce::jmax(deadlines.worstRatio, ratio);
+    }
+
+    MexoscopeAudioProcessor& processor;
+    HostilePlayHead playHead;
+    std::mt19937 random { 1 };
+
+    double sampleRate = 48000.0;
+    int maxBlockSize = 512;
+    juce::AudioBuffer<float> floatStorage;
+    juce::AudioBuffer<double> doubleStorage;
+    juce::MidiBuffer midi;
+
+    DeadlineStats deadlines;
+};
+
+// Message thread. Does what an open editor does, as often as it can.
+uint64_t runEditor(MexoscopeAudioProcessor& processor, const std::atomic<bool>& done)
+{
+    WaveDisplay display(processor.mexoscope, processor.getAverager(), processor.getTracer());
+    display.setSize(660, 360);
+    std::optional<Mexoscope::ScopedConsumer> consumer;
+    consumer.emplace(processor.mexoscope);
+
+    std::mt19937 random(2);
+    std::uniform_int_distribution<int> percent(0, 99);
+    uint64_t numPaints = 0;
+
+    while (!done.load()) {
+        juce::Image image(juce::Image::ARGB, display.getWidth(), display.getHeight(), true);
+        {
+            juce::Graphics g(image);
+            display.paint(g);
+        }
+        processor.getStreamMonitor().collect();
+        numPaints++;
+
+        if (percent(random) < 2) {
+            // Closing and opening the editor.
+            if (consumer) {
+                consumer.reset();
+            } else {
+                consumer.emplace(processor.mexoscope);
+            }
+        }
+        if (percent(random) < 2) {
+            display.setSize(std::uniform_int_distribution<int>(100, 1400)(random),
+                            std::uniform_int_distribution<int>(80, 900)(random));
+        }
+        if (percent(random) < 2) {
+            static const SignalAverager::Mode modes[] = { SignalAverager::Mode::Off, SignalAverager::Mode::Linear,
+                                                          SignalAverager::Mode::Exponential };
+            processor.getAverager().setMode(modes[percent(random) % 3], 1 << (percent(random) % 12));
+        }
+        if (percent(random) < 2) {
+            processor.getLoudnessMeter().setEnabled(!processor.getLoudnessMeter().isEnabled());
+        }
+        if (percent(random) < 10) {
+            // Moving a control in the editor.
+            auto& parameter = processor.getScopeParameter(percent(random) % Mexoscope::kNumParams);
+            if (&parameter != &processor.getScopeParameter(Mexoscope::kFreeze)) {
+                parameter.setValueNotifyingHost(std::uniform_real_distribution<float>(0.0f, 1.0f)(random));
+            }
+        }
+    }
+
+    return numPaints;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    const int numBlocks = (argc > 1) ? juce::jmax(1, std::atoi(argv[1])) : 50000;
+
+    // backtrace() loads what it needs on the first call, which allocates.
+    void* warmUp[1];
+    backtrace(warmUp, 1);
+
+    const juce::ScopedJuceInitialiser_GUI messageManager;
+    MexoscopeAudioProcessor processor;
+
+    const auto traceFile = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                               .getNonexistentChildFile("mexoscope-hostile-host", ".json");
+    processor.getTracer().start(traceFile);
+
+    std::atomic<bool> done { false };
+    DeadlineStats deadlines;
+    uint64_t numPaints = 0;
+    {
+        HostileHost host(processor);
+        std::thread audioThread([&] {
+            host.run(numBlocks);
+            done.store(true);
+        });
+        numPaints = runEditor(processor, done);
+        audioThread.join();
+        deadlines = host.getDeadlines();
+    }
+
+    processor.getTracer().stop();
+    traceFile.deleteFile();
+
+    std::printf("%llu blocks, %llu paints\n", (unsigned long long)deadlines.numBlocks, (unsigned long long)numPaints);
+    std::printf("deadline misses: %llu (%.3f%%), worst block took %.2fx its duration\n",
+                (unsigned long long)deadlines.numMisses, 100.0 * double(deadlines.numMisses) / double(deadlines.numBlocks),
+                deadlines.worstRatio);
+    std::printf("allocations in processBlock: %llu%s\n", (unsigned long long)numAllocations.load(),
+                HOSTILE_HOST_HOOK_MALLOC ? "" : " (operator new only)");
+    std::printf("mutex locks in processBlock: %llu%s\n", (unsigned long long)numLocks.load(),
+                HOSTILE_HOST_HOOK_LOCKS ? "" : " (not checked under TSan)");
+
+    if (haveBacktrace.load()) {
+        std::printf("first %s in processBlock:\n", backtraceKind);
+        std::fflush(stdout);
+        backtrace_symbols_fd(backtraceFrames, backtraceSize, STDOUT_FILENO);
+        return 1;
+    }
+    return 0;
+}
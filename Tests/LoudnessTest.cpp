@@ -0,0 +1,126 @@
+/*
+  Feeds LoudnessMeter a stereo 1 kHz sine at -20 dBFS, which BS.1770 reads
+  as -20 LUFS, with a NaN and later an infinity in it, and checks that the
+  momentary, short-term and integrated loudness read -20 LUFS again once
+  the input is clean. Then turns the sine down by 6 dB and checks that the
+  integrated loudness still follows.
+
+  Usage: mexoscope_loudness_test
+
+  Runs once with float blocks and once with double blocks. Prints the
+  readings that were off and returns 1 if any were.
+*/
+
+#include <JuceHeader.h>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#include "LoudnessMeter.h"
+
+namespace {
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 480;
+constexpr float kLevel = -20.0f;
+constexpr float kQuieterLevel = -26.0f;
+constexpr float kTolerance = 0.2f;
+
+int numFailures = 0;
+
+void expectLevel(const char* name, float loudness, const char* when, float level = kLevel)
+{
+    if (!(std::abs(loudness - level) < kTolerance)) {
+        std::printf("FAILED: %s loudness is %.2f LUFS %s, expected %.1f\n", name, double(loudness), when, double(level));
+        ++numFailures;
+    }
+}
+
+void expectReadings(const LoudnessMeter& meter, const char* when)
+{
+    expectLevel("momentary", meter.getMomentary(), when);
+    expectLevel("short-term", meter.getShortTerm(), when);
+    expectLevel("integrated", meter.getIntegrated(), when);
+}
+
+template <typename SampleType>
+class SineSource
+{
+public:
+    // The next block of the sine, optionally with `bad` as the sample at
+    // `badIndex` of `badChannel`.
+    const juce::AudioBuffer<SampleType>& next(int badChannel = -1, int badIndex = 0,
+                                               SampleType bad = SampleType(0))
+    {
+        const double amplitude = std::pow(10.0, level / 20.0);
+        for (int i = 0; i < kBlockSize; ++i) {
+            const auto value = SampleType(amplitude * std::sin(phase));
+            phase = std::fmod(phase + juce::MathConstants<double>::twoPi * 1000.0 / kSampleRate,
+                              juce::MathConstants<double>::twoPi);
+            buffer.setSample(0, i, value);
+            buffer.setSample(1, i, value);
+        }
+        if (badChannel >= 0) {
+            buffer.setSample(badChannel, badIndex, bad);
+        }
+        return buffer;
+    }
+
+    float level = kLevel;
+
+private:
+    juce::AudioBuffer<SampleType> buffer { 2, kBlockSize };
+    double phase = 0.0;
+};
+
+template <typename SampleType>
+void run()
+{
+    LoudnessMeter meter;
+    meter.prepare(kSampleRate);
+    meter.setEnabled(true);
+    SineSource<SampleType> source;
+
+    // Longer than the 3 s of the short-term loudness.
+    const int blocksToSettle = int(4.0 * kSampleRate) / kBlockSize;
+
+    for (int b = 0; b < blocksToSettle; ++b) {
+        meter.process(source.next());
+    }
+    expectReadings(meter, "before the NaN");
+
+    meter.process(source.next(0, 100, std::numeric_limits<SampleType>::quiet_NaN()));
+    for (int b = 0; b < blocksToSettle; ++b) {
+        meter.process(source.next());
+    }
+    expectReadings(meter, "after the NaN");
+
+    meter.process(source.next(1, 5, std::numeric_limits<SampleType>::infinity()));
+    for (int b = 0; b < blocksToSettle; ++b) {
+        meter.process(source.next());
+    }
+    expectReadings(meter, "after the infinity");
+
+    // -26 for as long as -20 played before. The blocks at -26 are within
+    // the relative gate, so the integrated loudness is the mean of both.
+    source.level = kQuieterLevel;
+    const int blocksSoFar = 3 * (blocksToSettle + 1);
+    for (int b = 0; b < blocksSoFar; ++b) {
+        meter.process(source.next());
+    }
+    expectLevel("momentary", meter.getMomentary(), "after turning down", kQuieterLevel);
+    const float expectedIntegrated = -0.691f + 10.0f * std::log10(0.5f * (std::pow(10.0f, (kLevel + 0.691f) / 10.0f)
+                                                                          + std::pow(10.0f, (kQuieterLevel + 0.691f) / 10.0f)));
+    expectLevel("integrated", meter.getIntegrated(), "after turning down", expectedIntegrated);
+}
+}
+
+int main()
+{
+    run<float>();
+    run<double>();
+
+    if (numFailures == 0) {
+        std::printf("The meter read %.1f LUFS before and after the bad samples\n", double(kLevel));
+    }
+    return (numFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/*
+  Times Mexoscope::process on single and double precision blocks, and on
+  double precision blocks that are converted to float first, which is what
+  hosts with a 64-bit mix engine had to do before the engine took doubles.
+
+  Usage: mexoscope_precision_bench [seconds of audio per run]
+
+  Every case runs the same stereo signal through its own engine, in blocks
+  of 512 samples, with a Rising trigger. Each case is run five times and
+  the fastest run counts, to keep other work on the machine out of it.
+*/
+
+#include <JuceHeader.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include "Mexoscope.h"
+
+namespace {
+constexpr double kSampleRate = 48000.0;
+constexpr int kBlockSize = 512;
+constexpr int kNumRuns = 5;
+
+template <typename SampleType>
+void makeSignal(juce::AudioBuffer<SampleType>& buffer)
+{
+    // A 110 Hz saw with some noise, so the trigger has edges to find.
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> noise(-0.05, 0.05);
+    for (int i = 0; i < buffer.getNumSamples(); ++i) {
+        const double phase = std::fmod(double(i) * 110.0 / kSampleRate, 1.0);
+        const double value = 0.8 * (phase * 2.0 - 1.0);
+        buffer.setSample(0, i, SampleType(value + noise(random)));
+        buffer.setSample(1, i, SampleType(-value + noise(random)));
+    }
+}
+
+void setUp(Mexoscope& mexoscope)
+{
+    mexoscope.prepareToPlay(kSampleRate);
+    mexoscope.setParameter(Mexoscope::kTriggerType, float(Mexoscope::kTriggerRising) / float(Mexoscope::kNumTriggerTypes));
+    mexoscope.setParameter(Mexoscope::kTimeWindow, 0.6f);
+}
+
+// Seconds for the fastest of `kNumRuns` runs of `processBlock` over all of
+// `numSamples`, one block at a time.
+template <typename ProcessBlock>
+double timeRuns(int numSamples, ProcessBlock&& processBlock)
+{
+    double best = 0.0;
+    for (int run = 0; run < kNumRuns; ++run) {
+        const auto start = std::chrono::steady_clock::now();
+        for (int position = 0; position + kBlockSize <= numSamples; position += kBlockSize) {
+            processBlock(position);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = (run == 0) ? elapsed.count() : juce::jmin(best, elapsed.count());
+    }
+    return best;
+}
+
+void report(const char* name, double seconds, int numSamples, double baseline)
+{
+    std::printf("%-28s %8.2f ns/sample %10.1f Msamples/s", name, seconds * 1.0e9 / double(numSamples),
+                double(numSamples) / seconds * 1.0e-6);
+    if (baseline > 0.0) {
+        std::printf("   %+6.1f%% vs float", (seconds / baseline - 1.0) * 100.0);
+    }
+    std::printf("\n");
+}
+}
+
+int main(int argc, char* argv[])
+{
+    const double seconds = (argc > 1) ? std::atof(argv[1]) : 20.0;
+    const int numSamples = juce::jmax(kBlockSize, int(seconds * kSampleRate) / kBlockSize * kBlockSize);
+
+    juce::AudioBuffer<float> floatInput(2, numSamples);
+    juce::AudioBuffer<double> doubleInput(2, numSamples);
+    makeSignal(floatInput);
+    makeSignal(doubleInput);
+
+    // The engines only capture while something consumes the frames.
+    Mexoscope floatEngine, doubleEngine, convertingEngine;
+    const Mexoscope::ScopedConsumer floatConsumer(floatEngine), doubleConsumer(doubleEngine),
+        convertingConsumer(convertingEngine);
+    setUp(floatEngine);
+    setUp(doubleEngine);
+    setUp(convertingEngine);
+
+    // Blocks that point into the input, the way a host passes them.
+    const auto block = [](auto& input, int position) {
+        using SampleType = std::remove_reference_t<decltype(*input.getWritePointer(0))>;
+        return juce::AudioBuffer<SampleType>(input.getArrayOfWritePointers(), 2, position, kBlockSize);
+    };
+
+    juce::AudioBuffer<float> converted(2, kBlockSize);
+    const auto convert = [&](int position) {
+        for (int channel = 0; channel < 2; ++channel) {
+            const double* source = doubleInput.getReadPointer(channel, position);
+            float* destination = converted.getWritePointer(channel);
+            for (int i = 0; i < kBlockSize; ++i) {
+                destination[i] = float(source[i]);
+            }
+        }
+    };
+
+    const double floatTime = timeRuns(numSamples, [&](int position) { floatEngine.process(block(floatInput, position)); });
+    const double doubleTime = timeRuns(numSamples, [&](int position) { doubleEngine.process(block(doubleInput, position)); });
+    const double convertingTime = timeRuns(numSamples, [&](int position) {
+        convert(position);
+        convertingEngine.process(converted);
+    });
+    const double conversionTime = timeRuns(numSamples, convert);
+
+    std::printf("%d samples per channel, blocks of %d, stereo, %.0f Hz\n\n", numSamples, kBlockSize, kSampleRate);
+    report("float", floatTime, numSamples, 0.0);
+    report("double, native", doubleTime, numSamples, floatTime);
+    report("double, converted to float", convertingTime, numSamples, floatTime);
+    report("conversion alone", conversionTime, numSamples, 0.0);
+    return 0;
+}
@@ -0,0 +1,262 @@
+/*
+  Feeds random audio, block sizes and parameter changes to both Mexoscope
+  and MexoscopeReference, and checks after every block that they drew the
+  same thing and triggered at the same samples.
+
+  Usage: mexoscope_reference_fuzz [seed] [number of blocks]
+
+  Runs the given number of blocks in single precision and then in double
+  precision, starting from the seed. Any seed gives the same run again.
+  Blocks are 0 to 1500 samples long, often only a few, with up to eight
+  parameter changes at random offsets in them, some of them outside the
+  block. The input has NaNs, infinities and huge values in it, the
+  sidechain comes and goes, and so do the consumers, the sample rate and
+  the host's transport. Stops at the first block where the two engines
+  differ and returns 1.
+
+  Also reports how fast both engines went, in samples per second.
+*/
+
+#include <JuceHeader.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "Mexoscope.h"
+#include "MexoscopeReference.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Event
+{
+    int index;
+    float value;
+    int sampleOffset;
+};
+
+struct Timings
+{
+    uint64_t numSamples = 0;
+    double engineSeconds = 0.0;
+    double referenceSeconds = 0.0;
+};
+
+// What's different between the two engines after a block, or nullptr.
+const char* compare(const Mexoscope& engine, const MexoscopeReference& reference)
+{
+    if (engine.getTriggerCount() != reference.getTriggerCount()) {
+        return "trigger count";
+    }
+    if (engine.getLastTriggerPosition() != reference.getLastTriggerPosition()) {
+        return "trigger position";
+    }
+    for (size_t j = 0; j < engine.getPeaks().size(); ++j) {
+        if (engine.getPeaks()[j].y != reference.getPeaks()[j].y) {
+            return "peaks";
+        }
+        if (engine.getCopy()[j].y != reference.getCopy()[j].y) {
+            return "copy";
+        }
+    }
+    if (engine.getOvers() != reference.getOvers()) {
+        return "overs";
+    }
+    if (engine.getOversCopy() != reference.getOversCopy()) {
+        return "overs copy";
+    }
+    return nullptr;
+}
+
+// Mostly ordinary samples, sometimes far out of range. A NaN or an
+// infinity stays in the DC filter until the next reset, so those only go
+// into one block in a hundred.
+template <typename SampleType>
+SampleType randomSample(std::mt19937& random, bool nonFinite)
+{
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    const auto roll = random() % 1000;
+    if (nonFinite && roll == 0) {
+        return std::numeric_limits<SampleType>::quiet_NaN();
+    }
+    if (nonFinite && roll == 1) {
+        return (random() % 2) ? std::numeric_limits<SampleType>::infinity() : -std::numeric_limits<SampleType>::infinity();
+    }
+    if (roll < 20) {
+        return SampleType(unit(random) * 1.0e30);
+    }
+    return SampleType(unit(random));
+}
+
+// A value for a parameter. Freeze is mostly off, or there'd be little to
+// compare, and choices are often exactly on a step.
+float randomValue(int index, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    if (index == Mexoscope::kFreeze) {
+        return (random() % 8 == 0) ? 1.0f : 0.0f;
+    }
+    if (const int numChoices = Mexoscope::getNumChoices(index); numChoices > 0 && random() % 2 == 0) {
+        return float(random() % unsigned(numChoices)) / float(numChoices);
+    }
+    return unit(random);
+}
+
+template <typename SampleType>
+bool run(uint32_t seed, int numBlocks, Timings& timings)
+{
+    static const double rates[] = { 8000.0, 22050.0, 44100.0, 48000.0, 96000.0, 192000.0, 384000.0 };
+
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+    Mexoscope engine;
+    MexoscopeReference reference;
+    for (int i = 0; i < Mexoscope::kNumParams; ++i) {
+        reference.setParameter(i, engine.getParameter(i));
+    }
+    engine.prepareToPlay(44100.0);
+    reference.prepareToPlay(44100.0);
+
+    std::optional<Mexoscope::ScopedConsumer> consumer;
+    consumer.emplace(engine);
+
+    Mexoscope::HostTempo tempo;
+    tempo.playing = true;
+    tempo.perSample = 120.0 / 60.0 / 44100.0;
+
+    juce::AudioBuffer<SampleType> buffer, sidechain;
+    std::vector<Event> events;
+
+    for (int block = 0; block < numBlocks; ++block) {
+        if (random() % 40 == 0) {
+            if (consumer) {
+                consumer.reset();
+            } else {
+                consumer.emplace(engine);
+            }
+        }
+        if (!consumer && random() % 100 == 0) {
+            Mexoscope::PeaksArray frame;
+            Mexoscope::OversArray frameOvers {};
+            for (size_t j = 0; j < frame.size(); ++j) {
+                frame[j] = { int(j / 2), int(random() % OSC_HEIGHT) };
+            }
+            frameOvers[random() % frameOvers.size()] = 1;
+            if (engine.restoreFrame(frame, frameOvers)) {
+                reference.restoreFrame(frame, frameOvers);
+            }
+        }
+        if (random() % 500 == 0) {
+            const double rate = rates[random() % std::size(rates)];
+            engine.prepareToPlay(rate);
+            reference.prepareToPlay(rate);
+        }
+
+        // Mostly ordinary blocks, sometimes empty or a sample or two.
+        const int numSamples = (random() % 10 == 0) ? int(random() % 3) : int(random() % 1501);
+        const int numChannels = (random() % 100 == 0) ? 0 : 1 + int(random() % 2);
+        buffer.setSize(numChannels, numSamples, false, false, true);
+        sidechain.setSize(int(random() % 3), numSamples, false, false, true);
+        const bool nonFinite = (random() % 100 == 0);
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
+            for (int i = 0; i < numSamples; ++i) {
+                buffer.setSample(channel, i, randomSample<SampleType>(random, nonFinite));
+            }
+        }
+        for (int channel = 0; channel < sidechain.getNumChannels(); ++channel) {
+            for (int i = 0; i < numSamples; ++i) {
+                sidechain.setSample(channel, i, SampleType(unit(random) * 2.0 - 1.0));
+            }
+        }
+        const auto* sidechainPointer = (sidechain.getNumChannels() > 0) ? &sidechain : nullptr;
+
+        // The engine clamps the offsets into the block and keeps changes at
+        // the same offset in order, so the reference gets them that way.
+        events.clear();
+        const int numEvents = (random() % 4 == 0) ? int(random() % 9) : 0;
+        for (int e = 0; e < numEvents; ++e) {
+            const int index = int(random() % Mexoscope::kNumParams);
+            const float value = randomValue(index, random);
+            const int offset = int(random() % unsigned(numSamples + 5)) - 2;
+            engine.setParameter(index, value, offset);
+            events.push_back({ index, value, juce::jlimit(0, numSamples, offset) });
+        }
+        std::stable_sort(events.begin(), events.end(),
+                         [](const Event& a, const Event& b) { return a.sampleOffset < b.sampleOffset; });
+
+        if (random() % 50 == 0) {
+            tempo.playing = !tempo.playing;
+        }
+        if (random() % 200 == 0) {
+            tempo.perSample = (40.0 + 300.0 * unit(random)) / 60.0 / engine.getSampleRate();
+        }
+        if (random() % 300 == 0) {
+            tempo.quarterNotesPerBar = double(1 + random() % 7);
+            tempo.barStart = std::floor(tempo.position);
+        }
+        if (random() % 300 == 0) {
+            tempo.position = juce::jmax(0.0, tempo.position - 3.7);
+        }
+        engine.setHostTempo(tempo);
+        reference.setHostTempo(tempo);
+        tempo.position += double(numSamples) * tempo.perSample;
+
+        const auto engineStart = Clock::now();
+        engine.process(buffer, sidechainPointer);
+        const auto engineEnd = Clock::now();
+
+        reference.setCapturing(engine.hasConsumers());
+        int position = 0;
+        for (size_t e = 0; e <= events.size(); ++e) {
+            const int end = (e < events.size()) ? events[e].sampleOffset : numSamples;
+            if (end > position) {
+                reference.process(buffer, sidechainPointer, position, end - position);
+                position = end;
+            }
+            if (e < events.size()) {
+                reference.setParameter(events[e].index, events[e].value);
+            }
+        }
+        const auto referenceEnd = Clock::now();
+
+        timings.numSamples += uint64_t(numSamples);
+        timings.engineSeconds += std::chrono::duration<double>(engineEnd - engineStart).count();
+        timings.referenceSeconds += std::chrono::duration<double>(referenceEnd - engineEnd).count();
+
+        if (const char* difference = compare(engine, reference)) {
+            std::printf("%s precision, seed %u: %s differs after block %d (%d samples, %d changes)\n",
+                        sizeof(SampleType) == sizeof(float) ? "single" : "double", seed, difference, block, numSamples,
+                        numEvents);
+            return false;
+        }
+    }
+    return true;
+}
+
+void report(const char* name, double seconds, uint64_t numSamples)
+{
+    std::printf("%-10s %10.1f Msamples/s\n", name, seconds > 0.0 ? double(numSamples) / seconds * 1.0e-6 : 0.0);
+}
+}
+
+int main(int argc, char* argv[])
+{
+    const auto seed = uint32_t((argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1);
+    const int numBlocks = (argc > 2) ? juce::jmax(1, std::atoi(argv[2])) : 100000;
+
+    Timings timings;
+    const bool same = run<float>(seed, numBlocks, timings) && run<double>(seed, numBlocks, timings);
+
+    std::printf("%llu samples in %d blocks of each precision, seed %u\n", (unsigned long long)timings.numSamples,
+                numBlocks, seed);
+    report("engine", timings.engineSeconds, timings.numSamples);
+    report("reference", timings.referenceSeconds, timings.numSamples);
+    return same ? 0 : 1;
+}
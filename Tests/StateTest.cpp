@@ -0,0 +1,171 @@
+/*
+  Loads states saved by older versions of the plug-in into
+  MexoscopeAudioProcessor and checks that every trigger mode comes back as
+  the mode it was saved as, then saves and loads every mode and every
+  other choice again.
+
+  Usage: mexoscope_state_test
+
+  The older states are made here the way those versions wrote them:
+  - the original plug-in, a bare array of 10 values with four trigger
+    modes saved as the mode over 4,
+  - the first version with External, 10 values with five modes,
+  - the versions after it, 17 values with five and then six modes,
+  and a state with the header written by hand, which has the mode itself.
+  Prints every state that didn't load as saved and returns 1 if any didn't.
+*/
+
+#include <JuceHeader.h>
+#include <cstdio>
+#include <vector>
+
+#include "PluginProcessor.h"
+
+namespace {
+const char* const kModeNames[] = { "Free", "Rising", "Falling", "Internal", "External", "Tempo" };
+
+int numFailures = 0;
+
+void expect(bool condition, const juce::String& what)
+{
+    if (!condition) {
+        std::printf("FAILED: %s\n", what.toRawUTF8());
+        ++numFailures;
+    }
+}
+
+juce::AudioParameterChoice& getChoice(MexoscopeAudioProcessor& processor, int index)
+{
+    return *dynamic_cast<juce::AudioParameterChoice*>(processor.getParameters()[index]);
+}
+
+// The values the original plug-in saved, with the right channel and
+// DC-kill on so that it's clear the rest of the array was read as well.
+std::vector<float> makeOriginalValues(float triggerType)
+{
+    return { 0.5f, triggerType, 0.5f, 0.5f, 0.25f, 0.5f, 0.0f, 1.0f, 0.0f, 1.0f };
+}
+
+// Loads a bare array of values, as version 1 saved it.
+void loadValues(MexoscopeAudioProcessor& processor, const std::vector<float>& values)
+{
+    processor.setStateInformation(values.data(), int(values.size() * sizeof(float)));
+}
+
+// Loads the values in a state with the header, without a frame.
+void loadWithHeader(MexoscopeAudioProcessor& processor, const std::vector<float>& values)
+{
+    const int parametersSize = 4 + int(values.size() * sizeof(float));
+    juce::MemoryBlock state;
+    juce::MemoryOutputStream stream(state, false);
+    stream.writeInt(int(juce::ByteOrder::littleEndianInt("MXSC")));
+    stream.writeInt(2);
+    stream.writeInt(12 + 8 + parametersSize);
+    stream.writeInt(int(juce::ByteOrder::littleEndianInt("PRMS")));
+    stream.writeInt(parametersSize);
+    stream.writeInt(int(values.size()));
+    for (const float value : values) {
+        stream.writeFloat(value);
+    }
+    stream.flush();
+    processor.setStateInformation(state.getData(), int(state.getSize()));
+}
+
+void expectMode(MexoscopeAudioProcessor& processor, int mode, const juce::String& state)
+{
+    const int loaded = getChoice(processor, Mexoscope::kTriggerType).getIndex();
+    expect(loaded == mode, state + ": " + kModeNames[mode] + " loaded as " + kModeNames[loaded]);
+}
+
+void testOriginal()
+{
+    for (int mode = 0; mode < 4; ++mode) {
+        MexoscopeAudioProcessor processor;
+        loadValues(processor, makeOriginalValues(float(mode) / 4.0f));
+
+        const juce::String state = "original state";
+        expectMode(processor, mode, state);
+        expect(processor.getParameters()[Mexoscope::kTimeWindow]->getValue() == 0.25f, state + ": time not loaded");
+        expect(processor.getParameters()[Mexoscope::kDCKill]->getValue() == 1.0f, state + ": DC-kill not loaded");
+    }
+}
+
+void testFirstExternal()
+{
+    for (int mode = 0; mode < 5; ++mode) {
+        MexoscopeAudioProcessor processor;
+        loadValues(processor, makeOriginalValues(float(mode) / 5.0f));
+        expectMode(processor, mode, "version 1 with five modes and 10 values");
+    }
+}
+
+void testLaterVersion1()
+{
+    for (const int numModes : { 5, 6 }) {
+        for (int mode = 0; mode < numModes; ++mode) {
+            auto values = makeOriginalValues(float(mode) / float(numModes));
+            values.resize(Mexoscope::kNumParams, 0.0f);
+
+            MexoscopeAudioProcessor processor;
+            loadValues(processor, values);
+            expectMode(processor, mode, "version 1 with " + juce::String(numModes) + " modes and 17 values");
+        }
+    }
+}
+
+void testWithHeader()
+{
+    for (int mode = 0; mode < Mexoscope::kNumTriggerTypes; ++mode) {
+        auto values = makeOriginalValues(float(mode));
+        values.resize(Mexoscope::kNumParams, 0.0f);
+
+        MexoscopeAudioProcessor processor;
+        loadWithHeader(processor, values);
+        expectMode(processor, mode, "version 2");
+    }
+}
+
+// Saves every mode, together with the last choice of the other selection
+// parameters, and loads it into a new processor.
+void testRoundTrip()
+{
+    for (int mode = 0; mode < Mexoscope::kNumTriggerTypes; ++mode) {
+        MexoscopeAudioProcessor saved;
+        for (int i = 0; i < Mexoscope::kNumParams; ++i) {
+            if (const int numChoices = Mexoscope::getNumChoices(i); numChoices > 0) {
+                const int choice = (i == Mexoscope::kTriggerType) ? mode : numChoices - 1;
+                getChoice(saved, i).setValueNotifyingHost(getChoice(saved, i).convertTo0to1(float(choice)));
+            }
+        }
+
+        juce::MemoryBlock state;
+        saved.getStateInformation(state);
+
+        MexoscopeAudioProcessor loaded;
+        loaded.setStateInformation(state.getData(), int(state.getSize()));
+        expectMode(loaded, mode, "saved state");
+        for (int i = 0; i < Mexoscope::kNumParams; ++i) {
+            if (i != Mexoscope::kTriggerType && Mexoscope::getNumChoices(i) > 0) {
+                expect(getChoice(loaded, i).getIndex() == getChoice(saved, i).getIndex(),
+                       "saved state: " + getChoice(loaded, i).getName(64) + " not loaded");
+            }
+        }
+    }
+}
+}
+
+int main()
+{
+    const juce::ScopedJuceInitialiser_GUI messageManager;
+
+    testOriginal();
+    testFirstExternal();
+    testLaterVersion1();
+    testWithHeader();
+    testRoundTrip();
+
+    if (numFailures == 0) {
+        std::printf("All states loaded as saved\n");
+    }
+    return (numFailures == 0) ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+/*
+  Reference reader for the mexoscope shared-memory export.
+
+  Usage: mexoscope_shm_reader /mexoscope-<pid>-<instance>
+
+  The object name is shown in the tooltip of the Shared Memory button in
+  the plug-in. This program follows the raw sample stream and prints the
+  peak level per channel about ten times per second, and reports every new
+  decimated frame and every change in the mask test results and the
+  trigger counts. It is only meant as an example of the read protocol
+  described in Source/ExportLayout.h. Note that it never writes into the
+  shared memory: readers can't slow down or block the plug-in.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ExportLayout.h"
+
+namespace {
+const float* rawRing(const mexport::ExportHeader* header, uint32_t channel)
+{
+    auto* base = reinterpret_cast<const char*>(header) + header->rawOffset;
+    return reinterpret_cast<const float*>(base) + size_t(channel) * header->rawCapacity;
+}
+
+const mexport::FrameRecord* frameSlot(const mexport::ExportHeader* header, uint64_t frameIndex)
+{
+    auto* base = reinterpret_cast<const char*>(header) + header->frameOffset;
+    const auto slot = frameIndex & (header->frameCapacity - 1);
+    return reinterpret_cast<const mexport::FrameRecord*>(base + slot * header->frameStride);
+}
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <shared memory name>\n", argv[0]);
+        return 1;
+    }
+
+    const int fd = shm_open(argv[1], O_RDONLY, 0);
+    if (fd < 0) {
+        std::perror("shm_open");
+        return 1;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(mexport::ExportHeader)) {
+        std::fprintf(stderr, "%s is not a mexoscope export\n", argv[1]);
+        return 1;
+    }
+
+    void* memory = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        std::perror("mmap");
+        return 1;
+    }
+
+    const auto* header = static_cast<const mexport::ExportHeader*>(memory);
+    if (std::memcmp(header->magic, mexport::kMagic, sizeof(header->magic)) != 0
+        || header->version != mexport::kVersion
+        || uint64_t(info.st_size) < mexport::totalSize(header->numChannels)) {
+        std::fprintf(stderr, "%s has an unknown layout\n", argv[1]);
+        return 1;
+    }
+
+    std::printf("%u channel(s), %.0f Hz\n", header->numChannels, header->sampleRate.load());
+
+    const uint64_t rawMask = header->rawCapacity - 1;
+    const uint64_t rawUsable = mexport::usableRawCapacity(header->rawCapacity);
+    uint64_t rawRead = header->rawWriteIndex.load(std::memory_order_acquire);
+    uint64_t frameRead = header->frameWriteIndex.load(std::memory_order_acquire);
+
+    std::vector<float> chunk(rawUsable);
+    mexport::FrameRecord frame;
+    uint64_t maskTested = 0, maskFailed = 0;
+    uint64_t triggersAccepted = 0, triggersRejected = 0;
+
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        // Raw samples. Copy first, then check whether the writer lapped us
+        // while we were copying.
+        const uint64_t rawWrite = header->rawWriteIndex.load(std::memory_order_acquire);
+        if (rawWrite - rawRead > rawUsable) {
+            std::printf("raw overrun, skipped %llu samples\n",
+                        (unsigned long long)(rawWrite - rawUsable - rawRead));
+            rawRead = rawWrite - rawUsable;
+        }
+
+        const auto count = size_t(rawWrite - rawRead);
+        std::printf("%10llu", (unsigned long long)rawWrite);
+
+        for (uint32_t ch = 0; ch < header->numChannels; ++ch) {
+            const float* ring = rawRing(header, ch);
+            for (size_t i = 0; i < count; ++i) {
+                chunk[i] = ring[(rawRead + i) & rawMask];
+            }
+
+            float peak = 0.0f;
+            for (size_t i = 0; i < count; ++i) {
+                peak = std::fmax(peak, std::fabs(chunk[i]));
+            }
+            std::printf("  ch%u %7.2f dB", ch, 20.0 * std::log10(std::fmax(peak, 1e-9f)));
+        }
+
+        if (header->rawWriteIndex.load(std::memory_order_acquire) - rawRead > rawUsable) {
+            std::printf("  (torn)");
+        }
+        std::printf("\n");
+        rawRead = rawWrite;
+
+        // Decimated frames.
+        const uint64_t frameWrite = header->frameWriteIndex.load(std::memory_order_acquire);
+        if (frameWrite - frameRead >= header->frameCapacity) {
+            frameRead = frameWrite - header->frameCapacity + 1;
+        }
+
+        for (; frameRead < frameWrite; ++frameRead) {
+            std::memcpy(&frame, frameSlot(header, frameRead), sizeof(frame));
+            if (header->frameWriteIndex.load(std::memory_order_acquire) - frameRead >= header->frameCapacity) {
+                continue;  // overwritten while copying
+            }
+
+            int top = 0x7fff, bottom = 0;
+            for (int i = 0; i < OSC_WIDTH * 2; ++i) {
+                top = std::min(top, int(frame.y[i]));
+                bottom = std::max(bottom, int(frame.y[i]));
+            }
+            std::printf("frame %llu at sample %llu, y range %d..%d\n",
+                        (unsigned long long)frameRead, (unsigned long long)frame.samplePosition, top, bottom);
+        }
+
+        // Mask test results.
+        const uint64_t tested = header->maskTestedFrames.load(std::memory_order_relaxed);
+        const uint64_t failed = header->maskFailedFrames.load(std::memory_order_relaxed);
+        if (tested != maskTested || failed != maskFailed) {
+            std::printf("mask: %llu tested, %llu failed, last failure at sample %lld\n",
+                        (unsigned long long)tested, (unsigned long long)failed,
+                        (long long)header->maskLastFailure.load(std::memory_order_relaxed));
+            maskTested = tested;
+            maskFailed = failed;
+        }
+
+        // Trigger statistics.
+        const uint64_t accepted = header->triggersAccepted.load(std::memory_order_relaxed);
+        const uint64_t rejected = header->triggersRejected.load(std::memory_order_relaxed);
+        if (accepted != triggersAccepted || rejected != triggersRejected) {
+            std::printf("triggers: %llu fired, %llu held back, period %.6f s +- %.3g s\n",
+                        (unsigned long long)accepted, (unsigned long long)rejected,
+                        header->triggerPeriodMean.load(std::memory_order_relaxed),
+                        header->triggerPeriodStdDev.load(std::memory_order_relaxed));
+            triggersAccepted = accepted;
+            triggersRejected = rejected;
+        }
+    }
+}